@@ -0,0 +1,716 @@
+/* $Id$
+ *
+ * Block cache : shared cache for the content of remote files.
+ * This file is part of djmount.
+ *
+ * (C) Copyright 2026 djmount contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include "block_cache.h"
+#include "talloc_util.h"
+#include "string_util.h"
+#include "log.h"
+#include "minmax.h"
+#include "hash.h"	// import gnulib hash
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <utime.h>
+#include <sys/stat.h>
+
+#include <upnp/ithread.h>
+
+
+#define BLOCK_FILE_SUFFIX	".blk"
+
+
+/******************************************************************************
+ * Local types and variables
+ *****************************************************************************/
+
+// Node in a LRU list : most recently used first
+typedef struct _LruNode {
+	struct _LruNode*	prev;
+	struct _LruNode*	next;
+} LruNode;
+
+typedef struct _LruList {
+	LruNode*	first;
+	LruNode*	last;
+} LruList;
+
+
+// Block cached in memory : shared between all readers of the same URL
+typedef struct _Page {
+	LruNode		lru;		// must be first
+	char*		key;		// "<url> <block index>"
+	char*		data;		// BLOCK_CACHE_BLOCK_SIZE bytes
+	size_t		size;		// content size, once filled
+	int		refcount;	// readers using "data" (not evictable)
+	bool		filling;	// being read : other readers wait
+	bool		valid;		// content is valid
+	bool		removed;	// removed from index, free when unused
+} Page;
+
+
+// Block cached on disk
+typedef struct _Block {
+	LruNode		lru;		// must be first
+	char*		name;		// file name in cache directory
+	off_t		size;		// size of file on disk
+} Block;
+
+
+// All variables below are protected by "g_mutex"
+static ithread_mutex_t	g_mutex;
+static ithread_cond_t	g_filled_cond;	// signals the end of a page fill
+
+static void*		g_context = NULL; // NULL if cache is disabled
+
+// Memory cache
+static size_t		g_mem_max = 0;
+static size_t		g_mem_size = 0;
+static Hash_table*	g_pages = NULL;
+static LruList		g_pages_lru = { NULL, NULL };
+
+// Disk cache, if "g_dir" is not NULL
+static const char*	g_dir = NULL;
+static off_t		g_disk_max = 0;
+static off_t		g_disk_size = 0;
+static Hash_table*	g_blocks = NULL;
+static LruList		g_blocks_lru = { NULL, NULL };
+
+// Statistics
+static long		g_nr_mem_hit = 0;
+static long		g_nr_disk_hit = 0;
+static long		g_nr_miss = 0;
+static long		g_nr_wait = 0;
+static long		g_nr_mem_evict = 0;
+static long		g_nr_disk_evict = 0;
+static long		g_nr_error = 0;
+
+
+/******************************************************************************
+ * LRU list management
+ *****************************************************************************/
+static void
+lru_remove (LruList* list, LruNode* node)
+{
+	if (node->prev)
+		node->prev->next = node->next;
+	else
+		list->first = node->next;
+	if (node->next)
+		node->next->prev = node->prev;
+	else
+		list->last = node->prev;
+	node->prev = node->next = NULL;
+}
+
+static void
+lru_push_first (LruList* list, LruNode* node)
+{
+	node->prev = NULL;
+	node->next = list->first;
+	if (list->first)
+		list->first->prev = node;
+	else
+		list->last = node;
+	list->first = node;
+}
+
+
+/******************************************************************************
+ * Hash tables functions
+ *****************************************************************************/
+static size_t 
+page_hasher (const void* entry, size_t table_size)
+{
+	return String_Hash (((const Page*) entry)->key) % table_size;
+}
+
+static bool 
+page_comparator (const void* e1, const void* e2)
+{
+	return (strcmp (((const Page*) e1)->key, 
+			((const Page*) e2)->key) == 0);
+}
+
+static size_t 
+block_hasher (const void* entry, size_t table_size)
+{
+	return String_Hash (((const Block*) entry)->name) % table_size;
+}
+
+static bool 
+block_comparator (const void* e1, const void* e2)
+{
+	return (strcmp (((const Block*) e1)->name, 
+			((const Block*) e2)->name) == 0);
+}
+
+
+/******************************************************************************
+ * get_block_name
+ *	Returns the cache file name for a block (allocated in 'context').
+ *	Collisions between URLs having the same hash are detected when 
+ *	reading the file, because its first line contains the URL.
+ *****************************************************************************/
+static char*
+get_block_name (void* context, const char* url, off_t block)
+{
+	return talloc_asprintf (context, "%08" PRIx32 "-%" PRIdMAX 
+				BLOCK_FILE_SUFFIX, 
+				(uint32_t) String_Hash (url), 
+				(intmax_t) block);
+}
+
+
+/******************************************************************************
+ * add_block
+ *	Add (or update) a block in the disk index, as most recently used.
+ *	Must be called with "g_mutex" locked.
+ *****************************************************************************/
+static void
+add_block (const char* name, off_t size)
+{
+	Block searched = { .name = (char*) name };
+	Block* b = hash_lookup (g_blocks, &searched);
+	if (b) {
+		g_disk_size -= b->size;
+		lru_remove (&g_blocks_lru, &b->lru);
+	} else {
+		b = talloc (g_context, Block);
+		if (b == NULL)
+			return; // ---------->
+		*b = (Block) { .name = talloc_strdup (b, name) };
+		if (b->name == NULL || hash_insert (g_blocks, b) == NULL) {
+			talloc_free (b);
+			return; // ---------->
+		}
+	}
+	b->size = size;
+	g_disk_size += size;
+	lru_push_first (&g_blocks_lru, &b->lru);
+}
+
+
+/******************************************************************************
+ * evict_blocks
+ *	Remove least recently used blocks until the disk cache fits its 
+ *	maximum size. Must be called with "g_mutex" locked.
+ *****************************************************************************/
+static void
+evict_blocks ()
+{
+	while (g_disk_size > g_disk_max && g_blocks_lru.last) {
+		Block* const b = (Block*) g_blocks_lru.last;
+		char* const path = talloc_asprintf (NULL, "%s/%s", 
+						    g_dir, b->name);
+		if (path && unlink (path) != 0 && errno != ENOENT) {
+			Log_Printf (LOG_ERROR, "BlockCache can't remove '%s' "
+				    ": %s", path, strerror (errno));
+		}
+		talloc_free (path);
+		lru_remove (&g_blocks_lru, &b->lru);
+		(void) hash_delete (g_blocks, b);
+		g_disk_size -= b->size;
+		g_nr_disk_evict++;
+		talloc_free (b);
+	}
+}
+
+
+/******************************************************************************
+ * disk_read
+ *	Read a block from the disk cache : returns the block size, 
+ *	or < 0 if not in cache. Must be called with "g_mutex" unlocked.
+ *****************************************************************************/
+static ssize_t
+disk_read (const char* url, off_t block, char* buffer)
+{
+	void* const tmp_ctx = talloc_new (NULL);
+	char* const name = get_block_name (tmp_ctx, url, block);
+	ssize_t n = -1;
+
+	ithread_mutex_lock (&g_mutex);
+	Block searched = { .name = name };
+	Block* const b = (name ? hash_lookup (g_blocks, &searched) : NULL);
+	if (b) {
+		lru_remove (&g_blocks_lru, &b->lru);
+		lru_push_first (&g_blocks_lru, &b->lru);
+	}
+	ithread_mutex_unlock (&g_mutex);
+
+	/*
+	 * The file is read unlocked : if the block is evicted meanwhile, 
+	 * either the open fails (miss) or the unlinked file is still
+	 * readable.
+	 */
+	if (b) {
+		char* const path = talloc_asprintf (tmp_ctx, "%s/%s", 
+						    g_dir, name);
+		FILE* const file = (path ? fopen (path, "r") : NULL);
+		if (file) {
+			// First line is the URL
+			size_t const len = strlen (url);
+			char* const line = talloc_size (tmp_ctx, len + 1);
+			if (line && fread (line, 1, len + 1, file) == len + 1 
+			    && line[len] == '\n' 
+			    && strncmp (line, url, len) == 0) {
+				n = fread (buffer, 1, BLOCK_CACHE_BLOCK_SIZE, 
+					   file);
+				if (ferror (file))
+					n = -1;
+			}
+			fclose (file);
+			if (n >= 0)
+				(void) utime (path, NULL); // keep LRU order
+		}
+	}
+
+	talloc_free (tmp_ctx);
+	return n;
+}
+
+
+/******************************************************************************
+ * disk_write
+ *	Store a block in the disk cache. 
+ *	Must be called with "g_mutex" unlocked.
+ *****************************************************************************/
+static void
+disk_write (const char* url, off_t block, const char* buffer, size_t size)
+{
+	void* const tmp_ctx = talloc_new (NULL);
+	char* const name = get_block_name (tmp_ctx, url, block);
+	char* const path = talloc_asprintf (tmp_ctx, "%s/%s", g_dir, name);
+	char* const tmp_path = talloc_asprintf (tmp_ctx, "%s/tmpXXXXXX", 
+						g_dir);
+	if (name == NULL || path == NULL || tmp_path == NULL)
+		goto cleanup; // ---------->
+
+	/*
+	 * Write to a temporary file, then rename it, so that readers never
+	 * see a partially written block.
+	 */
+	bool ok = false;
+	int const fd = mkstemp (tmp_path);
+	if (fd >= 0) {
+		FILE* const file = fdopen (fd, "w");
+		if (file) {
+			ok = (fprintf (file, "%s\n", url) > 0 &&
+			      fwrite (buffer, 1, size, file) == size);
+			ok = (fclose (file) == 0) && ok;
+		} else {
+			close (fd);
+		}
+		if (ok)
+			ok = (rename (tmp_path, path) == 0);
+		if (! ok)
+			(void) unlink (tmp_path);
+	}
+
+	ithread_mutex_lock (&g_mutex);
+	if (ok) {
+		add_block (name, strlen (url) + 1 + size);
+		evict_blocks();
+	} else {
+		g_nr_error++;
+		Log_Printf (LOG_ERROR, "BlockCache can't write '%s' : %s",
+			    path, strerror (errno));
+	}
+	ithread_mutex_unlock (&g_mutex);
+
+cleanup:
+	talloc_free (tmp_ctx);
+}
+
+
+/******************************************************************************
+ * disk_initialize
+ *	Open the disk cache directory, and reuse blocks from a previous run : 
+ *	the LRU index is rebuilt using the files modification time.
+ *****************************************************************************/
+
+typedef struct _FoundBlock {
+	char*	name;
+	off_t	size;
+	time_t	mtime;
+} FoundBlock;
+
+static int
+compare_mtime (const void* p1, const void* p2)
+{
+	const FoundBlock* const b1 = p1;
+	const FoundBlock* const b2 = p2;
+	return (b1->mtime < b2->mtime ? -1 : (b1->mtime > b2->mtime));
+}
+
+static int
+disk_initialize (const char* dir, off_t max_size)
+{
+	if (max_size <= 0) {
+		Log_Printf (LOG_ERROR, "BlockCache invalid size %" PRIdMAX
+			    " for directory '%s'", (intmax_t) max_size, dir);
+		return EINVAL; // ---------->
+	}
+	if (mkdir (dir, 0700) != 0 && errno != EEXIST) {
+		int const rc = errno;
+		Log_Printf (LOG_ERROR, "BlockCache can't create directory "
+			    "'%s' : %s", dir, strerror (rc));
+		return rc; // ---------->
+	}
+	DIR* const d = opendir (dir);
+	if (d == NULL) {
+		int const rc = errno;
+		Log_Printf (LOG_ERROR, "BlockCache can't open directory "
+			    "'%s' : %s", dir, strerror (rc));
+		return rc; // ---------->
+	}
+	g_blocks = hash_initialize (1024, NULL, block_hasher, 
+				    block_comparator, NULL);
+	if (g_blocks == NULL) {
+		closedir (d);
+		return ENOMEM; // ---------->
+	}
+
+	void* const tmp_ctx = talloc_new (NULL);
+	FoundBlock* found = NULL;
+	size_t nb_found = 0;
+	struct dirent* de;
+	while ((de = readdir (d))) {
+		const char* const name = de->d_name;
+		if (name[0] == '.')
+			continue; // ---------->
+		char* const path = talloc_asprintf (tmp_ctx, "%s/%s", 
+						    dir, name);
+		struct stat st;
+		if (path == NULL || lstat (path, &st) != 0 || 
+		    ! S_ISREG (st.st_mode))
+			continue; // ---------->
+		size_t const len = strlen (name);
+		if (len > strlen (BLOCK_FILE_SUFFIX) &&
+		    strcmp (name + len - strlen (BLOCK_FILE_SUFFIX),
+			    BLOCK_FILE_SUFFIX) == 0) {
+			found = talloc_realloc (tmp_ctx, found, FoundBlock,
+						nb_found + 1);
+			if (found == NULL)
+				break; // ---------->
+			found[nb_found++] = (FoundBlock) {
+				.name  = talloc_strdup (tmp_ctx, name),
+				.size  = st.st_size,
+				.mtime = st.st_mtime
+			};
+		} else if (strncmp (name, "tmp", 3) == 0) {
+			// leftover from an interrupted write
+			(void) unlink (path);
+		}
+	}
+	closedir (d);
+
+	ithread_mutex_lock (&g_mutex);
+	g_dir      = talloc_strdup (g_context, dir);
+	g_disk_max = max_size;
+	if (found) {
+		qsort (found, nb_found, sizeof (FoundBlock), compare_mtime);
+		size_t i;
+		for (i = 0; i < nb_found; i++) {
+			if (found[i].name)
+				add_block (found[i].name, found[i].size);
+		}
+	}
+	evict_blocks();
+	Log_Printf (LOG_INFO, "BlockCache directory '%s' : %" PRIdMAX 
+		    " bytes in %zu blocks (max %" PRIdMAX " bytes)",
+		    g_dir, (intmax_t) g_disk_size, 
+		    hash_get_n_entries (g_blocks), (intmax_t) g_disk_max);
+	ithread_mutex_unlock (&g_mutex);
+
+	talloc_free (tmp_ctx);
+	return 0;
+}
+
+
+/******************************************************************************
+ * remove_page
+ *	Remove a page from the memory index. The page is freed when its
+ *	last reader releases it. Must be called with "g_mutex" locked.
+ *****************************************************************************/
+static void
+remove_page (Page* page)
+{
+	lru_remove (&g_pages_lru, &page->lru);
+	(void) hash_delete (g_pages, page);
+	g_mem_size -= BLOCK_CACHE_BLOCK_SIZE;
+	page->removed = true;
+	if (page->refcount == 0)
+		talloc_free (page);
+}
+
+
+/******************************************************************************
+ * release_page
+ *	Must be called with "g_mutex" locked.
+ *****************************************************************************/
+static void
+release_page (Page* page)
+{
+	page->refcount--;
+	if (page->removed && page->refcount == 0)
+		talloc_free (page);
+}
+
+
+/******************************************************************************
+ * evict_pages
+ *	Remove least recently used pages (not in use) until the memory cache
+ *	fits its budget. Must be called with "g_mutex" locked.
+ *****************************************************************************/
+static void
+evict_pages ()
+{
+	LruNode* node = g_pages_lru.last;
+	while (g_mem_size > g_mem_max && node) {
+		Page* const page = (Page*) node;
+		node = node->prev;
+		if (page->refcount == 0) {
+			remove_page (page);
+			g_nr_mem_evict++;
+		}
+	}
+}
+
+
+/******************************************************************************
+ * BlockCache_Initialize
+ *****************************************************************************/
+int
+BlockCache_Initialize (size_t mem_size, const char* dir, off_t dir_size)
+{
+	if (g_context) {
+		Log_Printf (LOG_ERROR, "BlockCache already initialised");
+		return EALREADY; // ---------->
+	}
+
+	void* const context = talloc_named_const (NULL, 0, "BlockCache");
+	g_pages = hash_initialize (1024, NULL, page_hasher, 
+				   page_comparator, NULL);
+	if (context == NULL || g_pages == NULL) {
+		talloc_free (context);
+		return ENOMEM; // ---------->
+	}
+	ithread_mutex_init (&g_mutex, NULL);
+	ithread_cond_init (&g_filled_cond, NULL);
+	g_mem_max = mem_size;
+	g_context = context;
+
+	int rc = 0;
+	if (dir && *dir) 
+		rc = disk_initialize (dir, dir_size);
+	return rc;
+}
+
+
+/******************************************************************************
+ * BlockCache_IsEnabled
+ *****************************************************************************/
+bool
+BlockCache_IsEnabled()
+{
+	return (g_context != NULL);
+}
+
+
+/******************************************************************************
+ * BlockCache_Read
+ *****************************************************************************/
+int
+BlockCache_Read (const char* url, off_t block, size_t block_size, 
+		 char* buffer, size_t* nread,
+		 BlockCache_FetchFunction fetch, void* fetch_arg)
+{
+	*nread = 0;
+	if (g_context == NULL || url == NULL || 
+	    block_size > BLOCK_CACHE_BLOCK_SIZE) 
+		return fetch (fetch_arg, block * BLOCK_CACHE_BLOCK_SIZE,
+			      buffer, block_size, nread); // ---------->
+
+	char* const key = talloc_asprintf (NULL, "%s %" PRIdMAX, url, 
+					   (intmax_t) block);
+	if (key == NULL)
+		return fetch (fetch_arg, block * BLOCK_CACHE_BLOCK_SIZE,
+			      buffer, block_size, nread); // ---------->
+
+	ithread_mutex_lock (&g_mutex);
+
+	Page searched = { .key = key };
+	Page* page = hash_lookup (g_pages, &searched);
+	if (page) {
+		/*
+		 * Page already cached, or being filled by another reader :
+		 * share its content.
+		 */
+		page->refcount++;
+		if (page->filling)
+			g_nr_wait++;
+		while (page->filling)
+			ithread_cond_wait (&g_filled_cond, &g_mutex);
+		if (page->valid && page->size == block_size) {
+			g_nr_mem_hit++;
+			lru_remove (&g_pages_lru, &page->lru);
+			lru_push_first (&g_pages_lru, &page->lru);
+			ithread_mutex_unlock (&g_mutex);
+			
+			memcpy (buffer, page->data, page->size);
+			*nread = page->size;
+
+			ithread_mutex_lock (&g_mutex);
+			release_page (page);
+			ithread_mutex_unlock (&g_mutex);
+			talloc_free (key);
+			return 0; // ---------->
+		}
+		release_page (page);
+		page = NULL;
+	} else {
+		/*
+		 * New page : the other readers of this block will wait
+		 * until it is filled.
+		 */
+		page = talloc (g_context, Page);
+		if (page) {
+			*page = (Page) {
+				.key      = key,
+				.data     = talloc_size (page, 
+							 BLOCK_CACHE_BLOCK_SIZE),
+				.refcount = 1,
+				.filling  = true
+			};
+			if (page->data == NULL || 
+			    hash_insert (g_pages, page) == NULL) {
+				talloc_free (page);
+				page = NULL;
+			} else {
+				talloc_steal (page, key);
+				lru_push_first (&g_pages_lru, &page->lru);
+				g_mem_size += BLOCK_CACHE_BLOCK_SIZE;
+			}
+		}
+	}
+
+	ithread_mutex_unlock (&g_mutex);
+
+	if (page == NULL) {
+		// Error, or concurrent fill failed : read directly
+		talloc_free (key);
+		return fetch (fetch_arg, block * BLOCK_CACHE_BLOCK_SIZE,
+			      buffer, block_size, nread); // ---------->
+	}
+
+	// Fill page, from disk cache or network
+	int rc = 0;
+	size_t n = 0;
+	bool const disk_hit = 
+		(g_dir && disk_read (url, block, page->data) == block_size);
+	if (disk_hit) {
+		n = block_size;
+	} else {
+		rc = fetch (fetch_arg, block * BLOCK_CACHE_BLOCK_SIZE, 
+			    page->data, block_size, &n);
+		if (rc == 0 && n == block_size && g_dir)
+			disk_write (url, block, page->data, n);
+	}
+	if (rc == 0) {
+		memcpy (buffer, page->data, n);
+		*nread = n;
+	}
+
+	ithread_mutex_lock (&g_mutex);
+	if (disk_hit)
+		g_nr_disk_hit++;
+	else
+		g_nr_miss++;
+	page->filling = false;
+	page->valid   = (rc == 0 && n == block_size);
+	page->size    = n;
+	if (! page->valid)
+		remove_page (page);
+	ithread_cond_broadcast (&g_filled_cond);
+	release_page (page);
+	evict_pages();
+	ithread_mutex_unlock (&g_mutex);
+
+	return rc;
+}
+
+
+/******************************************************************************
+ * BlockCache_GetStatusString
+ *****************************************************************************/
+char*
+BlockCache_GetStatusString (void* result_context)
+{
+	if (g_context == NULL)
+		return talloc_strdup (result_context, 
+				      "Block cache disabled\n"); // ---------->
+
+	char* p = talloc_strdup (result_context, "");
+
+	ithread_mutex_lock (&g_mutex);
+	tpr (&p, "+- Block size      = %d bytes\n", BLOCK_CACHE_BLOCK_SIZE);
+	tpr (&p, "+- Memory max size = %zu bytes\n", g_mem_max);
+	tpr (&p, "+- Memory size     = %zu bytes (%zu blocks)\n", g_mem_size,
+	     hash_get_n_entries (g_pages));
+	if (g_dir) {
+		tpr (&p, "+- Directory       = %s\n", g_dir);
+		tpr (&p, "+- Disk max size   = %" PRIdMAX " bytes\n", 
+		     (intmax_t) g_disk_max);
+		tpr (&p, "+- Disk size       = %" PRIdMAX 
+		     " bytes (%zu blocks)\n", (intmax_t) g_disk_size, 
+		     hash_get_n_entries (g_blocks));
+	} else {
+		tpr (&p, "+- Directory       = (none)\n");
+	}
+	long const nr_access = g_nr_mem_hit + g_nr_disk_hit + g_nr_miss;
+	tpr (&p, "+- Cache access    = %ld\n", nr_access);
+	if (nr_access > 0) {
+		tpr (&p, "     +- memory hits = %ld (%.1f%%)\n", g_nr_mem_hit,
+		     (float) (g_nr_mem_hit * 100.0 / nr_access));
+		tpr (&p, "     +- disk hits   = %ld (%.1f%%)\n", g_nr_disk_hit,
+		     (float) (g_nr_disk_hit * 100.0 / nr_access));
+		tpr (&p, "     +- misses      = %ld (%.1f%%)\n", g_nr_miss, 
+		     (float) (g_nr_miss * 100.0 / nr_access));
+	}
+	tpr (&p, "+- Shared fills    = %ld\n", g_nr_wait);
+	tpr (&p, "+- Evictions       = %ld memory, %ld disk\n", 
+	     g_nr_mem_evict, g_nr_disk_evict);
+	tpr (&p, "+- Write errors    = %ld\n", g_nr_error);
+	ithread_mutex_unlock (&g_mutex);
+
+	return p;
+}
+
@@ -0,0 +1,137 @@
+/* $Id$
+ *
+ * Block cache : shared cache for the content of remote files.
+ * This file is part of djmount.
+ *
+ * (C) Copyright 2026 djmount contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef BLOCK_CACHE_H_INCLUDED
+#define BLOCK_CACHE_H_INCLUDED
+
+#include <sys/types.h>		// Import "off_t" and "ssize_t"
+#include <stdbool.h>
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/******************************************************************************
+ * Block cache
+ *
+ *	The content of remote files is cached by fixed size blocks,
+ *	keyed by (resource URL, block index). The cache is shared by all 
+ *	open files, and has two levels, each bounded in size (least 
+ *	recently used blocks are evicted first) :
+ *	- in memory : blocks are shared between concurrent readers of the
+ *	  same URL, and concurrent misses on the same block are collapsed 
+ *	  into a single fetch ;
+ *	- optionally, on disk in a cache directory.
+ *
+ *	All functions are thread safe. If the cache has not been initialised,
+ *	it is disabled : BlockCache_Read always calls the fetch function.
+ *
+ *****************************************************************************/
+
+
+/******************************************************************************
+ * @var BLOCK_CACHE_BLOCK_SIZE
+ *	Size of each cached block (except possibly the last block of a file).
+ *****************************************************************************/
+
+#define BLOCK_CACHE_BLOCK_SIZE		(128*1024)
+
+
+/******************************************************************************
+ * @var BlockCache_FetchFunction
+ *	Function called to read a missing block from its source.
+ *	Returns 0 if ok, else an error code which is returned unchanged 
+ *	by BlockCache_Read.
+ *
+ * @param arg		opaque argument given to BlockCache_Read
+ * @param offset	offset of the block in the file
+ * @param buffer	buffer to fill
+ * @param size		block size
+ * @param nread		number of bytes actually read
+ *****************************************************************************/
+
+typedef int (*BlockCache_FetchFunction) (void* arg, off_t offset, 
+					 char* buffer, size_t size, 
+					 size_t* nread);
+
+
+/*****************************************************************************
+ * @brief Initialises the cache. 
+ *	If a directory is provided, it is created if necessary ; blocks 
+ *	already present (e.g. from a previous run) are reused.
+ *
+ * @param mem_size	maximum size in bytes of blocks cached in memory
+ * @param dir		the cache directory, or NULL if no disk cache
+ * @param dir_size	maximum size in bytes of all blocks cached on disk
+ * @return 0 if ok, non 0 if error (if the error only concerns the 
+ *	   directory, the memory cache is still enabled)
+ *****************************************************************************/
+int
+BlockCache_Initialize (size_t mem_size, const char* dir, off_t dir_size);
+
+
+/*****************************************************************************
+ * @brief Returns true if the cache has been successfully initialised.
+ *****************************************************************************/
+bool
+BlockCache_IsEnabled();
+
+
+/*****************************************************************************
+ * @brief Read a block through the cache : if the block is not cached,
+ *	it is read using the fetch function, then cached if complete
+ *	(i.e. "block_size" bytes read).
+ *
+ * @param url		the resource URL
+ * @param block		the block index (i.e. offset / BLOCK_CACHE_BLOCK_SIZE)
+ * @param block_size	the block size (smaller for the last block of 
+ *			a file, else BLOCK_CACHE_BLOCK_SIZE)
+ * @param buffer	buffer of at least "block_size" bytes
+ * @param nread		number of bytes read
+ * @param fetch		function to read a missing block
+ * @param fetch_arg	argument for the fetch function
+ * @return 		0 if ok, else the error returned by "fetch"
+ *****************************************************************************/
+int
+BlockCache_Read (const char* url, off_t block, size_t block_size,
+		 char* buffer, size_t* nread,
+		 BlockCache_FetchFunction fetch, void* fetch_arg);
+
+
+/*****************************************************************************
+ * @brief Returns a string describing the cache state and statistics.
+ *	The returned string should be freed using "talloc_free".
+ *
+ * @param result_context	parent context to allocate result, may be NULL
+ *****************************************************************************/
+char*
+BlockCache_GetStatusString (void* result_context);
+
+
+#ifdef __cplusplus
+}; // extern "C"
+#endif 
+
+
+#endif // BLOCK_CACHE_H_INCLUDED
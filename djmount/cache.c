@@ -30,6 +30,7 @@
 #include "log.h"
 #include "minmax.h"
 #include <time.h>
+#include <errno.h>
 
 
 /*
@@ -73,6 +74,14 @@ typedef struct _Entry {
 	//  - "rip == 0" always means cached data is invalid.
 	time_t		rip;
 	void*		data;
+
+	// Least recently used list (see Cache "lru_head")
+	struct _Entry*	prev;
+	struct _Entry*	next;
+	size_t		bytes;	// size of data, if memory is limited
+
+	// Position in the expiration heap + 1, or 0 if not in the heap
+	size_t		heap_index;
 	
 } Entry;
 
@@ -80,6 +89,7 @@ typedef struct _Entry {
 struct _Cache {
 	size_t		 size;
 	time_t		 max_age;	// set to 0 to disable ageing
+	time_t		 max_stale;	// expired data kept, see Cache_GetStale
 	time_t		 next_clean;
 #if CACHE_FIXED_SIZE
 	Entry*		 table;
@@ -89,10 +99,38 @@ struct _Cache {
 
 	Cache_FreeExpiredData	free_expired_data;
 
+	// Entries in use order, from the most recently used "lru_head"
+	// to the least recently used "lru_tail" (evicted first).
+	Entry*		 lru_head;
+	Entry*		 lru_tail;
+	Entry*		 last;		// last returned : data may have changed
+
+	// Limits, see Cache_SetLimits (0 if no limit)
+	size_t		 max_entries;
+	size_t		 max_bytes;
+	size_t		 nr_bytes;
+	Cache_DataSize	 data_size;
+
+	// Binary min-heap of entries, ordered by expiration time "rip" :
+	// the expired entries are at the top.
+	Entry**		 heap;
+	size_t		 heap_size;
+	size_t		 heap_alloc;
+
+	// Purge in the background, see Cache_StartJanitor
+	ithread_mutex_t* janitor_mutex;
+	struct _Cache*	 janitor_next;
+	Cache_JanitorHook janitor_hook;
+	void*		 janitor_hook_data;
+	bool		 janitor_hook_pending;
+	bool		 janitor_hook_running;
+
 	// Debug statistics
 	int		 nr_access;
 	int		 nr_hit;
+	int		 nr_stale;
 	int		 nr_expired;
+	int		 nr_evicted;
 #if CACHE_FIXED_SIZE
 	int		 nr_collide;
 	size_t		 nr_entries;
@@ -150,7 +188,7 @@ cache_get (Cache* cache, const char* key, bool* hit)
 	} else {
 		*hit = false;
 		if (ce->key) {
-			Log_Printf (LOG_DEBUG, 
+			LOG_PRINTF (LOG_DEBUG, 
 				    "CACHE_COLLIDE (old='%s', new='%s')",
 				    ce->key, key);
 			cache->nr_collide++;
@@ -171,7 +209,7 @@ cache_get (Cache* cache, const char* key, bool* hit)
 		*hit = true;
 	} else {
 		*hit = false;
-		ce = talloc (cache, Entry);
+		ce = talloc_zero (cache, Entry);
 		if (ce) {
 			ce->key = talloc_strdup (ce, key);
 			if (ce->key == NULL)
@@ -185,65 +223,303 @@ cache_get (Cache* cache, const char* key, bool* hit)
 
 
 /******************************************************************************
- * cache_expire_entries
- *	garbage collection
+ * cache_touch
+ *	Move an entry to the head of the least recently used list
  *****************************************************************************/
+static void
+cache_unlink (Cache* cache, Entry* ce)
+{
+	if (ce->prev)
+		ce->prev->next = ce->next;
+	else if (cache->lru_head == ce)
+		cache->lru_head = ce->next;
+	if (ce->next)
+		ce->next->prev = ce->prev;
+	else if (cache->lru_tail == ce)
+		cache->lru_tail = ce->prev;
+	ce->prev = ce->next = NULL;
+}
 
 static void
-cache_expire_entries (Cache* cache, time_t const now)
-{	
-	if (cache->max_age > 0 && now > cache->next_clean) {
-		int i;
-#if CACHE_FIXED_SIZE
-		for (i = 0; i < cache->size; i++) {
-			Entry* const ce = cache->table + i;
-			if (ce->key && now > ce->rip) {
-				Log_Printf (LOG_DEBUG, 
-					    "CACHE_CLEAN (key='%s')", ce->key);
-				if (cache->free_expired_data)
-					cache->free_expired_data (ce->key, 
-								  ce->data);
-				ce->data = NULL;
-				talloc_free (ce->key);
-				ce->key = NULL;
-				cache->nr_entries--;
+cache_touch (Cache* cache, Entry* ce)
+{
+	if (cache->lru_head != ce) {
+		cache_unlink (cache, ce);
+		ce->next = cache->lru_head;
+		if (cache->lru_head)
+			cache->lru_head->prev = ce;
+		cache->lru_head = ce;
+		if (cache->lru_tail == NULL)
+			cache->lru_tail = ce;
+	}
+}
+
+
+/******************************************************************************
+ * heap_update
+ * heap_remove
+ *	Maintain the expiration heap : O(log n)
+ *****************************************************************************/
+static void
+heap_set (Cache* cache, size_t i, Entry* ce)
+{
+	cache->heap [i] = ce;
+	ce->heap_index  = i + 1;
+}
+
+static void
+heap_sift_up (Cache* cache, size_t i)
+{
+	Entry* const ce = cache->heap [i];
+	while (i > 0) {
+		size_t const parent = (i - 1) / 2;
+		if (cache->heap [parent]->rip <= ce->rip)
+			break; // ---------->
+		heap_set (cache, i, cache->heap [parent]);
+		i = parent;
+	}
+	heap_set (cache, i, ce);
+}
+
+static void
+heap_sift_down (Cache* cache, size_t i)
+{
+	Entry* const ce = cache->heap [i];
+	size_t const n  = cache->heap_size;
+	while (2 * i + 1 < n) {
+		size_t child = 2 * i + 1;
+		if (child + 1 < n && 
+		    cache->heap [child + 1]->rip < cache->heap [child]->rip)
+			child++;
+		if (ce->rip <= cache->heap [child]->rip)
+			break; // ---------->
+		heap_set (cache, i, cache->heap [child]);
+		i = child;
+	}
+	heap_set (cache, i, ce);
+}
+
+// Insert an entry, or move it after its expiration time has changed
+static void
+heap_update (Cache* cache, Entry* ce)
+{
+	if (ce->heap_index == 0) {
+		if (cache->heap_size >= cache->heap_alloc) {
+			size_t const alloc = MAX (2 * cache->heap_alloc, 
+						  cache->size);
+			Entry** const heap = talloc_realloc 
+				(cache, cache->heap, Entry*, alloc);
+			if (heap == NULL) {
+				Log_Printf (LOG_ERROR, "Cache: can't grow "
+					    "heap (key='%s')", ce->key);
+				return; // ---------->
 			}
-	
+			cache->heap	  = heap;
+			cache->heap_alloc = alloc;
 		}
+		heap_set (cache, cache->heap_size++, ce);
+	}
+	heap_sift_up (cache, ce->heap_index - 1);
+	heap_sift_down (cache, ce->heap_index - 1);
+}
+
+static void
+heap_remove (Cache* cache, Entry* ce)
+{
+	if (ce->heap_index > 0) {
+		size_t const i = ce->heap_index - 1;
+		Entry* const last = cache->heap [--cache->heap_size];
+		ce->heap_index = 0;
+		if (last != ce) {
+			heap_set (cache, i, last);
+			heap_sift_up (cache, i);
+			heap_sift_down (cache, last->heap_index - 1);
+		}
+	}
+}
+
+
+/******************************************************************************
+ * cache_account
+ *	Update the size of the data of an entry
+ *****************************************************************************/
+static void
+cache_account (Cache* cache, Entry* ce)
+{
+	if (cache->max_bytes > 0) {
+		size_t const bytes = 
+			(ce->data == NULL ? 0 :
+			 cache->data_size ? cache->data_size (ce->data) : 
+			 talloc_total_size (ce->data));
+		cache->nr_bytes = cache->nr_bytes - ce->bytes + bytes;
+		ce->bytes = bytes;
+	}
+}
+
+
+/******************************************************************************
+ * cache_delete_entry
+ *	Free the data of an entry, which is already out of the hash table
+ *****************************************************************************/
+static void
+cache_delete_entry (Cache* cache, Entry* ce)
+{
+	if (cache->free_expired_data)
+		cache->free_expired_data (ce->key, ce->data);
+	ce->data = NULL;
+	cache_account (cache, ce);
+	cache_unlink (cache, ce);
+	heap_remove (cache, ce);
+	if (cache->last == ce)
+		cache->last = NULL;
+#if CACHE_FIXED_SIZE
+	talloc_free (ce->key);
+	ce->key = NULL;
+	cache->nr_entries--;
 #else
-		size_t const n = hash_get_n_entries (cache->table);
-		// Pb with "Hash_table" API : it is not allowed to modify 
-		// the hash table when walking it. Therefore we have to get 
-		// the entries first, then delete the expired ones.
-		void* entries [n];
-		size_t const nn = hash_get_entries (cache->table, entries, n);
-		for (i = 0; i < nn; i++) {
-			Entry* ce = (Entry*) entries[i];
-			if (now > ce->rip) {
-				Log_Printf (LOG_DEBUG, 
-					    "CACHE_CLEAN (key='%s')", ce->key);
-				ce = hash_delete (cache->table, ce);
-				if (ce) {
-					if (cache->free_expired_data)
-						cache->free_expired_data 
-							(ce->key, ce->data);
-					ce->data = NULL;
-					talloc_free (ce);
-				}
-			}
+	talloc_free (ce);
+#endif
+}
+
+
+/******************************************************************************
+ * cache_evict_entries
+ *	Remove the least recently used entries in excess of the limits,
+ *	except "keep"
+ *****************************************************************************/
+static void
+cache_evict_entries (Cache* cache, const Entry* const keep)
+{
+	while (cache->lru_tail && cache->lru_tail != keep &&
+	       ((cache->max_entries > 0 && 
+		 Cache_GetNrEntries (cache) > cache->max_entries) ||
+		(cache->max_bytes > 0 && cache->nr_bytes > cache->max_bytes))) {
+		Entry* ce = cache->lru_tail;
+		LOG_PRINTF (LOG_DEBUG, "CACHE_EVICT (key='%s')", ce->key);
+		cache->nr_evicted++;
+#if !CACHE_FIXED_SIZE
+		ce = hash_delete (cache->table, ce);
+		if (ce == NULL) 
+			break; // ---------->
+#endif
+		cache_delete_entry (cache, ce);
+	}
+}
+
+
+/******************************************************************************
+ * cache_expire_entries
+ *	garbage collection : O(K log n) for K expired entries
+ *****************************************************************************/
+
+static long
+cache_expire_entries (Cache* cache, time_t const now)
+{	
+	long nb_expired = 0;
+	cache->next_clean = now + CACHE_CLEAN_PERIOD;
+	while (cache->max_age > 0 && cache->heap_size > 0 &&
+	       now > cache->heap [0]->rip + cache->max_stale) {
+		Entry* ce = cache->heap [0];
+		LOG_PRINTF (LOG_DEBUG, "CACHE_CLEAN (key='%s')", ce->key);
+#if !CACHE_FIXED_SIZE
+		if (hash_delete (cache->table, ce) != ce) {
+			heap_remove (cache, ce);
+			continue; // ---------->
 		}
 #endif
-		cache->next_clean = now + CACHE_CLEAN_PERIOD;
+		cache_delete_entry (cache, ce);
+		nb_expired++;
+	}
+	return nb_expired;
+}
+
+
+/******************************************************************************
+ * Janitor
+ *	A background thread purges the caches registered by 
+ *	Cache_StartJanitor, with the lock of each cache held. Then it calls
+ *	their hooks (see Cache_SetJanitorHook) with all the locks released, 
+ *	so that a long hook does not delay the registration or removal of 
+ *	the other caches : a cache being removed waits for its own hook only.
+ *****************************************************************************/
+
+static ithread_mutex_t	g_janitor_mutex = PTHREAD_MUTEX_INITIALIZER;
+static ithread_cond_t	g_janitor_cond = PTHREAD_COND_INITIALIZER;
+static Cache*		g_janitor_caches = NULL;
+static ithread_t	g_janitor_thread;
+static bool		g_janitor_started = false;
+
+static void*
+JanitorLoop (void* arg)
+{
+	while (true) {
+		isleep (CACHE_CLEAN_PERIOD);
+		ithread_mutex_lock (&g_janitor_mutex);
+		Cache* cache;
+		for (cache = g_janitor_caches; cache; 
+		     cache = cache->janitor_next) {
+			ithread_mutex_lock (cache->janitor_mutex);
+			cache_expire_entries (cache, time (NULL));
+			ithread_mutex_unlock (cache->janitor_mutex);
+			cache->janitor_hook_pending = 
+				(cache->janitor_hook != NULL);
+		}
+		// Call the hooks one at a time, the running one keeping 
+		// its cache registered (see janitor_remove)
+		do {
+			for (cache = g_janitor_caches; 
+			     cache && ! cache->janitor_hook_pending;
+			     cache = cache->janitor_next)
+				;
+			if (cache) {
+				cache->janitor_hook_pending = false;
+				cache->janitor_hook_running = true;
+				ithread_mutex_unlock (&g_janitor_mutex);
+
+				cache->janitor_hook (cache->janitor_hook_data);
+
+				ithread_mutex_lock (&g_janitor_mutex);
+				cache->janitor_hook_running = false;
+				ithread_cond_broadcast (&g_janitor_cond);
+			}
+		} while (cache);
+		ithread_mutex_unlock (&g_janitor_mutex);
 	}
+	return NULL;
+}
+
+static void
+janitor_remove (Cache* cache)
+{
+	ithread_mutex_lock (&g_janitor_mutex);
+	Cache** pp = &g_janitor_caches;
+	while (*pp && *pp != cache)
+		pp = &(*pp)->janitor_next;
+	if (*pp)
+		*pp = cache->janitor_next;
+	cache->janitor_hook_pending = false;
+	while (cache->janitor_hook_running)
+		ithread_cond_wait (&g_janitor_cond, &g_janitor_mutex);
+	cache->janitor_mutex = NULL;
+	ithread_mutex_unlock (&g_janitor_mutex);
 }
 
 
 /******************************************************************************
  * Cache_Get
+ * Cache_GetStale
  *****************************************************************************/
 void**
 Cache_Get (Cache* cache, const char* key)
 {
+	return Cache_GetStale (cache, key, NULL);
+}
+
+void**
+Cache_GetStale (Cache* cache, const char* key, bool* stale)
+{
+	if (stale)
+		*stale = false;
 	if (cache == NULL || key == NULL) {
 		Log_Printf (LOG_ERROR, "Cache_Get NULL key or cache");
 		return NULL; // ---------->
@@ -254,6 +530,10 @@ Cache_Get (Cache* cache, const char* key)
 	 */   
 	cache->nr_access++;
 
+	// The data of the last returned entry may have been set since
+	if (cache->last)
+		cache_account (cache, cache->last);
+
 	const time_t now = time (NULL);
 	bool hit;
 	Entry* const ce  = cache_get (cache, key, &hit);
@@ -264,27 +544,174 @@ Cache_Get (Cache* cache, const char* key)
 
 	if (hit) {
 		if (cache->max_age == 0 || now <= ce->rip) {
-			Log_Printf (LOG_DEBUG, "CACHE_HIT (key='%s')", key);
+			LOG_PRINTF (LOG_DEBUG, "CACHE_HIT (key='%s')", key);
 			cache->nr_hit++;
+		} else if (stale && now <= ce->rip + cache->max_stale) {
+			LOG_PRINTF (LOG_DEBUG, "CACHE_STALE (key='%s')", key);
+			cache->nr_stale++;
+			*stale = true;
 		} else {
-			Log_Printf (LOG_DEBUG, "CACHE_EXPIRED (key='%s')",
+			LOG_PRINTF (LOG_DEBUG, "CACHE_EXPIRED (key='%s')",
 				    key);
 			cache->nr_expired++;
 			if (cache->free_expired_data)
 				cache->free_expired_data (ce->key, ce->data);
 			ce->rip  = now + cache->max_age;
 			ce->data = NULL;
+			heap_update (cache, ce);
 		}
+		// Data may have changed since its last access
+		cache_account (cache, ce);
 	} else {
-		Log_Printf (LOG_DEBUG, "CACHE_NEW (key='%s')", key);
+		LOG_PRINTF (LOG_DEBUG, "CACHE_NEW (key='%s')", key);
 		ce->rip  = now + cache->max_age;
 		ce->data = NULL;
-		cache_expire_entries (cache, now);
+		heap_update (cache, ce);
+		if (cache->janitor_mutex == NULL && now > cache->next_clean)
+			cache_expire_entries (cache, now);
 	}
+	cache_touch (cache, ce);
+	cache_evict_entries (cache, ce);
+	cache->last = ce;
 	return &(ce->data); // ---------->
 }
 
 
+/*****************************************************************************
+ * Cache_Remove
+ *****************************************************************************/
+bool
+Cache_Remove (Cache* cache, const char* key)
+{
+	if (cache == NULL || key == NULL)
+		return false; // ---------->
+
+#if CACHE_FIXED_SIZE 
+	size_t const h   = String_Hash (key);
+	Entry* const ce  = cache->table + (h % cache->size);
+	if (ce->key == NULL || ce->hash != h || strcmp (ce->key, key) != 0)
+		return false; // ---------->
+#else
+	Entry const searched = { .key = key };
+	Entry* const ce = hash_delete (cache->table, &searched);
+	if (ce == NULL)
+		return false; // ---------->
+#endif
+	LOG_PRINTF (LOG_DEBUG, "CACHE_REMOVE (key='%s')", key);
+	cache_delete_entry (cache, ce);
+	return true;
+}
+
+
+/*****************************************************************************
+ * Cache_RemoveMatching
+ *****************************************************************************/
+long
+Cache_RemoveMatching (Cache* cache, Cache_KeyMatch match, void* match_data)
+{
+	if (cache == NULL)
+		return -1; // ---------->
+
+	long nb_removed = 0;
+	size_t i;
+#if CACHE_FIXED_SIZE
+	for (i = 0; i < cache->size; i++) {
+		Entry* const ce = cache->table + i;
+		if (ce->key && (match == NULL || match (ce->key, match_data))){
+			LOG_PRINTF (LOG_DEBUG, "CACHE_REMOVE (key='%s')", 
+				    ce->key);
+			cache_delete_entry (cache, ce);
+			nb_removed++;
+		}
+	}
+#else
+	// The hash table can't be modified while walking it : get the 
+	// entries first, then delete the matching ones.
+	size_t const n = hash_get_n_entries (cache->table);
+	void** const entries = talloc_array (NULL, void*, n);
+	if (entries == NULL && n > 0)
+		return -1; // ---------->
+	size_t const nn = hash_get_entries (cache->table, entries, n);
+	for (i = 0; i < nn; i++) {
+		Entry* ce = (Entry*) entries[i];
+		if (match == NULL || match (ce->key, match_data)) {
+			LOG_PRINTF (LOG_DEBUG, "CACHE_REMOVE (key='%s')", 
+				    ce->key);
+			ce = hash_delete (cache->table, ce);
+			if (ce) {
+				cache_delete_entry (cache, ce);
+				nb_removed++;
+			}
+		}
+	}
+	talloc_free (entries);
+#endif
+	return nb_removed;
+}
+
+
+/*****************************************************************************
+ * Cache_ForEach
+ *****************************************************************************/
+void
+Cache_ForEach (Cache* cache, Cache_Visitor visit, void* visit_data)
+{
+	if (cache == NULL || visit == NULL)
+		return; // ---------->
+
+	const Entry* ce;
+	for (ce = cache->lru_head; ce; ce = ce->next) {
+		if (ce->key && ce->rip != 0)
+			visit (ce->key, ce->data, visit_data);
+	}
+}
+
+
+/*****************************************************************************
+ * Cache_SetMaxAge
+ *****************************************************************************/
+void
+Cache_SetMaxAge (Cache* cache, time_t max_age)
+{
+	if (cache)
+		cache->max_age = max_age;
+}
+
+
+/*****************************************************************************
+ * Cache_SetLimits
+ *****************************************************************************/
+void
+Cache_SetLimits (Cache* cache, size_t max_entries, size_t max_bytes,
+		 Cache_DataSize data_size)
+{
+	if (cache) {
+		cache->max_entries = max_entries;
+		cache->max_bytes   = max_bytes;
+		cache->data_size   = data_size;
+		// Account all entries again
+		cache->nr_bytes = 0;
+		Entry* ce;
+		for (ce = cache->lru_head; ce; ce = ce->next) {
+			ce->bytes = 0;
+			cache_account (cache, ce);
+		}
+		cache_evict_entries (cache, NULL);
+	}
+}
+
+
+/*****************************************************************************
+ * Cache_SetMaxStale
+ *****************************************************************************/
+void
+Cache_SetMaxStale (Cache* cache, time_t max_stale)
+{
+	if (cache)
+		cache->max_stale = MAX (max_stale, 0);
+}
+
+
 /*****************************************************************************
  * Cache_GetNrEntries
  *****************************************************************************/
@@ -303,15 +730,61 @@ Cache_GetNrEntries (const Cache* const cache)
 
 
 /*****************************************************************************
- * _Cache_PurgeExpiredEntries 
+ * Cache_PurgeExpiredEntries 
+ *****************************************************************************/
+long
+Cache_PurgeExpiredEntries (Cache* cache)
+{
+	if (cache == NULL)
+		return -1; // ---------->
+	
+	return cache_expire_entries (cache, time (NULL));
+}
+
+
+/*****************************************************************************
+ * Cache_StartJanitor
+ *****************************************************************************/
+int
+Cache_StartJanitor (Cache* cache, ithread_mutex_t* mutex)
+{
+	if (cache == NULL || mutex == NULL || cache->janitor_mutex)
+		return EINVAL; // ---------->
+
+	int rc = 0;
+	ithread_mutex_lock (&g_janitor_mutex);
+	if (! g_janitor_started) {
+		rc = ithread_create (&g_janitor_thread, NULL, JanitorLoop, 
+				     NULL);
+		if (rc == 0) {
+			ithread_detach (g_janitor_thread);
+			g_janitor_started = true;
+		} else {
+			Log_Printf (LOG_ERROR, "Cache: can't create janitor "
+				    "thread, error %d", rc);
+		}
+	}
+	if (rc == 0) {
+		cache->janitor_mutex = mutex;
+		cache->janitor_next  = g_janitor_caches;
+		g_janitor_caches     = cache;
+	}
+	ithread_mutex_unlock (&g_janitor_mutex);
+	return rc;
+}
+
+
+/*****************************************************************************
+ * Cache_SetJanitorHook
  *****************************************************************************/
 void
-_Cache_PurgeExpiredEntries (Cache* cache)
+Cache_SetJanitorHook (Cache* cache, Cache_JanitorHook hook, void* hook_data)
 {
 	if (cache) {
-		const time_t now = time (NULL);
-		cache->next_clean = now-1;
-		cache_expire_entries (cache, now);
+		ithread_mutex_lock (&g_janitor_mutex);
+		cache->janitor_hook	 = hook;
+		cache->janitor_hook_data = hook_data;
+		ithread_mutex_unlock (&g_janitor_mutex);
 	}
 }
 
@@ -337,17 +810,35 @@ Cache_GetStatusString (const Cache* const cache,
 		tpr (&p, "%ld seconds\n", (long) cache->max_age);
 	else 
 		tpr (&p, "disabled\n");
+	if (cache->max_stale > 0)
+		tpr (&p, "%s+- Cache max stale = %ld seconds\n", spacer,
+		     (long) cache->max_stale);
 	const long nb_cached = Cache_GetNrEntries (cache);
 	tpr (&p, "%s+- Cached entries  = %ld (%d%%)\n", spacer, nb_cached,
 	     (int) (nb_cached * 100 / cache->size));
+	if (cache->max_entries > 0)
+		tpr (&p, "%s+- Max entries     = %ld\n", spacer, 
+		     (long) cache->max_entries);
+	if (cache->max_bytes > 0)
+		tpr (&p, "%s+- Cache memory    = %ld KB (max %ld KB)\n", 
+		     spacer, (long) (cache->nr_bytes / 1024),
+		     (long) (cache->max_bytes / 1024));
 	tpr (&p, "%s+- Cache access    = %d\n", spacer, cache->nr_access);
 	if (cache->nr_access > 0) {
 		tpr (&p, "%s     +- hits       = %d (%.1f%%)\n", spacer, 
 		     cache->nr_hit, 
 		     (float) (cache->nr_hit * 100.0 / cache->nr_access));
+		if (cache->max_stale > 0)
+			tpr (&p, "%s     +- stale      = %d (%.1f%%)\n", 
+			     spacer, cache->nr_stale, 
+			     (float) (cache->nr_stale * 100.0 / 
+				      cache->nr_access));
 		tpr (&p, "%s     +- expired    = %d (%.1f%%)\n", spacer, 
 		     cache->nr_expired, 
 		     (float) (cache->nr_expired * 100.0 / cache->nr_access));
+		tpr (&p, "%s     +- evicted    = %d (%.1f%%)\n", spacer, 
+		     cache->nr_evicted, 
+		     (float) (cache->nr_evicted * 100.0 / cache->nr_access));
 #if CACHE_FIXED_SIZE
 		tpr (&p, "%s     +- collide    = %d (%.1f%%)\n", spacer, 
 		     cache->nr_collide, 
@@ -369,6 +860,8 @@ static int
 cache_destroy (Cache* const cache)
 {
 	if (cache) {
+		if (cache->janitor_mutex)
+			janitor_remove (cache);
 #if !CACHE_FIXED_SIZE
 		hash_free (cache->table);
 #endif
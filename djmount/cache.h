@@ -25,6 +25,7 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <upnp/ithread.h>
 
 #ifndef __GLIBC__
 #include <sys/time.h>
@@ -52,6 +53,14 @@ typedef struct _Cache Cache;
 typedef void (*Cache_FreeExpiredData) (const char* key, void* data);
 
 
+/******************************************************************************
+ * @var Prototype of function returning the memory size of cached data,
+ *	in bytes (see Cache_SetLimits)
+ *****************************************************************************/
+
+typedef size_t (*Cache_DataSize) (const void* data);
+
+
 /*****************************************************************************
  * @brief 	Create a cache
  *		The returned object can be destroyed with "talloc_free".
@@ -60,7 +69,8 @@ typedef void (*Cache_FreeExpiredData) (const char* key, void* data);
  *
  * @param context       the talloc parent context
  * @param size          the minimum number of entries in the cache
- *			(entries in excess are removed only if expired)
+ *			(entries in excess are removed only if expired,
+ *			unless limited with "Cache_SetLimits")
  * @param max_age	the maximum age in seconds of each cache entry 
  *			(before it expires). Set to zero to disable ageing.
  * @free_expired_data	the function called to dispose of expired data
@@ -82,19 +92,95 @@ void**
 Cache_Get (Cache* cache, const char* key);
 
 
-#if 0 // Not Yet Implemented
+/******************************************************************************
+ * @brief	Same as "Cache_Get", except that the data of an expired entry
+ *		is kept, and returned, during the stale time of the cache 
+ *		(see "Cache_SetMaxStale") : "*stale" is then set to true.
+ *		
+ *	The caller should then refresh the data : to reset the age of
+ *	the entry, remove it and get it again.
+ *****************************************************************************/
+void**
+Cache_GetStale (Cache* cache, const char* key, bool* stale);
+
+
 /******************************************************************************
  * @brief	Remove an entry from the cache.
  *		
- *	If "expire" is true, the old data is deleted using 
- *	"Cache_FreeExpiredData" and the function returns NULL.
- *	If "expire" is false, the data is removed from the cache but not
- *	deleted, and a pointer to the old data is returned.
- *
+ *	The data of the entry is deleted using "Cache_FreeExpiredData".
+ *	Returns true if the entry was in the cache, false otherwise.
  *****************************************************************************/
-void*
+bool
 Cache_Remove (Cache* cache, const char* key);
-#endif
+
+
+/******************************************************************************
+ * @var Prototype of function selecting the entries to remove
+ *****************************************************************************/
+
+typedef bool (*Cache_KeyMatch) (const char* key, void* match_data);
+
+
+/******************************************************************************
+ * @brief	Remove all the entries whose key matches, or all the entries 
+ *		if "match" is NULL.
+ *		
+ *	The data of the entries is deleted using "Cache_FreeExpiredData".
+ *	Returns the number of removed entries (or -1 if error).
+ *****************************************************************************/
+long
+Cache_RemoveMatching (Cache* cache, Cache_KeyMatch match, void* match_data);
+
+
+/******************************************************************************
+ * @brief	Call "visit" on each cached entry, from the most recently
+ *		used to the least recently used one. The expired entries 
+ *		not deleted yet (see Cache_SetMaxStale) are included.
+ *		The cache shall not be modified by "visit".
+ *****************************************************************************/
+
+typedef void (*Cache_Visitor) (const char* key, void* data, 
+			       void* visit_data);
+
+void
+Cache_ForEach (Cache* cache, Cache_Visitor visit, void* visit_data);
+
+
+/******************************************************************************
+ * @brief	Change the maximum age of cache entries.
+ *
+ *	The new age applies to the entries created (or refreshed) after 
+ *	this call ; the entries already cached keep their expiration time.
+ *****************************************************************************/
+void
+Cache_SetMaxAge (Cache* cache, time_t max_age);
+
+
+/******************************************************************************
+ * @brief	Limit the size of the cache. The least recently used entries
+ *		are removed (before they expire) to keep within the limits.
+ *
+ *	The size of the data of an entry is computed with "data_size", 
+ *	or with "talloc_total_size" if NULL. It is updated when the entry
+ *	is accessed, and after the data returned by the last "Cache_Get" 
+ *	is set, i.e. on the next call.
+ *
+ * @param max_entries	maximum number of entries (0 if no limit)
+ * @param max_bytes	maximum size of cached data (0 if no limit)
+ * @param data_size	function returning the size of cached data
+ *****************************************************************************/
+void
+Cache_SetLimits (Cache* cache, size_t max_entries, size_t max_bytes,
+		 Cache_DataSize data_size);
+
+
+/******************************************************************************
+ * @brief	Set how long (in seconds) the expired entries are kept, 
+ *		and returned by "Cache_GetStale", after their maximum age.
+ *		Set to zero (the default) to delete expired entries at once.
+ *****************************************************************************/
+void
+Cache_SetMaxStale (Cache* cache, time_t max_stale);
 
 
 /*****************************************************************************
@@ -104,14 +190,45 @@ long
 Cache_GetNrEntries (const Cache* const cache);
 
 
-#if TEST_CACHE
 /*****************************************************************************
- * @brief Check the whole cache and delete any expired data in it.
- *	  (function for testing purposes only).
+ * @brief Delete the expired entries, and their data. Costs O(K log n)
+ *	  for K expired entries among n.
+ *	  Returns the number of deleted entries (or -1 if error).
+ *
+ *	  Unless a janitor is started, this is done regularly when new 
+ *	  entries are created.
+ *****************************************************************************/
+long
+Cache_PurgeExpiredEntries (Cache* cache);
+
+
+/*****************************************************************************
+ * @brief Delete the expired entries in a background thread, with "mutex"
+ *	  locked, instead of when new entries are created.
+ *	  The janitor stops when the cache is destroyed : the cache must
+ *	  then be destroyed with "mutex" unlocked, and before "mutex".
+ *
+ * @param mutex		the mutex protecting all accesses to the cache
+ * @return 0 if ok, or error code
  *****************************************************************************/
+int
+Cache_StartJanitor (Cache* cache, ithread_mutex_t* mutex);
+
+
+/*****************************************************************************
+ * @brief Set a function called by the janitor after each purge of the 
+ *	  cache, with its mutex unlocked (e.g. to save the cache contents).
+ *	  The cache is not destroyed while "hook" is running (its 
+ *	  destruction waits for "hook" to return), but "hook" shall not 
+ *	  start or stop a janitor itself. The other caches may be created
+ *	  or destroyed meanwhile.
+ *	  To be set before Cache_StartJanitor.
+ *****************************************************************************/
+
+typedef void (*Cache_JanitorHook) (void* hook_data);
+
 void
-_Cache_PurgeExpiredEntries (Cache* cache);
-#endif
+Cache_SetJanitorHook (Cache* cache, Cache_JanitorHook hook, void* hook_data);
 
 
 /*****************************************************************************
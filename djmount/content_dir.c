@@ -28,12 +28,21 @@
 #include "content_dir_p.h"
 #include "device_list.h"
 #include "xml_util.h"
+#include "string_util.h"
+#include <stdio.h>
 #include <string.h>
 #include <inttypes.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
 #include <upnp/upnp.h>
+#include <upnp/ThreadPool.h>
 #include "service_p.h"
 #include "cache.h"
+#include "sax_parser.h"
 #include "log.h"
+#include "minmax.h"
 
 
 
@@ -42,16 +51,32 @@
  *****************************************************************************/
 
 // Cache timeout, in seconds
-#define CACHE_TIMEOUT	60
+#define CACHE_TIMEOUT	CONTENT_DIR_CACHE_TIMEOUT
+
+// Cache timeout, in seconds, while the server sends events when its 
+// content changes (the cached entries are then removed as necessary).
+#define CACHE_TIMEOUT_EVENTED	(4 * 3600)
 
 // Number of cached entries. Set to zero to deactivate caching.
 #define CACHE_SIZE	1024
 
+// Limits of the cache : the least recently used lists are removed 
+// in excess of these.
+#define CACHE_MAX_ENTRIES	(4 * CACHE_SIZE)
+#define CACHE_MAX_MEMORY	(32 * 1024 * 1024) // bytes
+
 // Maximum permissible content-length for SOAP messages, in bytes
 // (taking into account that "Browse" answers can be very large 
 // if contain lot of objects).
 #define MAX_CONTENT_LENGTH	(1024 * 1024) 
 
+// Number of objects requested per "Browse" or "Search" action. 
+// Larger lists are received in several pages.
+#define BROWSE_PAGE_SIZE	500
+
+// Maximum number of threads receiving the next pages in the background
+#define BROWSE_THREADS		4
+
 
 
 /******************************************************************************
@@ -88,9 +113,8 @@ static int
 DestroyChildren (ContentDir_Children* const children)
 {
 	if (children) {
-#if CONTENT_DIR_HAVE_CHILDREN_MUTEX
+		ithread_cond_destroy (&children->cond);
 		ithread_mutex_destroy (&children->mutex);
-#endif	
 		// Other "talloc'ed" fields will be deleted automatically :
 		// nothing to do
 	}
@@ -98,6 +122,40 @@ DestroyChildren (ContentDir_Children* const children)
 }
 
 
+/******************************************************************************
+ * CreateChildren
+ *
+ * Description:
+ *	Create an empty, complete list.
+ *
+ *****************************************************************************/
+static ContentDir_Children*
+CreateChildren (void* result_context)
+{
+	ContentDir_Children* result = talloc (result_context, 
+					      ContentDir_Children);
+	if (result == NULL)
+		return NULL; // ---------->
+
+	PtrArray* objects = PtrArray_Create (result);
+	if (objects == NULL) {
+		talloc_free (result);
+		return NULL; // ---------->
+	}
+
+	*result = (ContentDir_Children) {
+		.objects   = objects,
+		.complete  = true,
+		.rc	   = UPNP_E_SUCCESS,
+		.update_id = -1,
+	};
+	ithread_mutex_init (&result->mutex, NULL);
+	ithread_cond_init (&result->cond, NULL);
+        talloc_set_destructor (result, DestroyChildren);
+	return result;
+}
+
+
 /******************************************************************************
  * int_to_string
  *
@@ -118,11 +176,16 @@ int_to_string (void* result_context, intmax_t val)
 
 
 /******************************************************************************
- * BrowseAction
+ * BrowseOrSearchAction
+ *
+ * Description:
+ *	Send one "Browse" or "Search" action, and append the objects 
+ *	received to the "objects" list (they are allocated in this list 
+ *	context).
+ *
  *****************************************************************************/
 static int
 BrowseOrSearchAction (ContentDir* cds,
-		      void* result_context,
 		      const char* objectId, 
 		      const char* criteria,
 		      Index starting_index,
@@ -168,7 +231,7 @@ BrowseOrSearchAction (ContentDir* cds,
 		(XML_D2N (doc), "NumberReturned", true, true);
 	STRING_TO_INT (s, *nb_returned, 0);
 	
-	Log_Printf (LOG_DEBUG, "+++BROWSE RESULT+++\n%s\n", 
+	LOG_PRINTF (LOG_DEBUG, "+++BROWSE RESULT+++\n%s\n", 
 		    XMLUtil_GetDocumentString (tmp_ctx, doc));
 	
 	const char* const resstr = XMLUtil_FindFirstElementValue
@@ -182,28 +245,22 @@ BrowseOrSearchAction (ContentDir* cds,
 		goto cleanup; // ---------->
 	}
 
-	IXML_Document* const subdoc = 
-		ixmlParseBuffer (discard_const_p (char, resstr));
-	if (subdoc == NULL) {
+	// Parse the "Result" without building a DOM : the containers are
+	// listed first, then the items.
+	PtrArray* const containers = PtrArray_Create (tmp_ctx);
+	PtrArray* const items = PtrArray_Create (tmp_ctx);
+	int const nb = DIDLObject_CreateList (resstr, containers, items);
+	if (nb < 0) {
 		Log_Printf (LOG_ERROR, "BrowseOrSearchAction ObjectId=%s : "
 			    "can't parse 'Result'=%s", objectId, resstr);
 		rc = UPNP_E_BAD_RESPONSE;
 	} else {
-		IXML_NodeList* containers = ixmlDocument_getElementsByTagName
-			(subdoc, "container"); 
-		ContentDir_Count const nb_containers = 
-			ixmlNodeList_length (containers);
-		IXML_NodeList* items =
-			ixmlDocument_getElementsByTagName (subdoc, "item"); 
-		ContentDir_Count const nb_items = ixmlNodeList_length (items);
-		if (nb_containers + nb_items != *nb_returned) {
+		if ((Count) nb != *nb_returned) {
 			Log_Printf (LOG_ERROR, 
 				    "BrowseOrSearchAction ObjectId=%s "
-				    "got %d containers + %d items, "
-				    "expected %d", objectId, 
-				    (int) nb_containers, (int) nb_items,
-				    (int) *nb_returned);
-			*nb_returned = nb_containers + nb_items;
+				    "got %d objects, expected %d", objectId,
+				    nb, (int) *nb_returned);
+			*nb_returned = nb;
 		}
 		if (criteria == CRITERIA_BROWSE_METADATA && *nb_returned != 1){
 			Log_Printf (LOG_ERROR, "ContentDir_Browse Metadata : "
@@ -211,25 +268,13 @@ BrowseOrSearchAction (ContentDir* cds,
 				    NN(objectId));
 		}
 
-		ContentDir_Count i; 
-		for (i = 0; i < *nb_returned; i++) {
-			bool const is_container = (i < nb_containers);
-			IXML_Element* const elem = (IXML_Element*) 
-				ixmlNodeList_item
-				(is_container ? containers : items, 
-				 is_container ? i : i - nb_containers);
-			DIDLObject* o = DIDLObject_Create (result_context, 
-							   elem, is_container);
-			if (o) {
-				PtrArray_Append (objects, o);
-			}
-		}
-		
-		if (containers)
-			ixmlNodeList_free (containers);
-		if (items)
-			ixmlNodeList_free (items);
-		ixmlDocument_free (subdoc);
+		void* o;
+		PTR_ARRAY_FOR_EACH_PTR (containers, o) {
+			PtrArray_Append (objects, talloc_steal (objects, o));
+		} PTR_ARRAY_FOR_EACH_PTR_END;
+		PTR_ARRAY_FOR_EACH_PTR (items, o) {
+			PtrArray_Append (objects, talloc_steal (objects, o));
+		} PTR_ARRAY_FOR_EACH_PTR_END;
 	}
 	
  cleanup:
@@ -248,89 +293,419 @@ BrowseOrSearchAction (ContentDir* cds,
 }
 
 
+/******************************************************************************
+ * PageFetch
+ *
+ * Description:
+ *	State of a list being received page by page, after the first page.
+ *	When the total number of objects is known, the pages are requested 
+ *	in parallel by up to BROWSE_THREADS jobs, and appended to the list 
+ *	in order. Else the pages are requested one by one until the last 
+ *	(incomplete) one.
+ *	All fields, except constant ones, are protected by "children->mutex".
+ *
+ *****************************************************************************/
+typedef struct _PageFetch {
+	ContentDir* 	cds;
+	char*		objectId;
+	const char*	criteria;
+	Children*	children;
+	bool		background; // holds a reference on "children"
+	
+	Index		first;	    // index of the first object of page 0
+	Count		page_size;
+	Count		total;	    // 0 if unknown
+	Count		nb_pages;   // 0 if unknown (until last page received)
+	Index		next_request; 
+	Index		next_append;
+	PtrArray**	pages;	    // received, not yet appended (if total)
+	int		nb_jobs;
+} PageFetch;
+
+
+/******************************************************************************
+ * AppendPage
+ *
+ * Description:
+ *	Append a page of objects to the list. 
+ *	Must be called with "children->mutex" locked.
+ *
+ *****************************************************************************/
+static void
+AppendPage (Children* children, PtrArray* page)
+{
+	void* o;
+	PTR_ARRAY_FOR_EACH_PTR (page, o) {
+		PtrArray_Append (children->objects, o);
+	} PTR_ARRAY_FOR_EACH_PTR_END;
+	// The objects are allocated in the page context
+	children->size += talloc_total_size (page);
+	talloc_steal (children->objects, page);
+	ithread_cond_broadcast (&children->cond);
+}
+
+
+/******************************************************************************
+ * RequestPage
+ *
+ * Description:
+ *	Request one page of objects. If the server returns less objects
+ *	than requested (e.g. because it limits the size of its answers),
+ *	request the remaining ones, so that the pages stay contiguous.
+ *
+ *****************************************************************************/
+static int
+RequestPage (const PageFetch* f, Index page, PtrArray* objects)
+{
+	Index const start = f->first + page * f->page_size;
+	Count requested   = f->page_size;
+	if (f->total > 0) 
+		requested = MIN (requested, f->total - start);
+
+	int rc = UPNP_E_SUCCESS;
+	Count got = 0;
+	while (got < requested) {
+		Count nb_matched  = 0;
+		Count nb_returned = 0;
+		rc = BrowseOrSearchAction (f->cds, f->objectId, f->criteria,
+					   start + got, requested - got,
+					   &nb_matched, &nb_returned, 
+					   objects);
+		// Stop if error, or no more results (to prevent infinite 
+		// loop), or total unknown (the page is the last one)
+		if (rc != UPNP_E_SUCCESS || nb_returned == 0 || f->total == 0)
+			break; // ---------->
+		got += nb_returned;
+	}
+	if (rc == UPNP_E_SUCCESS && f->total > 0 && 
+	    PtrArray_GetSize (objects) < requested) {
+		Log_Printf (LOG_WARNING, 
+			    "ContentDir_BrowseId ObjectId=%s : "
+			    "got %d results at index %d, expected %d",
+			    f->objectId, (int) PtrArray_GetSize (objects), 
+			    (int) start, (int) requested);
+	}
+	return rc;
+}
+
+
+/******************************************************************************
+ * LeaveFetch
+ *
+ * Description:
+ *	Decrement the number of jobs of a PageFetch, and destroy it
+ *	after the last one.
+ *
+ *****************************************************************************/
+static void
+LeaveFetch (PageFetch* f)
+{
+	Children* const children = f->children;
+
+	ithread_mutex_lock (&children->mutex);
+	bool const last = (--f->nb_jobs == 0);
+	if (last && ! children->complete) {
+		// Stopped before the end : wake up any reader
+		children->rc	   = UPNP_E_FINISH;
+		children->complete = true;
+		ithread_cond_broadcast (&children->cond);
+	}
+	ithread_mutex_unlock (&children->mutex);
+	if (! last)
+		return; // ---------->
+
+	Index i;
+	for (i = 0; f->pages && i < f->nb_pages; i++)
+		talloc_free (f->pages [i]);
+	if (f->background) {
+		ContentDir* const cds = f->cds;
+		ithread_mutex_lock (&cds->cache_mutex);
+		talloc_free (children);
+		cds->nb_fetches--;
+		ithread_cond_broadcast (&cds->cache_cond);
+		ithread_mutex_unlock (&cds->cache_mutex);
+	}
+	talloc_free (f);
+}
+
+
+/******************************************************************************
+ * FetchPages
+ *
+ * Description:
+ *	Job requesting pages until all are requested. 
+ *
+ *****************************************************************************/
+static bool
+IsStopping (ContentDir* cds)
+{
+	ithread_mutex_lock (&cds->cache_mutex);
+	bool const stopping = cds->stopping;
+	ithread_mutex_unlock (&cds->cache_mutex);
+	return stopping;
+}
+
+static void*
+FetchPages (void* arg)
+{
+	PageFetch* const f = (PageFetch*) arg;
+	Children* const children = f->children;
+
+	while (! (f->background && IsStopping (f->cds))) {
+		ithread_mutex_lock (&children->mutex);
+		if (children->complete || 
+		    (f->nb_pages > 0 && f->next_request >= f->nb_pages)) {
+			ithread_mutex_unlock (&children->mutex);
+			break; // ---------->
+		}
+		Index const page = f->next_request++;
+		ithread_mutex_unlock (&children->mutex);
+
+		PtrArray* const objects = PtrArray_Create (NULL);
+		int const rc = (objects ? RequestPage (f, page, objects) 
+				: UPNP_E_OUTOF_MEMORY);
+
+		ithread_mutex_lock (&children->mutex);
+		if (children->complete) {
+			// Error in another page
+			talloc_free (objects);
+		} else if (rc != UPNP_E_SUCCESS) {
+			talloc_free (objects);
+			children->rc	   = rc;
+			children->complete = true;
+			ithread_cond_broadcast (&children->cond);
+		} else {
+			if (f->total == 0 &&
+			    PtrArray_GetSize (objects) < f->page_size)
+				f->nb_pages = page + 1; // last page
+			if (page != f->next_append) {
+				f->pages [page] = objects;
+			} else {
+				AppendPage (children, objects);
+				f->next_append++;
+				while (f->next_append < f->nb_pages &&
+				       f->pages && f->pages [f->next_append]) {
+					AppendPage (children, f->pages 
+						    [f->next_append]);
+					f->pages [f->next_append++] = NULL;
+				}
+			}
+			if (f->next_append == f->nb_pages) {
+				children->complete = true;
+				ithread_cond_broadcast (&children->cond);
+			}
+		}
+		ithread_mutex_unlock (&children->mutex);
+	}
+
+	LeaveFetch (f);
+	return NULL;
+}
+
+
+/******************************************************************************
+ * StartFetchPages
+ *
+ * Description:
+ *	Schedule jobs to receive the next pages of a list in the background.
+ *	If no job can be started, receive all pages before returning.
+ *
+ *****************************************************************************/
+static ThreadPool	g_browse_pool;
+static bool		g_browse_pool_ok = false;
+static pthread_once_t	g_browse_pool_once = PTHREAD_ONCE_INIT;
+
+static void
+InitBrowsePool (void)
+{
+	ThreadPoolAttr attr;
+	TPAttrInit (&attr);
+	TPAttrSetMinThreads (&attr, 0);
+	TPAttrSetMaxThreads (&attr, BROWSE_THREADS);
+	// Jobs wait for the network : start a thread for each job, 
+	// up to the maximum.
+	TPAttrSetJobsPerThread (&attr, 0);
+	int const rc = ThreadPoolInit (&g_browse_pool, &attr);
+	if (rc != 0) 
+		Log_Printf (LOG_ERROR, "ContentDir : can't create browse "
+			    "thread pool, error %d", rc);
+	g_browse_pool_ok = (rc == 0);
+}
+
+static void
+StartFetchPages (PageFetch* f, bool background)
+{
+	ContentDir* const cds = f->cds;
+	
+	int nb_jobs = 0;
+	if (background) {
+		pthread_once (&g_browse_pool_once, InitBrowsePool);
+		if (g_browse_pool_ok)
+			nb_jobs = (f->nb_pages > 0 ? 
+				   MIN (f->nb_pages, BROWSE_THREADS) : 1);
+	}
+	if (nb_jobs > 0) {
+		f->background = true;
+		ithread_mutex_lock (&cds->cache_mutex);
+		talloc_increase_ref_count (f->children);
+		cds->nb_fetches++;
+		ithread_mutex_unlock (&cds->cache_mutex);
+	}
+
+	// Note: count this thread as a job while the jobs are added, 
+	// so that the PageFetch can't be destroyed by a finished job.
+	ithread_mutex_lock (&f->children->mutex);
+	f->nb_jobs = 1 + nb_jobs;
+	ithread_mutex_unlock (&f->children->mutex);
+	int started = 0;
+	while (started < nb_jobs) {
+		ThreadPoolJob job;
+		TPJobInit (&job, FetchPages, f);
+		TPJobSetPriority (&job, MED_PRIORITY);
+		if (ThreadPoolAdd (&g_browse_pool, &job, NULL) != 0)
+			break; // ---------->
+		started++;
+	}
+	ithread_mutex_lock (&f->children->mutex);
+	f->nb_jobs -= (nb_jobs - started);
+	ithread_mutex_unlock (&f->children->mutex);
+
+	if (started > 0) 
+		LeaveFetch (f);
+	else 
+		FetchPages (f); // receive all pages here
+}
+
+
 /******************************************************************************
  * BrowseOrSearchAll
+ *
+ * Description:
+ *	Request all objects, page by page. If "background" is true, returns
+ *	as soon as the first page is received, and the next pages are 
+ *	appended in the background.
+ *
  *****************************************************************************/
 static ContentDir_Children*
 BrowseOrSearchAll (ContentDir* cds,
 		   void* result_context, 
 		   const char* objectId, 
-		   const char* const criteria)
+		   const char* const criteria,
+		   bool background)
 {
-	ContentDir_Children* result = talloc (result_context, 
-					      ContentDir_Children);
+	ContentDir_Children* result = CreateChildren (result_context);
 	if (result == NULL)
 		return NULL; // ---------->
+	PtrArray* const objects = result->objects;
 
-	PtrArray* objects = PtrArray_Create (result);
-	if (objects == NULL) 
-		goto FAIL; // ---------->
-
-	*result = (ContentDir_Children) {
-		.objects = objects
-	};
-		
-#if CONTENT_DIR_HAVE_CHILDREN_MUTEX
-	ithread_mutexattr_t attr;
-	ithread_mutexattr_init (&attr);
-	ithread_mutexattr_setkind_np (&attr, ITHREAD_MUTEX_RECURSIVE_NP);
-	ithread_mutex_init (&result->mutex, &attr);
-	ithread_mutexattr_destroy (&attr);
-#endif
-
-        talloc_set_destructor (result, DestroyChildren);
-
-	// Request all objects
+	// Request the first page : fails if no answer at all.
+	// Note: "BrowseMetadata" returns exactly one object.
+	Count const requested = (criteria == CRITERIA_BROWSE_METADATA ? 0 :
+				 BROWSE_PAGE_SIZE);
 	Count nb_matched  = 0;
 	Count nb_returned = 0;
-	
-	int rc = BrowseOrSearchAction (cds,
-				       objects,
-				       objectId, 
-				       criteria,
-				       /* starting_index  => */ 0,
-				       /* requested_count => */ 0,
-				       &nb_matched,
-				       &nb_returned,
-				       objects);
-	if (rc != UPNP_E_SUCCESS) 
-		goto FAIL; // ---------->
-	
-	// Loop if missing entries
-	// (this is not normal : "RequestedCount" == 0 means to request 
-	// all entries according to ContentDirectory specification).
+	int rc = BrowseOrSearchAction (cds, objectId, criteria, 0, requested,
+				       &nb_matched, &nb_returned, objects);
+	if (rc != UPNP_E_SUCCESS) {
+		talloc_free (result);
+		return NULL; // ---------->
+	}
+	result->size = talloc_total_size (result);
+
+	// More pages to request ?
 	// Note: it is allowed to have nb_matched == 0 if it cannot be
-	// computed by the CDS.
-	int nb_retry = 0;
-	while (PtrArray_GetSize (objects) < nb_matched && nb_retry++ < 2) {
-		Log_Printf (LOG_WARNING, 
-			    "ContentDir_BrowseId ObjectId=%s : "
-			    "got %d results, expected %d. Retry %d ...",
-			    objectId, (int) PtrArray_GetSize (objects), 
-			    (int) nb_matched, nb_retry);
-    
-		// Workaround : request missing entries.
-		rc = BrowseOrSearchAction 
-			(cds,
-			 objects,
-			 objectId, 
-			 criteria,
-			 /* starting_index  => */ PtrArray_GetSize (objects),
-			 /* requested_count => */ 
-			 nb_matched - PtrArray_GetSize (objects),
-			 &nb_matched,
-			 &nb_returned,
-			 objects);
-		// Stop if error, or no more results (to prevent infinite loop)
-		if (rc != UPNP_E_SUCCESS || nb_returned == 0)
-			break; // ---------->
+	// computed by the CDS : then request pages until an incomplete one.
+	Count const size = PtrArray_GetSize (objects);
+	if (requested == 0 || nb_returned == 0 ||
+	    (nb_matched > 0 ? size >= nb_matched : nb_returned < requested))
+		return result; // ---------->
+
+	PageFetch* const f = talloc (NULL, PageFetch);
+	if (f == NULL)
+		return result; // ---------->
+	// Note: use the number of objects returned as page size, in case 
+	// the server limits the size of its answers.
+	*f = (PageFetch) {
+		.cds	   = cds,
+		.objectId  = talloc_strdup (f, objectId),
+		// keep the special criteria pointer values
+		.criteria  = (is_browse (criteria) ? criteria 
+			      : talloc_strdup (f, criteria)),
+		.children  = result,
+		.first	   = size,
+		.page_size = nb_returned,
+		.total	   = nb_matched,
+	};
+	if (nb_matched > 0) {
+		f->nb_pages = (nb_matched - size + nb_returned - 1) / 
+			nb_returned;
+		f->pages = talloc_zero_array (f, PtrArray*, f->nb_pages);
+		if (f->pages == NULL) {
+			talloc_free (f);
+			return result; // ---------->
+		}
 	}
-	
+	result->complete = false;
+
+	StartFetchPages (f, background);
 	return result;
+}
+
 
-FAIL:
-	talloc_free (result);
-	return NULL; 
+/******************************************************************************
+ * ContentDir_Children_GetObject
+ *****************************************************************************/
+DIDLObject*
+ContentDir_Children_GetObject (ContentDir_Children* children, Index index)
+{
+	if (children == NULL)
+		return NULL; // ---------->
+
+	ithread_mutex_lock (&children->mutex);
+	while (index >= PtrArray_GetSize (children->objects) &&
+	       ! children->complete)
+		ithread_cond_wait (&children->cond, &children->mutex);
+	DIDLObject* const o = 
+		(index < PtrArray_GetSize (children->objects) ?
+		 PtrArray_GetElementAt (children->objects, index) : NULL);
+	ithread_mutex_unlock (&children->mutex);
+	return o;
+}
+
+
+/******************************************************************************
+ * ContentDir_Children_GetIndex
+ *****************************************************************************/
+const void*
+ContentDir_Children_GetIndex (ContentDir_Children* children,
+			      ContentDir_IndexBuilder build, 
+			      const void* owner)
+{
+	if (children == NULL || build == NULL)
+		return NULL; // ---------->
+
+	// Note: the index is built with the list locked, so that it is 
+	// built only once, and allocated safely in the list context.
+	const void* index = NULL;
+	ithread_mutex_lock (&children->mutex);
+	if (children->complete && children->rc == UPNP_E_SUCCESS) {
+		if (children->index == NULL && children->index_owner == NULL){
+			children->index_owner = owner;
+			children->index = build (children, children->objects,
+						 owner);
+			if (children->index)
+				children->size += talloc_total_size 
+					(children->index);
+			else
+				// Failed (e.g. out of memory) : retry on
+				// the next call
+				children->index_owner = NULL;
+		}
+		if (children->index_owner == owner)
+			index = children->index;
+	}
+	ithread_mutex_unlock (&children->mutex);
+	return index;
 }
 
 
@@ -345,12 +720,29 @@ cache_free_expired_data (const char* key, void* data)
 	// Un-reference old cached data (Children). Will be really freed
 	// by talloc only when its reference count drops to zero.
 	if (talloc_free (children) == 0) {
-		Log_Printf (LOG_DEBUG, "ContentDir CACHE_FREE (key='%s')", 
+		LOG_PRINTF (LOG_DEBUG, "ContentDir CACHE_FREE (key='%s')", 
 			    key);
 	}
 }
 
 
+/******************************************************************************
+ * cache_data_size
+ *****************************************************************************/
+static size_t
+cache_data_size (const void* data)
+{
+	Children* const children = (Children*) data;
+
+	// Note: the size is maintained when pages are appended, so that 
+	// the cache can account it often.
+	ithread_mutex_lock (&children->mutex);
+	size_t const size = children->size;
+	ithread_mutex_unlock (&children->mutex);
+	return size;
+}
+
+
 /******************************************************************************
  * DestroyResult
  *****************************************************************************/
@@ -364,7 +756,7 @@ DestroyResult (BrowseResult* const br)
 		// Cached data will be really freed by talloc 
 		// when its reference count drops to zero.
 		if (talloc_free (br->children) == 0)
-			Log_Printf (LOG_DEBUG, "ContentDir CACHE_FREE");
+			LOG_PRINTF (LOG_DEBUG, "ContentDir CACHE_FREE");
 		
 		if (br->cds && br->cds->cache)
 			ithread_mutex_unlock (&br->cds->cache_mutex);
@@ -376,8 +768,587 @@ DestroyResult (BrowseResult* const br)
 }
 
 
+/******************************************************************************
+ * Snapshot
+ *
+ * Description:
+ *	The complete "BrowseDirectChildren" lists are saved by the cache 
+ *	janitor, and when the service is destroyed, one file per list in 
+ *	"snapshot_dir" :
+ *
+ *	<snapshot id="objectId" SystemUpdateID="N">
+ *	  DIDL-Lite <container> and <item> elements, in list order
+ *	</snapshot>
+ *
+ *	where N is the SystemUpdateID known before the list was requested
+ *	(it can only be older than the list). A file is reloaded only while
+ *	the server SystemUpdateID is still N, i.e. the list cannot have 
+ *	changed since it was received.
+ *
+ *****************************************************************************/
+
+static char* g_snapshot_dir = NULL;
+
+static char*
+SnapshotPath (const ContentDir* cds, void* result_context, 
+	      const char* objectId)
+{
+	return talloc_asprintf (result_context, "%s/%08" PRIx32, 
+				cds->snapshot_dir, String_Hash (objectId));
+}
+
+
+/******************************************************************************
+ * CurrentUpdateId
+ *
+ * Description:
+ *	Last known SystemUpdateID of the server, -1 if unknown : the evented
+ *	value, or else the last answer to "GetSystemUpdateID".
+ *	Called with "cache_mutex" held.
+ *
+ *****************************************************************************/
+static intmax_t
+CurrentUpdateId (const ContentDir* cds)
+{
+	if (cds->snapshot_dir == NULL)
+		return -1; // ---------->
+
+	intmax_t id = cds->snapshot_update_id;
+	if (cds->evented && cds->system_update_id)
+		STRING_TO_INT (cds->system_update_id, id, -1);
+	return id;
+}
+
+
+/******************************************************************************
+ * RequestUpdateId
+ *
+ * Description:
+ *	Current SystemUpdateID of the server, -1 if unknown. If not evented,
+ *	"GetSystemUpdateID" is requested again when the last answer is 
+ *	older than CACHE_TIMEOUT.
+ *	Called with "cache_mutex" not held.
+ *
+ *****************************************************************************/
+static intmax_t
+RequestUpdateId (ContentDir* cds)
+{
+	ithread_mutex_lock (&cds->cache_mutex);
+	time_t const now = time (NULL);
+	bool const request = 
+		! (cds->evented && cds->system_update_id) &&
+		(cds->snapshot_update_time == 0 ||
+		 now >= cds->snapshot_update_time + CACHE_TIMEOUT);
+	if (request) {
+		// Other threads use the previous answer in the meantime
+		cds->snapshot_update_time = now;
+	}
+	intmax_t id = CurrentUpdateId (cds);
+	ithread_mutex_unlock (&cds->cache_mutex);
+
+	if (request) {
+		IXML_Document* doc = NULL;
+		int const rc = Service_SendActionVa
+			(OBJECT_SUPER_CAST(cds), &doc, "GetSystemUpdateID",
+			 NULL, NULL);
+		id = -1;
+		if (rc == UPNP_E_SUCCESS && doc) {
+			const char* const s = XMLUtil_FindFirstElementValue
+				(XML_D2N (doc), "Id", true, true);
+			STRING_TO_INT (s, id, -1);
+		}
+		ixmlDocument_free (doc);
+
+		ithread_mutex_lock (&cds->cache_mutex);
+		cds->snapshot_update_id = id;
+		ithread_mutex_unlock (&cds->cache_mutex);
+	}
+	return id;
+}
+
+
+/******************************************************************************
+ * ReadSnapshot
+ *
+ * Description:
+ *	Return the content of the file saved for "objectId", or NULL if none.
+ *
+ *****************************************************************************/
+static char*
+ReadSnapshot (const ContentDir* cds, void* result_context, 
+	      const char* objectId)
+{
+	char* const path = SnapshotPath (cds, NULL, objectId);
+	FILE* const file = (path ? fopen (path, "r") : NULL);
+	talloc_free (path);
+	if (file == NULL)
+		return NULL; // ---------->
+
+	char* res = NULL;
+	struct stat st;
+	if (fstat (fileno (file), &st) == 0 && st.st_size > 0) {
+		res = talloc_size (result_context, st.st_size + 1);
+		if (res && fread (res, st.st_size, 1, file) == 1) {
+			res [st.st_size] = '\0';
+		} else {
+			talloc_free (res);
+			res = NULL;
+		}
+	}
+	fclose (file);
+	return res;
+}
+
+
+/******************************************************************************
+ * snapshot_start
+ *	Get the attributes of the root <snapshot> element, and stop
+ *****************************************************************************/
+typedef struct _SnapshotHeader {
+	char*		id;
+	intmax_t	update_id;
+} SnapshotHeader;
+
+static int
+snapshot_start (void* user, int depth, const char* name, const char** atts,
+		const char* tag)
+{
+	SnapshotHeader* const header = (SnapshotHeader*) user;
+	if (strcmp (name, "snapshot") == 0) {
+		header->id = talloc_strdup 
+			(NULL, SaxParser_GetAttribute (atts, "id"));
+		STRING_TO_INT (SaxParser_GetAttribute (atts, "SystemUpdateID"),
+			       header->update_id, -1);
+	}
+	return 1;
+}
+
+
+/******************************************************************************
+ * LoadSnapshot
+ *
+ * Description:
+ *	Return the list saved for "objectId", or NULL if none or if the 
+ *	server content may have changed since. "update_id" is set to the 
+ *	current SystemUpdateID, to label the list requested otherwise.
+ *	Called with "cache_mutex" not held.
+ *
+ *****************************************************************************/
+static Children*
+LoadSnapshot (ContentDir* cds, const char* objectId, intmax_t* update_id)
+{
+	*update_id = RequestUpdateId (cds);
+	if (*update_id < 0)
+		return NULL; // ---------->
+
+	void* const tmp_ctx = talloc_new (NULL);
+	Children* result = NULL;
+	char* const xml = ReadSnapshot (cds, tmp_ctx, objectId);
+
+	// Check the <snapshot> attributes, then create the objects
+	SnapshotHeader header = { .update_id = -1 };
+	static const SaxParser_Handler handler = { 
+		.start = snapshot_start 
+	};
+	if (xml)
+		SaxParser_Parse (xml, &handler, &header);
+	if (header.id == NULL || strcmp (header.id, objectId) != 0) {
+		// No snapshot (or another objectId with the same hash)
+	} else if (header.update_id != *update_id) {
+		LOG_PRINTF (LOG_DEBUG, "ContentDir snapshot obsolete "
+			    "(id='%s')", objectId);
+	} else if ((result = CreateChildren (NULL)) != NULL) {
+		if (DIDLObject_CreateList (xml, result->objects, 
+					   result->objects) < 0) {
+			Log_Printf (LOG_ERROR, "ContentDir bad snapshot "
+				    "(id='%s')", objectId);
+			talloc_free (result);
+			result = NULL;
+		} else {
+			result->size	  = talloc_total_size (result);
+			result->update_id = *update_id;
+			result->saved	  = true; // already in the snapshot
+			LOG_PRINTF (LOG_DEBUG, "ContentDir snapshot loaded "
+				    "(id='%s', %d objects)", objectId,
+				    (int) PtrArray_GetSize (result->objects));
+		}
+	}
+
+	talloc_free (header.id);
+	talloc_free (tmp_ctx);
+	return result;
+}
+
+
+/******************************************************************************
+ * SaveSnapshot
+ *
+ * Description:
+ *	Save the complete "BrowseDirectChildren" lists of the cache which
+ *	are not saved yet. The lists are collected with "cache_mutex" held,
+ *	but written with the cache unlocked.
+ *	Called with "cache_mutex" not held.
+ *
+ *****************************************************************************/
+static void
+fputs_attribute (const char* s, FILE* file)
+{
+	for (; *s; s++) {
+		switch (*s) {
+		case '&': fputs ("&amp;", file);  break;
+		case '<': fputs ("&lt;", file);   break;
+		case '"': fputs ("&quot;", file); break;
+		default:  putc (*s, file);	  break;
+		}
+	}
+}
+
+typedef struct _SnapshotEntry {
+	char*		key;
+	Children*	children; // referenced until written
+} SnapshotEntry;
+
+static void
+CollectChildren (const char* key, void* data, void* visit_data)
+{
+	PtrArray* const entries = (PtrArray*) visit_data;
+	Children* const children = (Children*) data;
+
+	// Children keys are the objectId alone, see BrowseOrSearchWithCache
+	if (children == NULL || children->saved || children->update_id < 0 ||
+	    strchr (key, '\t') != NULL)
+		return; // ---------->
+	ithread_mutex_lock (&children->mutex);
+	bool const ok = (children->complete && 
+			 children->rc == UPNP_E_SUCCESS);
+	ithread_mutex_unlock (&children->mutex);
+	if (! ok)
+		return; // ---------->
+
+	SnapshotEntry* const e = talloc (entries, SnapshotEntry);
+	if (e == NULL)
+		return; // ---------->
+	*e = (SnapshotEntry) { 
+		.key	  = talloc_strdup (e, key), 
+		.children = children 
+	};
+	if (e->key == NULL || ! PtrArray_Append (entries, e)) {
+		talloc_free (e);
+		return; // ---------->
+	}
+	talloc_increase_ref_count (children);
+	children->saved = true;
+}
+
+static void
+WriteChildren (const ContentDir* cds, const SnapshotEntry* e)
+{
+	// Write a new file, then replace the previous one
+	void* const tmp_ctx = talloc_new (NULL);
+	char* const path = SnapshotPath (cds, tmp_ctx, e->key);
+	char* const new_path = talloc_asprintf (tmp_ctx, "%s.new", path);
+	FILE* const file = fopen (new_path, "w");
+	if (file == NULL) {
+		Log_Printf (LOG_ERROR, "ContentDir can't write snapshot "
+			    "'%s' : %s", new_path, strerror (errno));
+		goto cleanup; // ---------->
+	}
+	fputs ("<?xml version=\"1.0\"?>\n<snapshot id=\"", file);
+	fputs_attribute (e->key, file);
+	fprintf (file, "\" SystemUpdateID=\"%" PRIdMAX "\">\n", 
+		 e->children->update_id);
+	// Note: a complete list is not modified anymore
+	const DIDLObject* o;
+	PTR_ARRAY_FOR_EACH_PTR (e->children->objects, o) {
+		char* const s = DIDLObject_GetElementString (o, NULL);
+		fputs (s, file);
+		talloc_free (s);
+	} PTR_ARRAY_FOR_EACH_PTR_END;
+	fputs ("</snapshot>\n", file);
+
+	bool const written = ! ferror (file);
+	if (fclose (file) != 0 || ! written || rename (new_path, path) != 0) {
+		Log_Printf (LOG_ERROR, "ContentDir can't write snapshot "
+			    "'%s' : %s", path, strerror (errno));
+		unlink (new_path);
+	}
+
+ cleanup:
+	talloc_free (tmp_ctx);
+}
+
+static void
+SaveSnapshot (ContentDir* cds)
+{
+	PtrArray* const entries = PtrArray_Create (NULL);
+	if (entries == NULL)
+		return; // ---------->
+	ithread_mutex_lock (&cds->cache_mutex);
+	Cache_ForEach (cds->cache, CollectChildren, entries);
+	ithread_mutex_unlock (&cds->cache_mutex);
+
+	if (PtrArray_IsEmpty (entries)) {
+		// Nothing new
+	} else if ((mkdir (g_snapshot_dir, 0755) != 0 && errno != EEXIST) ||
+		   (mkdir (cds->snapshot_dir, 0755) != 0 && errno != EEXIST)) {
+		Log_Printf (LOG_ERROR, "ContentDir can't create snapshot "
+			    "directory '%s' : %s", cds->snapshot_dir, 
+			    strerror (errno));
+	} else {
+		const SnapshotEntry* e;
+		PTR_ARRAY_FOR_EACH_PTR (entries, e) {
+			WriteChildren (cds, e);
+		} PTR_ARRAY_FOR_EACH_PTR_END;
+		LOG_PRINTF (LOG_DEBUG, "ContentDir snapshot : %d lists "
+			    "saved in '%s'", (int) PtrArray_GetSize (entries),
+			    cds->snapshot_dir);
+	}
+
+	// Un-reference the lists, with the cache locked (see DestroyResult)
+	ithread_mutex_lock (&cds->cache_mutex);
+	const SnapshotEntry* e;
+	PTR_ARRAY_FOR_EACH_PTR (entries, e) {
+		talloc_free (e->children);
+	} PTR_ARRAY_FOR_EACH_PTR_END;
+	ithread_mutex_unlock (&cds->cache_mutex);
+	talloc_free (entries);
+}
+
+static void
+snapshot_janitor_hook (void* hook_data)
+{
+	SaveSnapshot ((ContentDir*) hook_data);
+}
+
+
+/******************************************************************************
+ * CacheFill
+ *
+ * Description:
+ *	A cache fill in progress : only one thread sends the request to the
+ *	server for a given key, other threads asking for the same key wait
+ *	on "cache_cond" for the result instead of sending the same request.
+ *
+ *****************************************************************************/
+struct _CacheFill {
+	struct _CacheFill* next;
+	char*		   key;
+	Children*	   children;	// result, NULL until done (or if error)
+	bool		   done;
+	bool		   stale;	// invalidated : do not cache the result
+	int		   nb_waiters;	// one reference on "children" each
+	intmax_t	   update_id;	// see ContentDir_Children
+
+	// Request, for a refresh in the background (see Revalidate)
+	ContentDir*	   cds;
+	char*		   objectId;
+	const char*	   criteria;
+};
+
+
+/******************************************************************************
+ * WaitCacheFill
+ *
+ * Description:
+ *	Wait for a fill in progress to complete, and return its result,
+ *	already referenced for the caller. Called with "cache_mutex" held.
+ *
+ *****************************************************************************/
+static Children*
+WaitCacheFill (ContentDir* cds, CacheFill* fill)
+{
+	fill->nb_waiters++;
+	while (! fill->done)
+		ithread_cond_wait (&cds->cache_cond, &cds->cache_mutex);
+	Children* const children = fill->children;
+	if (--fill->nb_waiters == 0)
+		talloc_free (fill);
+	return children;
+}
+
+
+/******************************************************************************
+ * EndCacheFill
+ *
+ * Description:
+ *	Set the result of a fill into the cache (unless it has been 
+ *	invalidated in the meantime), and wake up the waiting threads.
+ *	The reference from creation of the result is left to the caller.
+ *	Called with "cache_mutex" held.
+ *
+ *****************************************************************************/
+static void
+EndCacheFill (ContentDir* cds, CacheFill* fill, Children* children)
+{
+	if (children)
+		children->update_id = fill->update_id;
+
+	// Set cache. The entry may have been reused for another key in the
+	// meantime, hence the new lookup. Stale data is replaced by a new
+	// entry : threads still reading the old list keep a reference on it.
+	if (children && ! fill->stale) {
+		bool stale = false;
+		Children** cp = (Children**) Cache_GetStale (cds->cache, 
+							     fill->key, &stale);
+		if (cp && stale) {
+			Cache_Remove (cds->cache, fill->key);
+			cp = (Children**) Cache_Get (cds->cache, fill->key);
+		}
+		if (cp && *cp == NULL) {
+			talloc_steal (cds->cache, children);
+			*cp = children;
+			talloc_increase_ref_count (children);
+		}
+	}
+
+	// Wake up waiting threads, with a reference each
+	CacheFill** pp = &cds->fills;
+	while (*pp != fill)
+		pp = &(*pp)->next;
+	*pp = fill->next;
+	int i;
+	for (i = 0; children && i < fill->nb_waiters; i++)
+		talloc_increase_ref_count (children);
+	fill->children = children;
+	fill->done     = true;
+	if (fill->nb_waiters > 0)
+		ithread_cond_broadcast (&cds->cache_cond);
+	else
+		talloc_free (fill);
+}
+
+
+/******************************************************************************
+ * Revalidate
+ *
+ * Description:
+ *	Job refreshing a stale cache entry in the background, while the
+ *	stale data is still returned.
+ *
+ *****************************************************************************/
+static void*
+Revalidate (void* arg)
+{
+	CacheFill* const fill = (CacheFill*) arg;
+	ContentDir* const cds = fill->cds;
+
+	LOG_PRINTF (LOG_DEBUG, "ContentDir refresh (key='%s')", fill->key);
+	Children* const children = 
+		(IsStopping (cds) ? NULL : BrowseOrSearchAll 
+		 (cds, NULL, fill->objectId, fill->criteria, true));
+
+	ithread_mutex_lock (&cds->cache_mutex);
+	EndCacheFill (cds, fill, children);
+	// No caller for this result
+	if (children)
+		talloc_free (children);
+	cds->nb_fetches--;
+	ithread_cond_broadcast (&cds->cache_cond);
+	ithread_mutex_unlock (&cds->cache_mutex);
+	return NULL;
+}
+
+static void
+StartRevalidate (ContentDir* cds, const char* key,
+		 const char* objectId, const char* const criteria)
+{
+	pthread_once (&g_browse_pool_once, InitBrowsePool);
+	if (! g_browse_pool_ok || cds->stopping)
+		return; // ---------->
+
+	CacheFill* const fill = talloc (NULL, CacheFill);
+	if (fill == NULL)
+		return; // ---------->
+	*fill = (CacheFill) { 
+		.next	  = cds->fills,
+		.key	  = talloc_strdup (fill, key),
+		.cds	  = cds,
+		.objectId = talloc_strdup (fill, objectId),
+		// keep the special criteria pointer values
+		.criteria = (is_browse (criteria) ? criteria 
+			     : talloc_strdup (fill, criteria)),
+		.update_id = CurrentUpdateId (cds),
+	};
+
+	// Note: the job can't start before the cache is unlocked
+	ThreadPoolJob job;
+	TPJobInit (&job, Revalidate, fill);
+	TPJobSetPriority (&job, LOW_PRIORITY);
+	if (ThreadPoolAdd (&g_browse_pool, &job, NULL) != 0) {
+		talloc_free (fill);
+		return; // ---------->
+	}
+	cds->fills = fill;
+	cds->nb_fetches++;
+}
+
+
+/******************************************************************************
+ * InvalidateKey
+ * InvalidateMatching
+ *
+ * Description:
+ *	Remove cached entries (all entries if "match" is NULL). The fills in
+ *	progress for these entries do not cache their result, which may have
+ *	been sent by the server before the change.
+ *	Called with "cache_mutex" held.
+ *
+ *****************************************************************************/
+static void
+InvalidateKey (ContentDir* cds, const char* key)
+{
+	CacheFill* fill;
+	for (fill = cds->fills; fill; fill = fill->next) {
+		if (strcmp (fill->key, key) == 0)
+			fill->stale = true;
+	}
+	Cache_Remove (cds->cache, key);
+}
+
+static void
+InvalidateMatching (ContentDir* cds, Cache_KeyMatch match, void* match_data)
+{
+	CacheFill* fill;
+	for (fill = cds->fills; fill; fill = fill->next) {
+		if (match == NULL || match (fill->key, match_data))
+			fill->stale = true;
+	}
+	long const n = Cache_RemoveMatching (cds->cache, match, match_data);
+	LOG_PRINTF (LOG_DEBUG, "ContentDir : %ld cache entries removed", n);
+}
+
+
+/******************************************************************************
+ * CheckSubscription
+ *
+ * Description:
+ *	Use the longer cache timeout only while subscribed to the events.
+ *	Called with "cache_mutex" held : "subscribed" shall be read before
+ *	(see Service_IsSubscribed), because the Service is locked before
+ *	the cache (see update_variable).
+ *
+ *****************************************************************************/
+static void
+CheckSubscription (ContentDir* cds, bool subscribed)
+{
+	if (cds->evented && ! subscribed) {
+		Log_Printf (LOG_WARNING, "ContentDir : events lost, flush "
+			    "cache");
+		cds->evented = false;
+		Cache_SetMaxAge (cds->cache, CACHE_TIMEOUT);
+		InvalidateMatching (cds, NULL, NULL);
+	}
+}
+
+
 /******************************************************************************
  * BrowseOrSearchWithCache
+ *
+ * Description:
+ *	Lookup the cache, and fill it if necessary. The cache mutex is not
+ *	held during the request to the server, so that cache hits, and 
+ *	requests for other keys, are not delayed by a slow answer.
+ *
  *****************************************************************************/
 static const ContentDir_BrowseResult*
 BrowseOrSearchWithCache (ContentDir* cds, void* result_context, 
@@ -395,13 +1366,12 @@ BrowseOrSearchWithCache (ContentDir* cds, void* result_context,
 		/*
 		 * No cache
 		 */
-		br->children = BrowseOrSearchAll (cds, br, objectId, criteria);
+		br->children = BrowseOrSearchAll (cds, br, objectId, criteria,
+						  false);
 	} else {
 		/*
 		 * Lookup and/or update cache 
 		 */   
-		ithread_mutex_lock (&cds->cache_mutex);
-
 		char key_buffer [strlen(objectId) + strlen(criteria) + 2 ];
 		const char* key;
 		if (criteria == CRITERIA_BROWSE_CHILDREN) {
@@ -412,27 +1382,69 @@ BrowseOrSearchWithCache (ContentDir* cds, void* result_context,
 			key = key_buffer;
 		}
 
-		Children** cp = (Children**) Cache_Get (cds->cache, key);
-		if (cp) {
-			if (*cp) {
-				// cache hit
-				br->children = *cp;
-			} else {
-				// cache new (or expired)
-
-				// Note: use the cache as parent context for 
-				// allocation of result.
-				br->children = BrowseOrSearchAll
-					(cds, cds->cache, objectId, criteria);
-				// set cache
-				*cp = br->children;
+		bool const subscribed = 
+			Service_IsSubscribed (OBJECT_SUPER_CAST(cds));
+		ithread_mutex_lock (&cds->cache_mutex);
+		CheckSubscription (cds, subscribed);
+
+		CacheFill* fill = cds->fills;
+		while (fill && strcmp (fill->key, key) != 0)
+			fill = fill->next;
+
+		bool stale = false;
+		Children** cp = (Children**) Cache_GetStale (cds->cache, key,
+							     &stale);
+		if (cp && *cp) {
+			// Do not keep a list truncated by an error
+			ithread_mutex_lock (&(*cp)->mutex);
+			bool const error = ((*cp)->rc != UPNP_E_SUCCESS);
+			ithread_mutex_unlock (&(*cp)->mutex);
+			if (error) {
+				cache_free_expired_data (key, *cp);
+				*cp = NULL;
 			}
 		}
-		// Add a reference to the cached result before returning it
-		if (br->children) {
+		if (cp && *cp) {
+			// cache hit (or stale data : refresh it in background)
+			br->children = *cp;
 			talloc_increase_ref_count (br->children);    
-			talloc_set_destructor (br, DestroyResult);
+			if (stale && fill == NULL)
+				StartRevalidate (cds, key, objectId, criteria);
+		} else if (fill) {
+			// same request already in progress : wait for it
+			br->children = WaitCacheFill (cds, fill);
+		} else if ((fill = talloc (NULL, CacheFill)) != NULL) {
+			// cache new (or expired) : fill it
+			*fill = (CacheFill) { 
+				.next = cds->fills,
+				.key  = talloc_strdup (fill, key),
+				.update_id = -1,
+			};
+			cds->fills = fill;
+			
+			// Send the request(s) with the cache unlocked. 
+			// Note: the result has no parent until it is 
+			// inserted into the cache.
+			ithread_mutex_unlock (&cds->cache_mutex);
+			intmax_t update_id = -1;
+			Children* children = NULL;
+			if (cds->snapshot_dir && 
+			    criteria == CRITERIA_BROWSE_CHILDREN)
+				children = LoadSnapshot (cds, objectId,
+							 &update_id);
+			if (children == NULL)
+				children = BrowseOrSearchAll 
+					(cds, NULL, objectId, criteria, true);
+			ithread_mutex_lock (&cds->cache_mutex);
+			fill->update_id = update_id;
+
+			// The reference from creation is kept for this 
+			// result.
+			br->children = children;
+			EndCacheFill (cds, fill, children);
 		}
+		if (br->children)
+			talloc_set_destructor (br, DestroyResult);
 		
 		ithread_mutex_unlock (&cds->cache_mutex);
 	}
@@ -469,27 +1481,37 @@ ContentDir_GetSearchCapabilities (ContentDir* self, void* unused)
 	if (self == NULL)
 		return NULL; // ---------->
 	
-	// Send Action if result not already cached
-	if (self->search_caps == NULL) {
+	Service* const serv = OBJECT_SUPER_CAST(self);
+	ithread_mutex_lock (&serv->mutex);
+	const char* search_caps = self->search_caps;
+	ithread_mutex_unlock (&serv->mutex);
+
+	// Send Action if result not already cached.
+	// Note: the service is not locked during the request, at worst
+	// concurrent threads will send the same request.
+	if (search_caps == NULL) {
 
 		IXML_Document* doc = NULL;
 		int rc = Service_SendActionVa
-			(OBJECT_SUPER_CAST(self), &doc,
-			 "GetSearchCapabilities",
-			 NULL, NULL);
+			(serv, &doc, "GetSearchCapabilities", NULL, NULL);
 		if (rc == UPNP_E_SUCCESS && doc != NULL) {
-			self->search_caps = talloc_strdup 
-				(self, XMLUtil_FindFirstElementValue
-				 (XML_D2N (doc), "SearchCaps", true, true));
+			ithread_mutex_lock (&serv->mutex);
+			if (self->search_caps == NULL)
+				self->search_caps = talloc_strdup 
+					(self, XMLUtil_FindFirstElementValue
+					 (XML_D2N (doc), "SearchCaps", 
+					  true, true));
+			search_caps = self->search_caps;
+			ithread_mutex_unlock (&serv->mutex);
 			
-			Log_Printf (LOG_DEBUG, 
+			LOG_PRINTF (LOG_DEBUG, 
 				    "ContentDir_GetSearchCapabilities = '%s'",
-				    NN(self->search_caps));
+				    NN(search_caps));
 		}
 		ixmlDocument_free (doc);
 	}
 	
-	return self->search_caps;
+	return search_caps;
 }
 
 
@@ -500,13 +1522,132 @@ const ContentDir_BrowseResult*
 ContentDir_Search (ContentDir* cds, void* result_context, 
 		   const char* objectId, const char* criteria)
 {
-	Log_Printf (LOG_DEBUG, "ContentDir_Search objectId='%s' criteria='%s'",
+	LOG_PRINTF (LOG_DEBUG, "ContentDir_Search objectId='%s' criteria='%s'",
 		    NN(objectId), NN(criteria));
 	return BrowseOrSearchWithCache (cds, result_context, 
 					objectId, criteria);
 }
 
 
+/*****************************************************************************
+ * update_variable
+ *
+ * Description:
+ *	Remove the cached lists which have changed on the server. 
+ *	"ContainerUpdateIDs" lists the changed containers, as pairs of 
+ *	comma separated values "id,update_id" : remove the list of children
+ *	of these containers. Metadata and search results can not be 
+ *	attributed to a container, and are all removed.
+ *	If the server does not send "ContainerUpdateIDs", the whole cache
+ *	is flushed when "SystemUpdateID" changes.
+ *	The containers whose list of children has been removed are reported
+ *	in "changes" (or "all", if the cache has been flushed).
+ *
+ *	Note: called with the Service locked.
+ *****************************************************************************/
+static bool
+is_not_children_key (const char* key, void* unused)
+{
+	// Children keys are the objectId alone, see BrowseOrSearchWithCache
+	return (strchr (key, '\t') != NULL);
+}
+
+static void
+InvalidateContainers (ContentDir* cds, const char* value,
+		      Service_Changes* changes)
+{
+	char* const id = talloc_size (NULL, strlen (value) + 1);
+	if (id == NULL)
+		return; // ---------->
+
+	const char* p = value;
+	while (*p) {
+		// Container id, unescaping "\," and "\\"
+		char* q = id;
+		while (*p && *p != ',') {
+			if (*p == '\\' && p[1])
+				p++;
+			*q++ = *p++;
+		}
+		*q = '\0';
+		// Skip update id
+		if (*p)
+			p++;
+		while (*p && *p != ',')
+			p++;
+		if (*p)
+			p++;
+
+		LOG_PRINTF (LOG_DEBUG, "ContentDir : container '%s' updated",
+			    id);
+		InvalidateKey (cds, id);
+		if (changes) {
+			char* const s = talloc_strdup (changes->objects, id);
+			if (s == NULL || ! PtrArray_Append (changes->objects,
+							    s))
+				changes->all = true; // can't tell which
+		}
+	}
+	talloc_free (id);
+	
+	InvalidateMatching (cds, is_not_children_key, NULL);
+}
+
+static void
+update_variable (Service* serv, const char* name, const char* value,
+		 Service_Changes* changes)
+{
+	ContentDir* const cds = (ContentDir*) serv;
+
+	if (cds->cache == NULL || name == NULL)
+		return; // ---------->
+
+	bool const container = (strcmp (name, "ContainerUpdateIDs") == 0);
+	if (! (container || strcmp (name, "SystemUpdateID") == 0))
+		return; // ---------->
+
+	ithread_mutex_lock (&cds->cache_mutex);
+
+	// After a new subscription, changes may have been missed : 
+	// trust "ContainerUpdateIDs" only once "SystemUpdateID" is known 
+	// for this subscription.
+	bool const same_sid = (cds->event_sid && serv->sid &&
+			       strcmp (cds->event_sid, serv->sid) == 0);
+
+	if (container) {
+		cds->container_update_ids = true;
+		if (same_sid && value)
+			InvalidateContainers (cds, value, changes);
+	} else {
+		bool const changed = 
+			(value == NULL || cds->system_update_id == NULL ||
+			 strcmp (cds->system_update_id, value) != 0);
+		if (changed && cds->system_update_id &&
+		    ! (same_sid && cds->container_update_ids)) {
+			LOG_PRINTF (LOG_DEBUG, "ContentDir : SystemUpdateID "
+				    "changed, flush cache");
+			InvalidateMatching (cds, NULL, NULL);
+			if (changes)
+				changes->all = true;
+		}
+		if (changed) {
+			talloc_free (cds->system_update_id);
+			cds->system_update_id = talloc_strdup (cds, value);
+		}
+		if (! same_sid) {
+			talloc_free (cds->event_sid);
+			cds->event_sid = talloc_strdup (cds, serv->sid);
+		}
+		if (! cds->evented) {
+			cds->evented = true;
+			Cache_SetMaxAge (cds->cache, CACHE_TIMEOUT_EVENTED);
+		}
+	}
+
+	ithread_mutex_unlock (&cds->cache_mutex);
+}
+
+
 /*****************************************************************************
  * get_status_string
  *****************************************************************************/
@@ -528,9 +1669,14 @@ get_status_string (const Service* serv,
 	void* const tmp_ctx = talloc_new (NULL);
 	
 	tpr (&p, "%s+- Browse Cache\n", spacer);
-	tpr (&p, "%s", Cache_GetStatusString 
-	     (cds->cache, tmp_ctx, talloc_asprintf (tmp_ctx, "%s      ",
-						    spacer)));
+	if (cds->cache) {
+		ContentDir* const mcds = discard_const_p (ContentDir, cds);
+		ithread_mutex_lock (&mcds->cache_mutex);
+		tpr (&p, "%s", Cache_GetStatusString 
+		     (cds->cache, tmp_ctx, 
+		      talloc_asprintf (tmp_ctx, "%s      ", spacer)));
+		ithread_mutex_unlock (&mcds->cache_mutex);
+	}
 	
 	// Delete all temporary strings
 	talloc_free (tmp_ctx);
@@ -553,6 +1699,23 @@ finalize (Object* obj)
 	ContentDir* const cds = (ContentDir*) obj;
 
 	if (cds && cds->cache) {
+		// Wait for the lists being received in the background
+		ithread_mutex_lock (&cds->cache_mutex);
+		cds->stopping = true;
+		while (cds->nb_fetches > 0)
+			ithread_cond_wait (&cds->cache_cond, 
+					   &cds->cache_mutex);
+		ithread_mutex_unlock (&cds->cache_mutex);
+
+		// Save the lists not saved yet by the janitor
+		if (cds->snapshot_dir)
+			SaveSnapshot (cds);
+
+		// Stop the cache janitor before the mutex is destroyed
+		talloc_free (cds->cache);
+		cds->cache = NULL;
+
+		ithread_cond_destroy (&cds->cache_cond);
 		ithread_mutex_destroy (&cds->cache_mutex);
 	}
 	
@@ -561,6 +1724,30 @@ finalize (Object* obj)
 }
 
 
+/*****************************************************************************
+ * ContentDir_SetMaxStale
+ *****************************************************************************/
+
+static time_t g_max_stale = 0;
+
+void
+ContentDir_SetMaxStale (time_t max_stale)
+{
+	g_max_stale = MAX (max_stale, 0);
+}
+
+
+/*****************************************************************************
+ * ContentDir_SetSnapshotDir
+ *****************************************************************************/
+void
+ContentDir_SetSnapshotDir (const char* dir)
+{
+	talloc_free (g_snapshot_dir);
+	g_snapshot_dir = (dir && *dir ? talloc_strdup (NULL, dir) : NULL);
+}
+
+
 /*****************************************************************************
  * OBJECT_INIT_CLASS
  *****************************************************************************/
@@ -571,6 +1758,7 @@ init_class (ContentDir_Class* const isa)
 { 
 	CLASS_BASE_CAST(isa)->finalize = finalize;
 	CLASS_SUPER_CAST(isa)->get_status_string = get_status_string;
+	CLASS_SUPER_CAST(isa)->update_variable   = update_variable;
 
 	// Class-specific initialization :
 	// Increase maximum permissible content-length for SOAP 
@@ -589,7 +1777,8 @@ ContentDir*
 ContentDir_Create (void* talloc_context, 
 		   UpnpClient_Handle ctrlpt_handle, 
 		   IXML_Element* serviceDesc, 
-		   const char* base_url)
+		   const char* base_url,
+		   const char* udn)
 {
 	OBJECT_SUPER_CONSTRUCT (ContentDir, Service_Create, talloc_context,
 				ctrlpt_handle, serviceDesc, base_url);
@@ -601,7 +1790,23 @@ ContentDir_Create (void* talloc_context,
 					    cache_free_expired_data);
 		if (self->cache == NULL)
 			goto error; // ---------->
+		Cache_SetLimits (self->cache, CACHE_MAX_ENTRIES, 
+				 CACHE_MAX_MEMORY, cache_data_size);
+		Cache_SetMaxStale (self->cache, g_max_stale);
 		ithread_mutex_init (&self->cache_mutex, NULL);
+		ithread_cond_init (&self->cache_cond, NULL);
+
+		self->snapshot_update_id = -1;
+		if (g_snapshot_dir && udn && *udn) {
+			char* const name = String_CleanFileName (self, udn);
+			self->snapshot_dir = talloc_asprintf 
+				(self, "%s/%s", g_snapshot_dir, name);
+			talloc_free (name);
+		}
+		if (self->snapshot_dir)
+			Cache_SetJanitorHook (self->cache, 
+					      snapshot_janitor_hook, self);
+		Cache_StartJanitor (self->cache, &self->cache_mutex);
 	}
 	
 	return self; // ---------->
@@ -31,6 +31,7 @@ extern "C" {
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <time.h>
 #include <upnp/ixml.h>
 #include <upnp/ithread.h>
 
@@ -48,6 +49,13 @@ typedef uint_fast32_t ContentDir_Index;
 #define CONTENT_DIR_SERVICE_TYPE \
 	"urn:schemas-upnp-org:service:ContentDirectory:1"
 
+// Maximum age of cached Browse results, in seconds. Information derived
+// from these results should not be kept longer.
+// (Browse results can be cached longer if the server sends events when
+// its content changes, but information derived from them is not notified
+// and keeps this timeout).
+#define CONTENT_DIR_CACHE_TIMEOUT	60
+
 
 
 
@@ -65,23 +73,81 @@ OBJECT_DECLARE_CLASS(ContentDir, Service);
 
 
 
-// TBD mutex used ?
-#define CONTENT_DIR_HAVE_CHILDREN_MUTEX		0
-
 /**
  * List of DIDL-object pointers, returned by Browse functions.
+ *
+ * Large lists are received in several pages : the list is returned 
+ * as soon as the first page is received, and the next pages are 
+ * appended in the background. Therefore the list shall only be read 
+ * with "ContentDir_Children_GetObject" or CONTENT_DIR_CHILDREN_FOR_EACH,
+ * which wait for the pages not yet received.
  */
 typedef struct _ContentDir_Children {
 
 	PtrArray* 	 objects; // List element type = "DIDLObject*"
-#if CONTENT_DIR_HAVE_CHILDREN_MUTEX
 	ithread_mutex_t  mutex;   /* to synchronise modifications to the list
 				     content */
-#endif
+	ithread_cond_t	 cond;	  // signaled when a page is appended
+	bool		 complete; // all pages received (or error)
+	int		 rc;	  // UPNP_E_SUCCESS, or error for a page
+
+	const void*	 index_owner;
+	const void*	 index;	  // see ContentDir_Children_GetIndex
+
+	size_t		 size;	  // memory used by the list, in bytes
+
+	// SystemUpdateID of the server before the list was requested,
+	// -1 if unknown (see ContentDir_SetSnapshotDir)
+	intmax_t	 update_id;
+	bool		 saved;	  // in the snapshot (set with the cache locked)
 
 } ContentDir_Children;
 
 
+/**
+ * Returns the object at position "index" in the list, waiting if 
+ * necessary for this page to be received.
+ * Returns NULL if "index" is past the end of the list.
+ */
+DIDLObject*
+ContentDir_Children_GetObject (ContentDir_Children* children, 
+			       ContentDir_Index index);
+
+/**
+ * Returns an index on a complete list, built once by "build" and kept 
+ * with the list (e.g. to lookup objects by name). "owner" identifies 
+ * the builder : only one index is kept per list.
+ * Returns NULL if the list is not complete yet, or if the list already
+ * has an index from another owner, or if error (the build is then 
+ * retried on the next call). 
+ * The index is destroyed with the list, and shall not be modified.
+ */
+typedef void* (*ContentDir_IndexBuilder) (void* talloc_context,
+					  const PtrArray* objects,
+					  const void* owner);
+const void*
+ContentDir_Children_GetIndex (ContentDir_Children* children,
+			      ContentDir_IndexBuilder build, 
+			      const void* owner);
+
+/**
+ * Iterate over a list of objects, waiting for the pages being received :
+ *
+ *	DIDLObject* o;
+ *	CONTENT_DIR_CHILDREN_FOR_EACH (children, o) {
+ *		...
+ *	} CONTENT_DIR_CHILDREN_FOR_EACH_END;
+ */
+#define CONTENT_DIR_CHILDREN_FOR_EACH(CHILDREN,OBJ)			\
+	do {								\
+		ContentDir_Index __idx##OBJ = 0;			\
+		while ((OBJ = ContentDir_Children_GetObject		\
+			(CHILDREN, __idx##OBJ++)) != NULL) {
+
+#define CONTENT_DIR_CHILDREN_FOR_EACH_END	\
+	} } while(0)
+
+
 /**
  * Result returned by Browse functions
  * (extra level of indirection regarding Children is needed internally
@@ -116,12 +182,41 @@ typedef enum _ContentDir_BrowseFlag {
  * @param ctrlpt_handle  the UPnP client handle
  * @param serviceDesc    the DOM service description document
  * @param base_url       the base url of the device description document
+ * @param udn            the UDN of the device (to name its snapshot, 
+ *			 see ContentDir_SetSnapshotDir), may be NULL
  *****************************************************************************/
 ContentDir* 
 ContentDir_Create (void* context,
 		   UpnpClient_Handle ctrlpt_handle, 
 		   IXML_Element* serviceDesc, 
-		   const char* base_url);
+		   const char* base_url,
+		   const char* udn);
+
+
+/*****************************************************************************
+ * @brief Serve expired Browse results from the cache, while they are 
+ *	refreshed in the background, up to "max_stale" seconds after their
+ *	expiration (instead of waiting for the server).
+ *	Applies to the ContentDirectory services created after this call.
+ *
+ * @param max_stale	in seconds. Set to 0 (the default) to disable.
+ *****************************************************************************/
+void
+ContentDir_SetMaxStale (time_t max_stale);
+
+
+/*****************************************************************************
+ * @brief Save the cached directory listings of each server in a snapshot
+ *	directory (regularly, and when the service is destroyed), and 
+ *	reload them when the same directories are listed again after 
+ *	restart, instead of browsing the server. A listing is reloaded only if the server 
+ *	"SystemUpdateID" has not changed since it was received.
+ *	Applies to the ContentDirectory services created after this call.
+ *
+ * @param dir		the snapshot directory, NULL (the default) to disable
+ *****************************************************************************/
+void
+ContentDir_SetSnapshotDir (const char* dir);
 
 
 /*****************************************************************************
@@ -35,6 +35,8 @@
  *
  *****************************************************************************/
 
+typedef struct _CacheFill CacheFill;
+
 OBJECT_DEFINE_METHODS(ContentDir,
 		      // No additional methods
 		      );
@@ -47,6 +49,21 @@ OBJECT_DEFINE_STRUCT(ContentDir,
 		     
 		     struct _Cache*	cache;
 		     ithread_mutex_t  	cache_mutex;
+		     ithread_cond_t	cache_cond;
+		     CacheFill*		fills;	// in progress, see cache_cond
+		     int		nb_fetches; // lists being received
+		     bool		stopping;
+
+		     // Events (see update_variable)
+		     bool		evented; // cache with CACHE_TIMEOUT_EVENTED
+		     bool		container_update_ids;
+		     char*		system_update_id;
+		     char*		event_sid; // subscription of the above
+
+		     // Snapshot (see ContentDir_SetSnapshotDir)
+		     char*		snapshot_dir; // NULL if disabled
+		     intmax_t		snapshot_update_id; // if not evented
+		     time_t		snapshot_update_time;
 		     );
 
 
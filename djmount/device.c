@@ -93,7 +93,7 @@ ServiceFactory (Device* dev,
 				    CONTENT_DIR_SERVICE_TYPE) == 0 ) {
 		serv = ContentDir_ToService 
 			(ContentDir_Create (dev, ctrlpt_handle, 
-					    serviceDesc, base_url));
+					    serviceDesc, base_url, dev->udn));
 	} else {
 		serv = Service_Create (dev, ctrlpt_handle,
 				       serviceDesc, base_url);
@@ -210,9 +210,10 @@ Device_Create (void* parent_context,
 		    "--------------------\n%s\n--------------------",
 		    NN(deviceId), descDocText);
 
+	// The document is not modified : allocate it in one arena
 	IXML_Document* descDoc = NULL;
-	int rc = ixmlParseBufferEx (discard_const_p (char, descDocText), 
-				    &descDoc);
+	int rc = ixmlParseBufferArenaEx (discard_const_p (char, descDocText), 
+					 &descDoc);
 	if (rc != IXML_SUCCESS) {
 		Log_Printf (LOG_ERROR, "Device_Create can't parse XML "
 			    "document (%d) = '%s'", rc, descDocText);
@@ -33,6 +33,7 @@
 #include "upnp_util.h"
 #include "log.h"
 #include "service.h"
+#include "content_dir.h"
 #include "talloc_util.h"
 
 #include <stdbool.h>
@@ -60,7 +61,12 @@ static char* g_ssdp_target = NULL;
  * Mutex for protecting the global device list
  * in a multi-threaded, asynchronous environment.
  * All functions should lock this mutex before reading
- * or writing the device list. 
+ * or writing the device list, and the services subscriptions (SID).
+ *
+ * Calls to a device or its services (which can take a long time, 
+ * e.g. SOAP actions) are not done under this mutex : it is only held 
+ * while looking up and pinning the device. Services protect their own
+ * state, so that calls to the same device can also run in parallel.
  */
 static ithread_mutex_t DeviceListMutex;
 
@@ -73,6 +79,9 @@ struct _DeviceNode {
   char*    deviceId; // as reported by the discovery callback
   Device*  d;
   int      expires; 
+
+  int      refcount;		// number of pins, see PinDeviceNode
+  bool     removed;		// removed from the list, destroy when unpinned
 };
 typedef struct _DeviceNode DeviceNode;
 
@@ -102,14 +111,79 @@ static void
 NotifyUpdate (DeviceList_EventType type,
 	      // TBD	      const char* varName,
 	      // TBD	      const char* varValue,
-	      const DeviceNode* devnode)
+	      const DeviceNode* devnode,
+	      const char* objectId)
 {
   if (gStateUpdateFun && devnode && devnode->d)
-    gStateUpdateFun (type, talloc_get_name (devnode->d));
+    gStateUpdateFun (type, talloc_get_name (devnode->d), objectId);
   // TBD: Add mutex here?
 }
 
 
+/*****************************************************************************
+ * PinDeviceNode
+ *
+ * Description: 
+ *       Prevent a device node from being destroyed, even if it is removed
+ *       from the global device list, until "UnpinDeviceNode" is called.
+ *       Must be called with the global device list locked.
+ *       Returns the device node (may be NULL).
+ *
+ *****************************************************************************/
+static DeviceNode*
+PinDeviceNode (DeviceNode* devnode)
+{
+  if (devnode)
+    devnode->refcount++;
+  return devnode;
+}
+
+
+/*****************************************************************************
+ * UnpinDeviceNode
+ *
+ * Description: 
+ *       Release a device node pinned by "PinDeviceNode", destroying it
+ *       if it has been removed from the list in the meantime.
+ *       Must be called with the global device list *unlocked*.
+ *
+ *****************************************************************************/
+static void
+UnpinDeviceNode (DeviceNode* devnode)
+{
+  if (devnode) {
+    ithread_mutex_lock (&DeviceListMutex);
+    bool const destroy = (--(devnode->refcount) == 0 && devnode->removed);
+    ithread_mutex_unlock (&DeviceListMutex);
+    if (destroy)
+      talloc_free (devnode);
+  }
+}
+
+
+/*****************************************************************************
+ * DetachDeviceNode
+ *
+ * Description: 
+ *       Mark a device node, just deleted from the global device list, 
+ *       as removed. Returns the node if it can be destroyed right now,
+ *       or NULL if it is still pinned (it will then be destroyed by the
+ *       last "UnpinDeviceNode").
+ *       Must be called with the global device list locked.
+ *
+ *****************************************************************************/
+static DeviceNode*
+DetachDeviceNode (DeviceNode* devnode)
+{
+  if (devnode) {
+    devnode->removed = true;
+    if (devnode->refcount > 0)
+      devnode = NULL;
+  }
+  return devnode;
+}
+
+
 /*****************************************************************************
  * GetDeviceNodeFromName
  *
@@ -159,7 +233,7 @@ GetDeviceListNodeFromId (const char* deviceId)
 }
 
 static Service*
-GetService (const char* s, enum GetFrom from) 
+GetService (const char* s, enum GetFrom from, DeviceNode** devnode_ptr) 
 {
 	ListNode* node;
 	for (node = ListHead (&GlobalDeviceList);
@@ -169,8 +243,11 @@ GetService (const char* s, enum GetFrom from)
 		if (devnode) {
 			Service* const serv = Device_GetServiceFrom 
 				(devnode->d, s, from, false);
-			if (serv) 
+			if (serv) {
+				if (devnode_ptr)
+					*devnode_ptr = devnode;
 				return serv; // ---------->
+			}
 		}
 	}
 	Log_Printf (LOG_ERROR, "Can't find service matching %s in device list",
@@ -229,7 +306,8 @@ DeviceList_RemoveDevice (const char* deviceId)
 		node->item = 0;
 		ListDelNode (&GlobalDeviceList, node, /*freeItem=>*/ 0);
 		// Do the notification while the global list is still locked
-		NotifyUpdate (E_DEVICE_REMOVED, devnode);
+		NotifyUpdate (E_DEVICE_REMOVED, devnode, NULL);
+		devnode = DetachDeviceNode (devnode);
                 ithread_mutex_unlock (&DeviceListMutex);
 		talloc_free (devnode);
                 ithread_mutex_lock (&DeviceListMutex);
@@ -258,6 +336,10 @@ DeviceList_RemoveDevice (const char* deviceId)
 static int
 DeviceList_RemoveAll (void)
 {
+  // Devices are destroyed after unlocking the global list, because 
+  // this may wait for requests in progress (see ContentDir)
+  void* const removed = talloc_new (NULL);
+
   ithread_mutex_lock( &DeviceListMutex );
 
   ListNode* node;
@@ -267,13 +349,15 @@ DeviceList_RemoveAll (void)
     DeviceNode* devnode = node->item;
     node->item = 0;
     // Do the notifications while the global list is still locked
-    NotifyUpdate (E_DEVICE_REMOVED, devnode);
-    talloc_free (devnode);
+    NotifyUpdate (E_DEVICE_REMOVED, devnode, NULL);
+    talloc_steal (removed, DetachDeviceNode (devnode));
   }
   ListDestroy (&GlobalDeviceList, /*freeItem=>*/ 0);
   ListInit (&GlobalDeviceList, 0, 0);
 
   ithread_mutex_unlock( &DeviceListMutex );
+
+  talloc_free (removed);
   
   return UPNP_E_SUCCESS;
 }
@@ -293,7 +377,7 @@ DeviceList_RefreshAll (bool remove_all)
 	 * Search for all 'target' providers,
 	 * waiting for up to 5 seconds for the response 
 	 */
-	Log_Printf (LOG_DEBUG, "RefreshAll target=%s", NN(g_ssdp_target));
+	LOG_PRINTF (LOG_DEBUG, "RefreshAll target=%s", NN(g_ssdp_target));
 	int rc = UpnpSearchAsync (g_ctrlpt_handle, 5 /* seconds */, 
 				  g_ssdp_target, NULL);
 	if (UPNP_E_SUCCESS != rc) 
@@ -321,14 +405,35 @@ HandleEvent (Upnp_SID sid,
 	     int eventkey,
 	     IXML_Document* changes )
 {
+  DeviceNode* devnode = NULL;
+
   ithread_mutex_lock( &DeviceListMutex );
   
-  Log_Printf (LOG_DEBUG, "Received Event: %d for SID %s", eventkey, NN(sid));
-  Service* const serv = GetService (sid, FROM_SID);
-  if (serv) 
-    Service_UpdateState (serv, changes);
+  LOG_PRINTF (LOG_DEBUG, "Received Event: %d for SID %s", eventkey, NN(sid));
+  Service* const serv = GetService (sid, FROM_SID, &devnode);
+  if (serv)
+    PinDeviceNode (devnode);
   
   ithread_mutex_unlock( &DeviceListMutex );
+
+  // Update the state table with the device list unlocked, so that the
+  // event does not wait for calls to other devices.
+  // Note: only the changes reported by the service are notified (e.g.
+  // not the events of the other services, or the initial event).
+  if (serv) {
+    Service_Changes changed = { .objects = PtrArray_Create (NULL) };
+    Service_UpdateState (serv, changes, (changed.objects ? &changed : NULL));
+    if (changed.all || changed.objects == NULL) {
+      NotifyUpdate (E_STATE_UPDATE, devnode, NULL);
+    } else {
+      const char* objectId;
+      PTR_ARRAY_FOR_EACH_PTR (changed.objects, objectId) {
+	NotifyUpdate (E_STATE_UPDATE, devnode, objectId);
+      } PTR_ARRAY_FOR_EACH_PTR_END;
+    }
+    talloc_free (changed.objects);
+    UnpinDeviceNode (devnode);
+  }
 }
 
 
@@ -361,14 +466,14 @@ AddDevice (const char* deviceId,
 	if (devnode) {
 		// The device is already there, so just update 
 		// the advertisement timeout field
-		Log_Printf (LOG_DEBUG, 
+		LOG_PRINTF (LOG_DEBUG, 
 			    "AddDevice Id=%s already exists, "
 			    "only update expiration = %d seconds",
 			    NN(deviceId), expires);
 		devnode->expires = expires;
 	} else {
 		// Else create a new device
-		Log_Printf (LOG_DEBUG, "AddDevice try new device Id=%s", 
+		LOG_PRINTF (LOG_DEBUG, "AddDevice try new device Id=%s", 
 			    NN(deviceId));
 		
 		// *unlock* before trying to download the Device Description 
@@ -434,7 +539,7 @@ AddDevice (const char* deviceId,
 					(devnode->d, g_ssdp_target, 
 					 FROM_SERVICE_TYPE, false);
 				if (serv == NULL) {
-					Log_Printf (LOG_DEBUG,
+					LOG_PRINTF (LOG_DEBUG,
 						    "Discovered device Id=%s "
 						    "has no '%s' service : "
 						    "forgetting", NN(deviceId),
@@ -483,7 +588,7 @@ AddDevice (const char* deviceId,
 				
 				// Notify New Device Added, while the global 
 				// list is still locked
-				NotifyUpdate (E_DEVICE_ADDED, devnode);
+				NotifyUpdate (E_DEVICE_ADDED, devnode, NULL);
 			}
 		}
 	}
@@ -513,8 +618,11 @@ EventHandlerCallback (Upnp_EventType event_type,
 	// Create a working context for temporary strings
 	void* const tmp_ctx = talloc_new (NULL);
 
-	Log_Print (LOG_DEBUG, UpnpUtil_GetEventString (tmp_ctx, event_type, 
-						       event));
+	// Note: the event is converted to a string (including all the
+	// changed variables) only if it is logged.
+	if (LOG_IS_DEBUG_ACTIVATED)
+		Log_Print (LOG_DEBUG, UpnpUtil_GetEventString 
+			   (tmp_ctx, event_type, event));
 	
 	switch ( event_type ) {
 		/*
@@ -534,12 +642,12 @@ EventHandlerCallback (Upnp_EventType event_type,
 		// TBD else ??
       
 		if (e->DeviceId && e->DeviceId[0]) { 
-			Log_Printf (LOG_DEBUG, 
+			LOG_PRINTF (LOG_DEBUG, 
 				    "Discovery : device type '%s' "
 				    "OS '%s' at URL '%s'", NN(e->DeviceType), 
 				    NN(e->Os), NN(e->Location));
 			AddDevice (e->DeviceId, e->Location, e->Expires);
-			Log_Printf (LOG_DEBUG, "Discovery: "
+			LOG_PRINTF (LOG_DEBUG, "Discovery: "
 				    "DeviceList after AddDevice = \n%s",
 				    DeviceList_GetStatusString (tmp_ctx));
 		}
@@ -563,11 +671,11 @@ EventHandlerCallback (Upnp_EventType event_type,
 				    e->ErrCode );
 		}
 		
-		Log_Printf (LOG_DEBUG, "Received ByeBye for Device: %s",
+		LOG_PRINTF (LOG_DEBUG, "Received ByeBye for Device: %s",
 			    e->DeviceId );
 		DeviceList_RemoveDevice (e->DeviceId);
 		
-		Log_Printf (LOG_DEBUG, "DeviceList after byebye: \n%s",
+		LOG_PRINTF (LOG_DEBUG, "DeviceList after byebye: \n%s",
 			    DeviceList_GetStatusString (tmp_ctx));
 		break;
 	}
@@ -625,20 +733,28 @@ EventHandlerCallback (Upnp_EventType event_type,
 				    "Error in Event Subscribe Callback -- %d",
 				    e->ErrCode );
 		} else {
-			Log_Printf (LOG_DEBUG, 
+			LOG_PRINTF (LOG_DEBUG, 
 				    "Received Event Renewal for eventURL %s", 
 				    NN(e->PublisherUrl));
 
 			ithread_mutex_lock (&DeviceListMutex);
 
+			DeviceNode* devnode = NULL;
 			Service* const serv = GetService (e->PublisherUrl,
-							  FROM_EVENT_URL);
+							  FROM_EVENT_URL, 
+							  &devnode);
 			if (serv) {
 				if (event_type == 
-				    UPNP_EVENT_UNSUBSCRIBE_COMPLETE)
+				    UPNP_EVENT_UNSUBSCRIBE_COMPLETE) {
 					Service_SetSid (serv, NULL);
-				else			      
+					// No more events : changes can
+					// be missed from now on
+					if (OBJECT_IS_A (serv, ContentDir))
+						NotifyUpdate (E_STATE_UPDATE, 
+							      devnode, NULL);
+				} else {
 					Service_SetSid (serv, e->Sid);
+				}
 			}
 			ithread_mutex_unlock (&DeviceListMutex);
 		}
@@ -651,15 +767,20 @@ EventHandlerCallback (Upnp_EventType event_type,
 		struct Upnp_Event_Subscribe* e = 
 			(struct Upnp_Event_Subscribe*) event;
 
-		Log_Printf (LOG_DEBUG, "Renewing subscription for eventURL %s",
+		LOG_PRINTF (LOG_DEBUG, "Renewing subscription for eventURL %s",
 			    NN(e->PublisherUrl));
      
 		ithread_mutex_lock (&DeviceListMutex);
       
+		DeviceNode* devnode = NULL;
 		Service* const serv = GetService (e->PublisherUrl, 
-						  FROM_EVENT_URL);
-		if (serv) 
+						  FROM_EVENT_URL, &devnode);
+		if (serv) {
 			Service_SubscribeEventURL (serv);
+			// Changes may have been missed meanwhile
+			if (OBJECT_IS_A (serv, ContentDir))
+				NotifyUpdate (E_STATE_UPDATE, devnode, NULL);
+		}
 		
 		ithread_mutex_unlock (&DeviceListMutex);
 		
@@ -683,72 +804,64 @@ EventHandlerCallback (Upnp_EventType event_type,
 
 
 /*****************************************************************************
- * _DeviceList_LockDevice
+ * PinDeviceNodeFromName
+ *
+ * Description: 
+ *       Find a device in the global device list, and pin it.
+ *       The global list itself is only locked during the search, so that 
+ *       other threads can use the device list while this device is used.
+ *
  *****************************************************************************/
-Device*
-_DeviceList_LockDevice (const char* deviceName)
+static DeviceNode*
+PinDeviceNodeFromName (const char* deviceName)
 {
-	Device* dev = NULL;
-
-	Log_Printf (LOG_DEBUG, "LockDevice : device '%s'", NN(deviceName));
-
-	// XXX coarse implementation : lock the whole device list, 
-	// XXX not only the device.
 	ithread_mutex_lock (&DeviceListMutex);
-	
-	const DeviceNode* devnode = GetDeviceNodeFromName (deviceName, true);
-	if (devnode) 
-		dev = devnode->d;
-	if (dev == NULL)
-		ithread_mutex_unlock (&DeviceListMutex);
-	return dev;
+	DeviceNode* const devnode = 
+		PinDeviceNode (GetDeviceNodeFromName (deviceName, true));
+	ithread_mutex_unlock (&DeviceListMutex);
+	return devnode;
 }
 
 
 /*****************************************************************************
- * _DeviceList_UnlockDevice
+ * _DeviceList_PinDevice
  *****************************************************************************/
-inline void
-_DeviceList_UnlockDevice (Device* dev)
+DeviceNode*
+_DeviceList_PinDevice (const char* deviceName, Device** dev)
 {
-	if (dev)
-		ithread_mutex_unlock (&DeviceListMutex);
+	LOG_PRINTF (LOG_DEBUG, "PinDevice : device '%s'", NN(deviceName));
+
+	DeviceNode* const devnode = PinDeviceNodeFromName (deviceName);
+	*dev = (devnode ? devnode->d : NULL);
+	return devnode;
 }
 
 
 /*****************************************************************************
- * _DeviceList_LockService
+ * _DeviceList_PinService
  *****************************************************************************/
-Service*
-_DeviceList_LockService (const char* deviceName, const char* serviceType)
+DeviceNode*
+_DeviceList_PinService (const char* deviceName, const char* serviceType,
+			Service** serv)
 {
-	Service* serv = NULL;
-
-	Log_Printf (LOG_DEBUG, "LockService : device '%s' service '%s'",
+	LOG_PRINTF (LOG_DEBUG, "PinService : device '%s' service '%s'",
 		    NN(deviceName), NN(serviceType));
 
-	// XXX coarse implementation : lock the whole device list, 
-	// XXX not only the service.
-	ithread_mutex_lock (&DeviceListMutex);
-	
-	const DeviceNode* devnode = GetDeviceNodeFromName (deviceName, true);
-	if (devnode) 
-		serv = Device_GetServiceFrom (devnode->d, serviceType, 
-					      FROM_SERVICE_TYPE, true);
-	if (serv == NULL)
-		ithread_mutex_unlock (&DeviceListMutex);
-	return serv;
+	DeviceNode* const devnode = PinDeviceNodeFromName (deviceName);
+	*serv = (devnode ? Device_GetServiceFrom (devnode->d, serviceType, 
+						  FROM_SERVICE_TYPE, true) 
+		 : NULL);
+	return devnode;
 }
 
 
 /*****************************************************************************
- * _DeviceList_UnlockService
+ * _DeviceList_Unpin
  *****************************************************************************/
-inline void
-_DeviceList_UnlockService (Service* serv)
+void
+_DeviceList_Unpin (DeviceNode* devnode)
 {
-	if (serv)
-		ithread_mutex_unlock (&DeviceListMutex);
+	UnpinDeviceNode (devnode);
 }
 
 
@@ -793,7 +906,7 @@ DeviceList_GetDevicesNames (void* context)
 {
 	ithread_mutex_lock (&DeviceListMutex);
 
-	Log_Printf (LOG_DEBUG, "GetDevicesNames");
+	LOG_PRINTF (LOG_DEBUG, "GetDevicesNames");
 	PtrArray* const a = PtrArray_CreateWithCapacity 
 		(context, ListSize (&GlobalDeviceList));
 	if (a) {
@@ -898,6 +1011,10 @@ DeviceList_GetDeviceStatusString (void* context, const char* deviceName,
 static void
 VerifyTimeouts (int incr)
 {
+	// Expired devices are destroyed after unlocking the global list,
+	// because this may wait for requests in progress (see ContentDir)
+	void* const removed = talloc_new (NULL);
+
 	ithread_mutex_lock (&DeviceListMutex);
   
 	// During this traversal we pre-compute the next node in case 
@@ -913,20 +1030,20 @@ VerifyTimeouts (int incr)
 		
 		if (devnode->expires <= -incr) {
 			// Too late : really remove the device from the list 
-			Log_Printf (LOG_DEBUG, "Remove expired device Id=%s", 
+			LOG_PRINTF (LOG_DEBUG, "Remove expired device Id=%s", 
 				    devnode->deviceId);
 			node->item = NULL;
 			ListDelNode (&GlobalDeviceList, node, /*freeItem=>*/0);
 			// Do the notification while the global list is locked
-			NotifyUpdate (E_DEVICE_REMOVED, devnode);
-			talloc_free (devnode);
+			NotifyUpdate (E_DEVICE_REMOVED, devnode, NULL);
+			talloc_steal (removed, DetachDeviceNode (devnode));
 
 		} else if (devnode->expires <= 0) {
 			// This advertisement has expired, so we should 
 			// normally remove the device from the list.
 			// First, send out a search request for this device 
 			// UDN to try to renew.
-			Log_Printf (LOG_DEBUG, 
+			LOG_PRINTF (LOG_DEBUG, 
 				    "Trying to renew expired device Id=%s", 
 				    devnode->deviceId);
 			int rc = UpnpSearchAsync (g_ctrlpt_handle, incr,
@@ -939,6 +1056,8 @@ VerifyTimeouts (int incr)
 		}
 	}
 	ithread_mutex_unlock (&DeviceListMutex);
+
+	talloc_free (removed);
 }
 
 
@@ -992,7 +1111,7 @@ DeviceList_Start (const char* ssdp_target,
 	// Makes the XML parser more tolerant to malformed text
 	ixmlRelaxParser ('?');
 	
-	Log_Printf (LOG_DEBUG, "Intializing UPnP with ipaddress=%s port=%d",
+	LOG_PRINTF (LOG_DEBUG, "Intializing UPnP with ipaddress=%s port=%d",
 		    NN(ip_address), port);
 	rc = UpnpInit (ip_address, port);
 	if( UPNP_E_SUCCESS != rc ) {
@@ -1015,7 +1134,7 @@ DeviceList_Start (const char* ssdp_target,
 	Log_Printf (LOG_INFO, "UPnP Initialized (%s:%d)", 
 		    NN(ip_address), port);
 	
-	Log_Printf (LOG_DEBUG, "Registering Control Point" );
+	LOG_PRINTF (LOG_DEBUG, "Registering Control Point" );
 	rc = UpnpRegisterClient (EventHandlerCallback,
 				 &g_ctrlpt_handle, &g_ctrlpt_handle);
 	if( UPNP_E_SUCCESS != rc ) {
@@ -1024,7 +1143,7 @@ DeviceList_Start (const char* ssdp_target,
 		return rc; // ---------->
 	}
 	
-	Log_Printf (LOG_DEBUG, "Control Point Registered" );
+	LOG_PRINTF (LOG_DEBUG, "Control Point Registered" );
 	
 	g_ssdp_target = talloc_strdup (NULL, ssdp_target);
 	DeviceList_RefreshAll (true);
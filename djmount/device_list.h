@@ -49,10 +49,15 @@ extern "C" {
  *   const char * varName
  *   const char * varValue
  *   const char * deviceName
+ *   const char * objectId	for E_STATE_UPDATE, the ContentDirectory 
+ *				object which has changed, or NULL if any
+ *				object may have changed
  *****************************************************************************/
 
 typedef enum DeviceList_EventType {
-  // TBD E_STATE_UPDATE     = 0,
+  E_STATE_UPDATE     = 0,	// the ContentDirectory has sent an event
+				// changing an object, or its events may 
+				// have been lost
   E_DEVICE_ADDED     = 1,
   E_DEVICE_REMOVED   = 2,
   // TBD  E_GET_VAR_COMPLETE = 3
@@ -60,7 +65,8 @@ typedef enum DeviceList_EventType {
 } DeviceList_EventType;
 
 typedef void (*DeviceList_EventCallback) (DeviceList_EventType type,
-					  const char* deviceName);
+					  const char* deviceName,
+					  const char* objectId);
   // TBD					  const char* varName, 
   // TBD					  const char* varValue, 
 
@@ -82,6 +88,8 @@ DeviceList_RefreshAll (bool remove_all);
  * @fn	  DEVICE_LIST_CALL_DEVICE
  * @brief Finds a Device in the global device list, and calls the specified
  *	  methods on it (the method shall check for NULL Device).
+ *	  The global device list is not locked during the call : calls to
+ *	  other devices can proceed in parallel.
  *
  * Example:
  *	const char* res;
@@ -94,9 +102,11 @@ DeviceList_RefreshAll (bool remove_all);
 
 #define DEVICE_LIST_CALL_DEVICE(RET,DEVNAME,METHOD,...)		\
   do {								\
-    struct _Device* __dev = _DeviceList_LockDevice (DEVNAME);	\
+    struct _Device* __dev = NULL;				\
+    struct _DeviceNode* const __node =				\
+      _DeviceList_PinDevice (DEVNAME, &__dev);			\
     RET = Device ## _ ## METHOD (__dev, __VA_ARGS__);		\
-    _DeviceList_UnlockDevice (__dev);				\
+    _DeviceList_Unpin (__node);					\
   } while (0)								
 
 
@@ -104,6 +114,8 @@ DeviceList_RefreshAll (bool remove_all);
  * @fn	  DEVICE_LIST_CALL_SERVICE
  * @brief Finds a Service in the global device list, and calls the specified
  *	  methods on it (the method shall check for NULL Service).
+ *	  The global device list is not locked during the call : calls to
+ *	  this or other devices can proceed in parallel.
  *
  * Example:
  *	int rc;
@@ -117,10 +129,12 @@ DeviceList_RefreshAll (bool remove_all);
 
 #define DEVICE_LIST_CALL_SERVICE(RET,DEVNAME,SERVTYPE,SERVCLASS,METHOD,...) \
   do {									\
-    Service* __serv = _DeviceList_LockService(DEVNAME,SERVTYPE);	\
+    Service* __serv = NULL;						\
+    struct _DeviceNode* const __node =					\
+      _DeviceList_PinService (DEVNAME, SERVTYPE, &__serv);		\
     RET = SERVCLASS ## _ ## METHOD					\
       (OBJECT_DYNAMIC_CAST(__serv, SERVCLASS), __VA_ARGS__);		\
-    _DeviceList_UnlockService(__serv);					\
+    _DeviceList_Unpin (__node);						\
   } while (0)								
 
 
@@ -225,6 +239,10 @@ DeviceList_GetDeviceStatusString (void* talloc_context,
  * 
  * @param target    the search target as defined in the UPnP Device 
  *                  Architecture v1.0 specification e.g. "ssdp:all" for all.
+ * @param eventCallback	function called when a device is added, removed,
+ *			or has sent an event (may be NULL). It is called
+ *			from UPnP threads, possibly with the device list
+ *			locked : it should not call DeviceList functions.
  * @return UPNP_E_SUCCESS if everything went well, else a UPNP error code
  *****************************************************************************/
 int 
@@ -243,19 +261,23 @@ DeviceList_Stop (void);
 
 
 /*****************************************************************************
- * Internal methods, do not use directly
+ * Internal methods, do not use directly.
+ * The Pin methods return a handle on the device, which cannot be destroyed
+ * until released with "_DeviceList_Unpin" (or NULL if the device is not 
+ * found).
  *****************************************************************************/
-struct _Device*
-_DeviceList_LockDevice (const char* deviceName);
+struct _Device;
+struct _DeviceNode;
 
-void
-_DeviceList_UnlockDevice (struct _Device* dev);
+struct _DeviceNode*
+_DeviceList_PinDevice (const char* deviceName, struct _Device** dev);
 
-Service*
-_DeviceList_LockService (const char* deviceName, const char* serviceType);
+struct _DeviceNode*
+_DeviceList_PinService (const char* deviceName, const char* serviceType,
+			Service** serv);
 
 void
-_DeviceList_UnlockService (Service* serv);
+_DeviceList_Unpin (struct _DeviceNode* devnode);
 
 
 
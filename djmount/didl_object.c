@@ -28,120 +28,336 @@
 #include "string_util.h"
 #include "xml_util.h"
 #include "talloc_util.h"
+#include "sax_parser.h"
+#include <string.h>
 
 
 /******************************************************************************
- * DestroyObject
+ * Settings
+ *****************************************************************************/
+
+static bool g_keep_xml = true;
+
+
+/******************************************************************************
+ * ListParser
  *
- * Description: 
- *	DIDL Object destructor, automatically called by "talloc_free".
+ * Description:
+ *	State of DIDLObject_CreateList. The properties of the current object
+ *	are collected in "tmp_ctx" while parsing it, then copied into the 
+ *	object block when its end tag is reached.
  *
  *****************************************************************************/
-static int
-DestroyObject (DIDLObject* const o)
-{
-	if (o) {
-		ixmlElement_free (o->element);
-		
-		// The "talloc'ed" strings will be deleted automatically 
-	}
-	return 0; // ok -> deallocate memory
-}
+typedef struct _Res {
+	char*		uri;
+	char*		protocol_info;
+	char*		size;
+	char*		duration;
+} Res;
+
+typedef struct _ListParser {
+	PtrArray*	containers;
+	PtrArray*	items;
+	int		nb_objects;
+
+	// Current object
+	const char*	object;	// start tag, or NULL if none
+	bool		is_container;
+	void*		tmp_ctx;
+	char*		id;
+	bool		searchable;
+	char*		title;
+	char*		cds_class;
+	Res*		res;
+	size_t		nb_res;
+	char**		text;	// property receiving the current text
+} ListParser;
 
 
 /******************************************************************************
- * DIDLObject_Create
+ * CreateObject
+ *
+ * Description:
+ *	Create the current object, in one memory block : the object, then
+ *	its resources, then the strings.
+ *	"xml" is the source of the element (not nul-terminated).
+ *
  *****************************************************************************/
-DIDLObject*
-DIDLObject_Create (void* talloc_context,
-		   IN IXML_Element* elem, 
-		   IN bool is_container) 
+typedef struct _Block {
+	DIDLObject	o;
+	DIDLResource	res[];
+} Block;
+
+static inline size_t
+string_size (const char* s)
 {
-	if (elem == NULL) {
-		Log_Printf (LOG_ERROR, 
-			    "DIDLObject can't create from NULL XML Element");
+	return (s ? strlen (s) + 1 : 0);
+}
+
+static const char*
+copy_string (char** dest, const char* s, size_t len)
+{
+	if (s == NULL)
+		return NULL; // ---------->
+	char* const res = *dest;
+	memcpy (res, s, len);
+	res [len] = '\0';
+	*dest += len + 1;
+	return res;
+}
+
+#define COPY_STRING(DEST,S)	copy_string (DEST, S, (S) ? strlen (S) : 0)
+
+static DIDLObject*
+CreateObject (void* talloc_context, ListParser* lp, 
+	      const char* xml, size_t xml_len)
+{
+	void* const tmp_ctx = lp->tmp_ctx;
+
+	if (lp->id == NULL || lp->id[0] == NUL) {
+		Log_Printf (LOG_ERROR, "DIDLObject can't create with NULL "
+			    "or empty id, XML = %.*s", (int) xml_len, xml);
 		return NULL; // ---------->
 	}
 
-	DIDLObject* o = talloc (talloc_context, DIDLObject);
-	if (o) {
-		*o = (DIDLObject) { 
-			.is_container = is_container
-		};
+	const char* const title = (lp->title ? lp->title : "");
+	char* basename = String_CleanFileName (tmp_ctx, title);
+	if (basename == NULL)
+		return NULL; // ---------->
+	if (basename[0] == NUL) {
+		Log_Printf (LOG_WARNING, "DIDLObject NULL or empty "
+			    "<dc:title>, XML = %.*s", (int) xml_len, xml);
+		basename = talloc_asprintf (tmp_ctx, "-id-%s", lp->id);
+	} else if (basename[0] == '.' || basename[0] == '_') {
+		basename[0] = '-';
+	}
 
-		IXML_Node* node = NULL;
-		/* Steal the node from its parent (instead of copying it, given
-		 * that the parent document is going to be deallocated anyway)
-		 */
-		ixmlNode_removeChild (ixmlNode_getParentNode (XML_E2N (elem)), 
-				      XML_E2N (elem), &node);
-		o->element = (IXML_Element*) node;
-
-		// TBD need to copy ??
-		o->id = talloc_strdup (o, ixmlElement_getAttribute
-				       (o->element, "id"));
-		if (o->id == NULL || o->id[0] == NUL) {
-			char* s = DIDLObject_GetElementString (o, NULL);
-			Log_Printf (LOG_ERROR, 
-				    "DIDLObject can't create with NULL "
-				    "or empty id, XML = %s", s);
-			talloc_free (s);
-			talloc_free (o);
-			return NULL; // ---------->
+	const char* cds_class = String_StripSpaces (tmp_ctx, lp->cds_class);
+	if (cds_class == NULL)
+		cds_class = "";
+
+	// Compute the size of the block
+	size_t nb_res = 0;
+	size_t bytes = string_size (lp->id) + string_size (title) +
+		string_size (cds_class) + string_size (basename);
+	if (g_keep_xml)
+		bytes += xml_len + 1;
+	size_t i;
+	for (i = 0; i < lp->nb_res; i++) {
+		const Res* const r = lp->res + i;
+		// Note: a resource without URI (e.g. "<res/>") is dropped
+		if (r->uri && *r->uri) {
+			nb_res++;
+			bytes += string_size (r->uri) + 
+				string_size (r->protocol_info) +
+				string_size (r->duration);
 		}
+	}
+	bytes += sizeof (Block) + nb_res * sizeof (DIDLResource);
 
-		o->title = XMLUtil_FindFirstElementValue (node, "dc:title", 
-							  false, true);
-		if (o->title == NULL)
-			o->title = "";
-
-		o->basename = String_CleanFileName (o, o->title);
-		if (o->basename[0] == NUL) {
-			char* s = DIDLObject_GetElementString (o, NULL);
-			Log_Printf (LOG_WARNING, 
-				    "DIDLObject NULL or empty <dc:title>, "
-				    "XML = %s", s);
-			talloc_free (s);
-			talloc_free (o->basename);
-			o->basename = talloc_asprintf (o, "-id-%s", o->id);
-		} else if (o->basename[0] == '.' || o->basename[0] == '_') {
-			o->basename[0] = '-';
+	Block* const b = talloc_named_const (talloc_context, bytes, 
+					     "DIDLObject");
+	if (b == NULL)
+		return NULL; // ---------->
+	char* p = (char*) (b->res + nb_res);
+	DIDLObject* const o = &b->o;
+	*o = (DIDLObject) {
+		.is_container = lp->is_container,
+		.id	      = COPY_STRING (&p, lp->id),
+		.title	      = COPY_STRING (&p, title),
+		.cds_class    = COPY_STRING (&p, cds_class),
+		.searchable   = lp->searchable,
+		.nb_res	      = nb_res,
+		.res	      = b->res,
+		.xml	      = (g_keep_xml ? copy_string (&p, xml, xml_len)
+				 : NULL),
+		.basename     = COPY_STRING (&p, basename),
+	};
+	DIDLResource* res = b->res;
+	for (i = 0; i < lp->nb_res; i++) {
+		const Res* const r = lp->res + i;
+		if (r->uri && *r->uri) {
+			*res = (DIDLResource) {
+				.uri	       = COPY_STRING (&p, r->uri),
+				.protocol_info = COPY_STRING 
+				(&p, r->protocol_info),
+				.duration      = COPY_STRING (&p, r->duration),
+			};
+			STRING_TO_INT (r->size, res->size, -1);
+			res++;
 		}
-		
-		o->cds_class = String_StripSpaces 
-			(o, XMLUtil_FindFirstElementValue (node, "upnp:class",
-							   false, true));
-		if (o->cds_class == NULL)
-			o->cds_class = "";
-
-		char* s = ixmlElement_getAttribute (o->element, "searchable");
-		o->searchable = String_ToBoolean (s, false);
-
-		Log_Printf (LOG_DEBUG,
-			    "new DIDLObject : %s : id='%s' "
-			    "title='%s' class='%s'",
-			    (is_container ? "container" : "item"), 
-			    o->id, o->title, o->cds_class);
-		
-		// Register destructor
-		talloc_set_destructor (o, DestroyObject);
 	}
+
+	LOG_PRINTF (LOG_DEBUG,
+		    "new DIDLObject : %s : id='%s' "
+		    "title='%s' class='%s'",
+		    (o->is_container ? "container" : "item"), 
+		    o->id, o->title, o->cds_class);
 	return o;
 }
 
 
+/******************************************************************************
+ * DIDLObject_CreateList
+ *****************************************************************************/
+static int
+list_start (void* user, int depth, const char* name, const char** atts,
+	    const char* tag)
+{
+	ListParser* const lp = (ListParser*) user;
+	if (depth == 1) {
+		lp->is_container = (strcmp (name, "container") == 0);
+		if (lp->is_container || strcmp (name, "item") == 0) {
+			lp->object     = tag;
+			lp->tmp_ctx    = talloc_new (NULL);
+			lp->id	       = talloc_strdup 
+				(lp->tmp_ctx, SaxParser_GetAttribute (atts,
+								      "id"));
+			lp->searchable = String_ToBoolean 
+				(SaxParser_GetAttribute (atts, "searchable"),
+				 false);
+		}
+	} else if (depth == 2 && lp->object) {
+		// Note: keep the first property if several
+		if (strcmp (name, "dc:title") == 0) {
+			if (lp->title == NULL)
+				lp->text = &lp->title;
+		} else if (strcmp (name, "upnp:class") == 0) {
+			if (lp->cds_class == NULL)
+				lp->text = &lp->cds_class;
+		} else if (strcmp (name, "res") == 0) {
+			Res* const res = talloc_realloc (lp->tmp_ctx, lp->res,
+							 Res, lp->nb_res + 1);
+			if (res == NULL)
+				return -1; // ---------->
+			lp->res = res;
+			Res* const r = res + lp->nb_res++;
+#define RES_ATTRIBUTE(NAME) \
+	talloc_strdup (lp->tmp_ctx, SaxParser_GetAttribute (atts, NAME))
+			*r = (Res) {
+				.protocol_info = RES_ATTRIBUTE ("protocolInfo"),
+				.size	       = RES_ATTRIBUTE ("size"),
+				.duration      = RES_ATTRIBUTE ("duration"),
+			};
+#undef RES_ATTRIBUTE
+			lp->text = &r->uri;
+		}
+		// Empty property, if no text
+		if (lp->text) 
+			*lp->text = talloc_strdup (lp->tmp_ctx, "");
+	}
+	return 0;
+}
+
+static int
+list_text (void* user, int depth, const char* text, size_t len)
+{
+	ListParser* const lp = (ListParser*) user;
+	if (depth == 2 && lp->text) {
+		char* const s = talloc_asprintf_append (*lp->text, "%.*s",
+							(int) len, text);
+		if (s == NULL)
+			return -1; // ---------->
+		*lp->text = s;
+	}
+	return 0;
+}
+
+static int
+list_end (void* user, int depth, const char* name, const char* tag_end)
+{
+	ListParser* const lp = (ListParser*) user;
+	if (depth == 2) {
+		lp->text = NULL;
+	} else if (depth == 1 && lp->object) {
+		PtrArray* const list = (lp->is_container ? lp->containers 
+					: lp->items);
+		DIDLObject* const o = CreateObject 
+			(list, lp, lp->object, tag_end - lp->object);
+		if (o) 
+			PtrArray_Append (list, o);
+		lp->nb_objects++;
+
+		talloc_free (lp->tmp_ctx);
+		*lp = (ListParser) { 
+			.containers = lp->containers,
+			.items      = lp->items,
+			.nb_objects = lp->nb_objects,
+		};
+	}
+	return 0;
+}
+
+int
+DIDLObject_CreateList (const char* didl, 
+		       PtrArray* containers, PtrArray* items)
+{
+	ListParser lp = { 
+		.containers = containers, 
+		.items      = items,
+	};
+	static const SaxParser_Handler handler = {
+		.start = list_start,
+		.end   = list_end,
+		.text  = list_text,
+	};
+	int const rc = SaxParser_Parse (didl, &handler, &lp);
+	talloc_free (lp.tmp_ctx);
+	return (rc == 0 ? lp.nb_objects : -1);
+}
+
+
 /******************************************************************************
  * DIDLObject_GetElementString
  *****************************************************************************/
 char*
 DIDLObject_GetElementString (const DIDLObject* o, void* result_context)
 {
-	char* s = NULL;
-	if (o) {
-		s = XMLUtil_GetNodeString (result_context, 
-					   XML_E2N (o->element));
+	if (o == NULL)
+		return NULL; // ---------->
+	if (o->xml)
+		return talloc_strdup (result_context, o->xml); // ---------->
+
+	// Rebuild the element from the fields
+	void* const tmp_ctx = talloc_new (NULL);
+	const char* const tag = (o->is_container ? "container" : "item");
+	char* s = talloc_asprintf 
+		(result_context, "<%s id=\"%s\"%s>"
+		 "<dc:title>%s</dc:title><upnp:class>%s</upnp:class>",
+		 tag, XMLUtil_Escape (tmp_ctx, o->id),
+		 (o->searchable ? " searchable=\"1\"" : ""),
+		 XMLUtil_Escape (tmp_ctx, o->title),
+		 XMLUtil_Escape (tmp_ctx, o->cds_class));
+	size_t i;
+	for (i = 0; i < o->nb_res; i++) {
+		const DIDLResource* const r = o->res + i;
+		s = talloc_asprintf_append (s, "<res");
+		if (r->protocol_info)
+			s = talloc_asprintf_append 
+				(s, " protocolInfo=\"%s\"",
+				 XMLUtil_Escape (tmp_ctx, r->protocol_info));
+		if (r->size >= 0)
+			s = talloc_asprintf_append (s, " size=\"%" PRIdMAX "\"",
+						    (intmax_t) r->size);
+		if (r->duration)
+			s = talloc_asprintf_append 
+				(s, " duration=\"%s\"",
+				 XMLUtil_Escape (tmp_ctx, r->duration));
+		s = talloc_asprintf_append (s, ">%s</res>",
+					    XMLUtil_Escape (tmp_ctx, r->uri));
 	}
+	s = talloc_asprintf_append (s, "</%s>", tag);
+	talloc_free (tmp_ctx);
 	return s;
 }
 
 
+/******************************************************************************
+ * DIDLObject_SetKeepXML
+ *****************************************************************************/
+void
+DIDLObject_SetKeepXML (bool keep)
+{
+	g_keep_xml = keep;
+}
+
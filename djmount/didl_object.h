@@ -30,7 +30,8 @@ extern "C" {
 #endif
 
 #include <stdbool.h>
-#include <upnp/ixml.h>
+#include <sys/types.h>		// Import "off_t" 
+#include "ptr_array.h"
 
 
 
@@ -41,12 +42,25 @@ extern "C" {
  * the UPnP documentation : 
  *	ContentDirectory:1 Service Template Version 1.01
  *
- *      NOTE THAT THE FUNCTION API IS NOT THREAD SAFE. Functions which 
- *	might modify the DIDLObject state (all non-const ones) in different
- *	threads should synchronise accesses through appropriate locking.
+ *	Each object is allocated in one memory block, holding the object,
+ *	its resources, and their strings : it is not modified after its
+ *	creation.
  *	
  *****************************************************************************/
 
+/*
+ * <res> property of a DIDL-Lite object
+ */
+typedef struct _DIDLResource {
+
+	const char*	uri;		// never NULL
+	const char*	protocol_info;	// NULL if none
+	off_t		size;		// -1 if unknown
+	const char*	duration;	// "H+:MM:SS[.F+]", NULL if none
+
+} DIDLResource;
+
+
 typedef struct _DIDLObject {
 
 	bool  		is_container; // else is_item
@@ -57,18 +71,22 @@ typedef struct _DIDLObject {
 	 * that those fields are never NULL, and make sure that "id" 
 	 * is never empty "".
 	 */
-	char* 		id;
+	const char*	id;
 	// TBD char* parentId;
 	const char* 	title;	
-	char* 		cds_class;
+	const char*	cds_class;
 	// TBD bool  restricted; // TBD Not Yet Implemented
 	bool 		searchable;
 
 	/*
-	 * full <item> or <container> element, to access optional properties
-	 * e.g. "res"
+	 * Optional properties
 	 */
-	IXML_Element* 	element;
+	size_t			nb_res;
+	const DIDLResource*	res;
+
+	// Source of the <item> or <container> element, NULL if not kept 
+	// (see DIDLObject_SetKeepXML)
+	const char*	xml;
 
 
 	/*
@@ -78,7 +96,7 @@ typedef struct _DIDLObject {
 
 	// Similar to "title", but suitable for filename generation : 
 	// never empty "", or reserved name (e.g. starting with "." or "_")
-	char* 	basename;
+	const char* 	basename;
 
 } DIDLObject;
 
@@ -90,26 +108,30 @@ typedef struct _DIDLObject {
 
 
 /*****************************************************************************
- * @brief Create a new DIDL-Lite object.
- *	This routine allocates a new DIDL-Lite object. It parses 
- *	the XML description and set the appropriate fields in the object.
- *	WARNING : the IXML_Element is *removed* from its parent XML document
- * 	and stored directly inside the new object ; it is *NOT* copied.
+ * @brief Create the DIDL-Lite objects of a list, e.g. the "Result" of a 
+ *	"Browse" action : the <container> and <item> children of the 
+ *	root element, in document order. The document is parsed in one 
+ *	pass (see SaxParser), without building a DOM.
+ *	Each object can be destroyed with "talloc_free".
  *
- *	When finished, the object can be destroyed with "talloc_free".
- *
- * @param talloc_context        the talloc parent context
- * @param element	 	the XML description
- * @param is_container	 	true if container, false if item
+ * @param didl		the DIDL-Lite document
+ * @param containers	list to append the containers to, also used as
+ *			their talloc parent context
+ * @param items		list to append the items to (can be the same list),
+ *			also used as their talloc parent context
+ * @return the number of <container> and <item> elements (including the
+ *	   invalid ones, not appended), or -1 if the document is not 
+ *	   well-formed (some objects may have been appended)
  *****************************************************************************/
-DIDLObject*
-DIDLObject_Create (void* talloc_context,
-		   IN IXML_Element* element,
-		   IN bool is_container);
+int
+DIDLObject_CreateList (const char* didl, 
+		       PtrArray* containers, PtrArray* items);
 	
 
 /*****************************************************************************
  * Return a string with the XML Element of the given DIDL-Lite Object.
+ * If the source of the element is not kept, the element is rebuilt from
+ * the object fields.
  *
  * @param result_context	parent context to allocate result, may be NULL
  *****************************************************************************/
@@ -117,6 +139,15 @@ char*
 DIDLObject_GetElementString (const DIDLObject* o, void* result_context);
 
 
+/*****************************************************************************
+ * @brief Keep the source of the XML element in the objects created after
+ *	this call (the default), e.g. to show the DIDL-Lite metadata.
+ *	Else only the fields are kept, which uses much less memory.
+ *****************************************************************************/
+void
+DIDLObject_SetKeepXML (bool keep);
+
+
 
 #ifdef __cplusplus
 }; // extern "C"
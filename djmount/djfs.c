@@ -26,6 +26,7 @@
 #include "djfs_p.h"
 #include "didl_object.h"
 #include "file_buffer.h"
+#include "block_cache.h"
 #include "media_file.h"
 #include "talloc_util.h"
 #include "log.h"
@@ -35,8 +36,10 @@
 #include "device.h"
 
 #include "search_help.h"
+#include "string_util.h"
 
 #include <ctype.h>
+#include "hash.h"
 
 
 /*****************************************************************************
@@ -75,6 +78,143 @@ typedef struct _SearchHistory {
 
 
 
+/*****************************************************************************
+ * File names of a list of children : computed once per (cached) list
+ * in a ChildIndex, to lookup a name without browsing the whole list.
+ *****************************************************************************/
+
+typedef struct _ChildEntry {
+
+  const DIDLObject*	o;
+  const char*		name;
+  MediaFile		file;	      // if not a container
+  off_t			res_size;
+  bool			use_playlist; // file content is the playlist
+
+} ChildEntry;
+
+typedef struct _ChildIndex {
+
+  size_t		nb_entries;
+  ChildEntry*		entries;      // in list order
+  Hash_table*		names;	      // name -> first ChildEntry
+
+} ChildIndex;
+
+
+
+/*****************************************************************************
+ * MakeChildEntry
+ *****************************************************************************/
+
+static bool
+MakeChildEntry (const DJFS* const self, void* const result_context,
+		const DIDLObject* const o, ChildEntry* const e)
+{
+  *e = (ChildEntry) { .o = o };
+  if (o->is_container) {
+    e->name = o->basename;
+  } else {
+    if (! MediaFile_GetPreferred (o, &e->file))
+      return false; // ---------->
+    e->res_size = MediaFile_GetResSize (&e->file);
+    e->use_playlist = ( e->file.playlist &&
+			( (self->flags & DJFS_USE_PLAYLISTS) ||
+			  e->res_size < 0 ||
+			  e->res_size > FILE_BUFFER_MAX_CONTENT_LENGTH) );
+    e->name = MediaFile_GetName (result_context, o, 
+				 (e->use_playlist ? e->file.playlist 
+				  : e->file.extension));
+  }
+  return (e->name != NULL);
+}
+
+
+/*****************************************************************************
+ * BuildChildIndex
+ *****************************************************************************/
+
+static size_t 
+child_hasher (const void* entry, size_t table_size)
+{
+  return String_Hash (((const ChildEntry*) entry)->name) % table_size;
+}
+
+static bool 
+child_comparator (const void* e1, const void* e2)
+{
+  return (strcmp (((const ChildEntry*) e1)->name, 
+		  ((const ChildEntry*) e2)->name) == 0);
+}
+
+static int
+DestroyChildIndex (ChildIndex* const index)
+{
+  if (index && index->names) {
+    hash_free (index->names);
+    index->names = NULL;
+  }
+  return 0; // ok -> deallocate memory
+}
+
+static void*
+BuildChildIndex (void* talloc_context, const PtrArray* objects, 
+		 const void* owner)
+{
+  const DJFS* const self = (const DJFS*) owner;
+  size_t const n = PtrArray_GetSize (objects);
+
+  ChildIndex* const index = talloc (talloc_context, ChildIndex);
+  if (index == NULL)
+    return NULL; // ---------->
+  *index = (ChildIndex) {
+    .entries = talloc_array (index, ChildEntry, n),
+    .names   = hash_initialize (n, NULL, child_hasher, child_comparator, 
+			        NULL),
+  };
+  talloc_set_destructor (index, DestroyChildIndex);
+  if (index->entries == NULL || index->names == NULL)
+    goto error; // ---------->
+
+  const DIDLObject* o;
+  PTR_ARRAY_FOR_EACH_PTR (objects, o) {
+    ChildEntry* const e = index->entries + index->nb_entries;
+    if (MakeChildEntry (self, index, o, e)) {
+      // Note: in case of duplicate names, keep the first one, 
+      // as found by a linear search
+      if (hash_insert (index->names, e) == NULL)
+	goto error; // ---------->
+      index->nb_entries++;
+    }
+  } PTR_ARRAY_FOR_EACH_PTR_END;
+  
+  return index; // ---------->
+  
+ error:
+  Log_Print (LOG_ERROR, "DJFS : can't build children index");
+  talloc_free (index);
+  return NULL;
+}
+
+
+/*****************************************************************************
+ * LookupChild
+ *	Find the entry for the first component of "path".
+ *****************************************************************************/
+
+static const ChildEntry*
+LookupChild (const ChildIndex* const index, const char* const path)
+{
+  size_t const len = strcspn (path, "/");
+  char name [len + 1];
+  memcpy (name, path, len);
+  name [len] = NUL;
+  
+  const ChildEntry searched = { .name = name };
+  return hash_lookup (index->names, &searched);
+}
+
+
 /*****************************************************************************
  * BrowseSearchDir
  *****************************************************************************/
@@ -84,7 +224,7 @@ BrowseChildren (DJFS* const self, const char* const sub_path,
 		const VFS_Query* const query, void* const tmp_ctx,
 		const char* const devName, const DIDLObject* const parent, 
 		bool const searchable, const char* const search_criteria,
-		ContentDir_Children* const children);
+		const char* const source, ContentDir_Children* const children);
 
 static VFS_BrowseStatus
 BrowseSearchDir (DJFS* const self, const char* const sub_path,
@@ -147,7 +287,7 @@ BrowseSearchDir (DJFS* const self, const char* const sub_path,
 	    BROWSE_SUB (BrowseChildren (self, BROWSE_PTR, query,
 					tmp_ctx, devName, parent,
 					true, full_criteria,
-					res->children));
+					NULL, res->children));
 	  }
 	} DIR_END;
       }
@@ -175,7 +315,7 @@ BrowseSearchDir (DJFS* const self, const char* const sub_path,
 				       new_basename, new_basename,
 				       new_basename, new_basename)
 	 : new_basename);
-      Log_Printf (LOG_DEBUG, "new search criteria '%s' (inside '%s')",
+      LOG_PRINTF (LOG_DEBUG, "new search criteria '%s' (inside '%s')",
 		  new_criteria, NN(criteria_start));
       const char* const full_criteria = (criteria_start ? talloc_asprintf 
 					 (tmp_ctx, "%s%s)", 
@@ -187,8 +327,8 @@ BrowseSearchDir (DJFS* const self, const char* const sub_path,
 				ContentDir, Search,
 				tmp_ctx, parent->id, full_criteria);
       // Do not create directory on empty result -> "No such file or directory"
-      if (res && res->children && 
-	  PtrArray_GetSize (res->children->objects) > 0) {
+      if (res && 
+	  ContentDir_Children_GetObject (res->children, 0) != NULL) {
 	SearchHistory* h = talloc (self->search_hist, SearchHistory);
 	if (h) {
 	  *h = (SearchHistory) {
@@ -211,7 +351,7 @@ BrowseSearchDir (DJFS* const self, const char* const sub_path,
 	    BROWSE_SUB (BrowseChildren (self, BROWSE_PTR, query,
 					tmp_ctx, devName, parent,
 					true, full_criteria,
-					res->children));
+					NULL, res->children));
 	  } DIR_END;
 	}
       }
@@ -227,8 +367,69 @@ BrowseSearchDir (DJFS* const self, const char* const sub_path,
 }
 
 
+/*****************************************************************************
+ * BrowseChild
+ *****************************************************************************/
+
+static VFS_BrowseStatus
+BrowseChild (DJFS* const self, const char* const sub_path,
+	     const VFS_Query* const query, void* const tmp_ctx,
+	     const char* const devName, 
+	     bool const searchable, const char* const search_criteria,
+	     const char* const source, const ChildEntry* const e)
+{
+  BROWSE_BEGIN(sub_path, query) {
+    
+    if (e->o->is_container) {
+      DIR_BEGIN (e->name) {
+	if (source)
+	  VFS_SET_CACHEABLE (source);
+	VFS_SET_CONTENTS (e->o->id);
+	const ContentDir_BrowseResult* res;
+	DEVICE_LIST_CALL_SERVICE (res, devName,
+				  CONTENT_DIR_SERVICE_TYPE,
+				  ContentDir, Browse,
+				  tmp_ctx, e->o->id,
+				  CONTENT_DIR_BROWSE_DIRECT_CHILDREN);
+	if (res && res->children) {
+	  // Note : if we are already inside a "_search" directory 
+	  // ("search_criteria" not NULL), do not allow sub-search 
+	  // (might be confusing)
+	  BROWSE_SUB (BrowseChildren 
+		      (self, BROWSE_PTR, query, tmp_ctx, 
+		       devName, e->o,
+		       searchable && (search_criteria == NULL),
+		       NULL, (source ? e->o->id : NULL), res->children));
+	}
+      } DIR_END;
+    } else if (e->use_playlist) {
+      FILE_BEGIN (e->name) {
+	const char* const str = MediaFile_GetPlaylistContent 
+	  (&e->file, tmp_ctx);
+	FILE_SET_STRING (str, FILE_BUFFER_STRING_STEAL);
+      } FILE_END;
+    } else {
+      FILE_BEGIN (e->name) {
+	if (source)
+	  VFS_SET_CACHEABLE (source);
+	FILE_SET_URL (e->file.uri, e->res_size);
+      } FILE_END;
+    }
+    
+  } BROWSE_END;  
+  
+  return BROWSE_RESULT;
+}
+
+
 /*****************************************************************************
  * BrowseChildren
+ *
+ * Description:
+ *	"source" is the identifier of the Browse results "children", or NULL
+ *	if the nodes shall not be kept in the node table (Search results,
+ *	which are flushed on any container change).
+ *
  *****************************************************************************/
 
 static VFS_BrowseStatus
@@ -236,67 +437,45 @@ BrowseChildren (DJFS* const self, const char* const sub_path,
 		const VFS_Query* const query, void* const tmp_ctx,
 		const char* const devName, const DIDLObject* const parent, 
 		bool const searchable, const char* const search_criteria,
-		ContentDir_Children* const children)
+		const char* const source, ContentDir_Children* const children)
 {
-  // Keep a pointer to acquired lock, if any
-  ithread_mutex_t* lock = NULL;
- 
   BROWSE_BEGIN(sub_path, query) {
     
     if (children) {
       DIDLObject* o = NULL;               
-#if CONTENT_DIR_HAVE_CHILDREN_MUTEX
-      ithread_mutex_lock (&children->mutex);
-      lock = &children->mutex;
-#endif
-      PTR_ARRAY_FOR_EACH_PTR (children->objects, o) {
-	if (o->is_container) {
-	  DIR_BEGIN (o->basename) {
-	    const ContentDir_BrowseResult* res;
-	    DEVICE_LIST_CALL_SERVICE (res, devName,
-				      CONTENT_DIR_SERVICE_TYPE,
-				      ContentDir, Browse,
-				      tmp_ctx, o->id,
-				      CONTENT_DIR_BROWSE_DIRECT_CHILDREN);
-	    if (res && res->children) {
-	      // Note : if we are already inside a "_search" directory 
-	      // ("search_criteria" not NULL), do not allow sub-search 
-	      // (might be confusing)
-	      BROWSE_SUB (BrowseChildren 
-			  (self, BROWSE_PTR, query, tmp_ctx, 
-			   devName, o,
-			   searchable && (search_criteria == NULL),
-			   NULL, res->children));
-	    }
-	  } DIR_END;
-	} else {
-	  MediaFile file = { .o = NULL };
-	  if (MediaFile_GetPreferred (o, &file)) {
-	    off_t const res_size = MediaFile_GetResSize (&file);
-	    if ( file.playlist &&
-		 ( (self->flags & DJFS_USE_PLAYLISTS) ||
-		   res_size < 0 ||
-		   res_size > FILE_BUFFER_MAX_CONTENT_LENGTH) ) {
-	      char* name = MediaFile_GetName (tmp_ctx, o, file.playlist);
-	      FILE_BEGIN (name) {
-		const char* const str = MediaFile_GetPlaylistContent 
-		  (&file, tmp_ctx);
-		FILE_SET_STRING (str, FILE_BUFFER_STRING_STEAL);
-	      } FILE_END;
-	    } else {
-	      char* name = MediaFile_GetName (tmp_ctx, o, file.extension);
-	      FILE_BEGIN (name) {
-		FILE_SET_URL (file.uri, res_size);
-	      } FILE_END;
-	    }
-	  }
+      const ChildIndex* const index = ContentDir_Children_GetIndex
+	(children, BuildChildIndex, self);
+      if (index && *BROWSE_PTR) {
+	// Lookup : only browse the matching child, if any
+	const ChildEntry* const e = LookupChild (index, BROWSE_PTR);
+	if (e) {
+	  BROWSE_SUB (BrowseChild (self, BROWSE_PTR, query, tmp_ctx, 
+				   devName, searchable, search_criteria, 
+				   source, e));
+	}
+      } else if (index) {
+	size_t i;
+	for (i = 0; i < index->nb_entries; i++) {
+	  BROWSE_SUB (BrowseChild (self, BROWSE_PTR, query, tmp_ctx, 
+				   devName, searchable, search_criteria,
+				   source, index->entries + i));
 	}
-      } PTR_ARRAY_FOR_EACH_PTR_END;
+      } else {
+	// List not complete yet : browse the children as they arrive
+	CONTENT_DIR_CHILDREN_FOR_EACH (children, o) {
+	  ChildEntry e;
+	  if (MakeChildEntry (self, tmp_ctx, o, &e)) {
+	    BROWSE_SUB (BrowseChild (self, BROWSE_PTR, query, tmp_ctx, 
+				     devName, searchable, search_criteria,
+				     source, &e));
+	  }
+	} CONTENT_DIR_CHILDREN_FOR_EACH_END;
+      }
 
       if ( (self->flags & DJFS_SHOW_METADATA) && 
-	   !PtrArray_IsEmpty(children->objects) ) {
+	   ContentDir_Children_GetObject (children, 0) != NULL ) {
 	DIR_BEGIN (".metadata") {
-	  PTR_ARRAY_FOR_EACH_PTR (children->objects, o) {
+	  CONTENT_DIR_CHILDREN_FOR_EACH (children, o) {
 	    char* const name = MediaFile_GetName (tmp_ctx, o, "xml");
 	    FILE_BEGIN (name) {
 	      const char* const str = talloc_asprintf
@@ -304,7 +483,7 @@ BrowseChildren (DJFS* const self, const char* const sub_path,
 		 DIDLObject_GetElementString (o, tmp_ctx));
 	      FILE_SET_STRING (str, FILE_BUFFER_STRING_STEAL);
 	    } FILE_END;
-	  } PTR_ARRAY_FOR_EACH_PTR_END;
+	  } CONTENT_DIR_CHILDREN_FOR_EACH_END;
 	} DIR_END;
       }
     } // if children
@@ -334,10 +513,6 @@ BrowseChildren (DJFS* const self, const char* const sub_path,
     } // if searchable
   } BROWSE_END;  
   
-  // Release any acquired lock
-  if (lock)
-    ithread_mutex_unlock (lock);
-  
   return BROWSE_RESULT;
 }
 
@@ -388,8 +563,9 @@ BrowseRoot (VFS* const vfs, const char* const sub_path,
 				  CONTENT_DIR_BROWSE_METADATA);
 	if (current && current->children) {
 	  const DIDLObject* const root =
-	    PtrArray_GetHead (current->children->objects);
+	    ContentDir_Children_GetObject (current->children, 0);
 	  if (root) {
+	    VFS_SET_CONTENTS (root->id);
 	    DEVICE_LIST_CALL_SERVICE (current, devName, 
 				      CONTENT_DIR_SERVICE_TYPE,
 				      ContentDir, Browse,
@@ -410,7 +586,7 @@ BrowseRoot (VFS* const vfs, const char* const sub_path,
 	    if (current && current->children) {
 	      BROWSE_SUB (BrowseChildren (self, BROWSE_PTR, query, tmp_ctx, 
 					  devName, root, searchable,
-					  NULL, current->children));
+					  NULL, root->id, current->children));
 	    }
 	  }
 	}
@@ -450,6 +626,11 @@ BrowseDebug (VFS* const vfs, const char* const sub_path,
       FILE_SET_STRING (str, FILE_BUFFER_STRING_EXTERN);
     } FILE_END;
 
+    FILE_BEGIN("block_cache") {
+      const char* const str = BlockCache_GetStatusString (tmp_ctx);
+      FILE_SET_STRING (str, FILE_BUFFER_STRING_STEAL);
+    } FILE_END;
+
     // Status of each device
     const PtrArray* const names = DeviceList_GetDevicesNames (tmp_ctx);
     const char* devName;
@@ -26,6 +26,7 @@
 #endif
 
 #include "file_buffer.h"
+#include "block_cache.h"
 #include "talloc_util.h"
 #include "log.h"
 #include "minmax.h"
@@ -36,6 +37,8 @@
 
 #include <upnp/upnp.h>
 #include <upnp/upnptools.h>
+#include <upnp/ithread.h>
+#include <upnp/ThreadPool.h>
 
 
 // Same definition as in "libupnp/upnp/src/inc/httpreadwrite.h"
@@ -44,14 +47,474 @@
 #endif
 
 
+/*
+ * Maximum forward gap (in bytes) which is skipped by reading and 
+ * discarding data from an open stream, rather than re-opening it.
+ */
+#define STREAM_SKIP_MAX		(128*1024)
+
+/*
+ * Read-ahead : once a file is read sequentially, the following bytes
+ * are prefetched in the background into a ring buffer. The window 
+ * doubles on each sequential read up to READ_AHEAD_MAX, and falls back
+ * to READ_AHEAD_MIN on a seek.
+ */
+#define READ_AHEAD_MIN		(64*1024)
+#define READ_AHEAD_MAX		(1024*1024)	// also ring buffer size
+#define READ_AHEAD_CHUNK	(32*1024)	// size of each network read
+#define READ_AHEAD_SEQUENTIAL	2		// reads before prefetching
+#define READ_AHEAD_THREADS	4		// max. number of prefetch jobs
+
+
 struct _FileBuffer {
 	bool		exact_read;
 	off_t		file_size; 
 	const char*	url;
 	const char*	content;
+
+	// Remote file only : HTTP GET stream kept open between reads,
+	// and read-ahead ring buffer. All protected by 'stream_mutex'.
+	// While 'ra_busy', the stream is owned by the prefetch job.
+	ithread_mutex_t	stream_mutex;
+	void*		stream;		// libupnp handle, or NULL if closed
+	off_t		stream_offset;	// current position in stream
+
+	char*		ra_buf;		// READ_AHEAD_MAX bytes, or NULL
+	size_t		ra_head;	// index of first byte in ring
+	size_t		ra_len;		// number of bytes available in ring
+	off_t		ra_offset;	// file offset of first byte in ring
+	size_t		ra_window;	// current read-ahead window
+	off_t		last_end;	// end offset of last read
+	int		nb_sequential;	// number of consecutive sequential reads
+	bool		ra_busy;	// prefetch job running
+	bool		ra_cancel;	// request prefetch job to stop
+	ithread_cond_t	ra_cond;	// signals prefetch progress
 };
 
 
+/******************************************************************************
+ * CloseStream
+ *****************************************************************************/
+static void
+CloseStream (FileBuffer* file)
+{
+	if (file->stream) {
+		LOG_PRINTF (LOG_DEBUG, "GetHttp close url '%s' at offset %"
+			    PRIdMAX, file->url, (intmax_t) file->stream_offset);
+		(void) UpnpCloseHttpGet (file->stream);
+		file->stream = NULL;
+	}
+}
+
+
+/******************************************************************************
+ * OpenStream
+ *
+ * Description:
+ *	Opens a new HTTP GET stream starting at 'offset'. If the file size 
+ *	is known, the stream spans until the end of file so that it can be
+ *	reused by subsequent sequential reads ; else only 'size' bytes
+ *	are requested.
+ *
+ *****************************************************************************/
+static int
+OpenStream (FileBuffer* file, off_t offset, size_t size)
+{
+	CloseStream (file);
+
+	uintmax_t const high = (file->file_size >= 0 ? file->file_size - 1
+				: offset + size - 1);
+	LOG_PRINTF (LOG_DEBUG, "GetHttp open url '%s' range %" PRIdMAX 
+		    "-%" PRIdMAX, file->url, (intmax_t) offset, 
+		    (intmax_t) high);
+
+	int contentLength = 0;
+	int httpStatus    = 0;
+	char* contentType = NULL;
+	int rc = UpnpOpenHttpGetEx (file->url, &file->stream,
+				    &contentType, &contentLength,
+				    &httpStatus, offset, high,
+				    HTTP_DEFAULT_TIMEOUT
+				    );
+	// Note: contentType points into the HTTP response held by the
+	// stream, it is released by libupnp when the stream is closed.
+	if (rc == UPNP_E_SUCCESS) {
+		file->stream_offset = offset;
+	} else {
+		file->stream = NULL;
+	}
+	return rc;
+}
+
+
+/******************************************************************************
+ * ReadStream
+ *
+ * Description:
+ *	Read from the current stream, looping until 'size' bytes are read
+ *	if exact_read (I am not sure that HTTP GET guaranty to return the 
+ *	exact number of bytes requested). Returns an UPNP error code, 
+ *	and the number of bytes read in '*n'.
+ *
+ *****************************************************************************/
+static int
+ReadStream (FileBuffer* file, char* buffer, size_t size, bool exact_read,
+	    size_t* n)
+{
+	int rc = UPNP_E_SUCCESS;
+	*n = 0;
+	do {
+		unsigned int read_size = size - *n;
+		if (*n > 0) {
+			LOG_PRINTF (LOG_DEBUG, 
+				    "UpnpReadHttpGet loop ! url '%s' "
+				    "read %" PRIdMAX " left %" PRIdMAX,
+				    file->url, (intmax_t) *n, 
+				    (intmax_t) read_size);
+		}
+		
+		rc = UpnpReadHttpGet (file->stream, buffer + *n, &read_size,
+				      HTTP_DEFAULT_TIMEOUT);
+		if (rc != UPNP_E_SUCCESS) 
+			break; // ---------->
+
+		// Prevent infinite loop (shouldn't happen though)
+		if (read_size == 0)
+			break; // ---------->
+		*n += read_size;
+		file->stream_offset += read_size;
+
+	} while (exact_read && *n < size);
+
+	return rc;
+}
+
+
+/******************************************************************************
+ * ReadDirect
+ *
+ * Description:
+ *	Read from the HTTP stream, opening it if necessary. 
+ *	The stream is reused as long as the reader is sequential, and only 
+ *	re-opened on a seek (a small forward gap is skipped in the stream).
+ *	Must be called with 'stream_mutex' locked, and no prefetch running.
+ *
+ *****************************************************************************/
+static int
+ReadDirect (FileBuffer* file, char* buffer, size_t size, off_t offset,
+	    size_t* nread)
+{
+	int rc = UPNP_E_SUCCESS;
+	if (file->stream && offset != file->stream_offset) {
+		if (offset > file->stream_offset && 
+		    offset - file->stream_offset <= STREAM_SKIP_MAX) {
+			size_t const gap = offset - file->stream_offset;
+			size_t skipped = 0;
+			while (rc == UPNP_E_SUCCESS && skipped < gap) {
+				size_t r = 0;
+				rc = ReadStream (file, buffer, 
+						 MIN (size, gap - skipped),
+						 true, &r);
+				if (r == 0)
+					break; // ---------->
+				skipped += r;
+			}
+			if (skipped < gap)
+				CloseStream (file);
+			rc = UPNP_E_SUCCESS;
+		} else {
+			CloseStream (file);
+		}
+	}
+
+	*nread = 0;
+	bool const reused = (file->stream != NULL);
+	if (file->stream == NULL) 
+		rc = OpenStream (file, offset, size);
+	if (rc == UPNP_E_SUCCESS) {
+		rc = ReadStream (file, buffer, size, file->exact_read, nread);
+		/*
+		 * The server may have closed an idle connection :
+		 * retry once on a fresh stream.
+		 */
+		if (reused && *nread == 0) {
+			rc = OpenStream (file, offset, size);
+			if (rc == UPNP_E_SUCCESS)
+				rc = ReadStream (file, buffer, size, 
+						 file->exact_read, nread);
+		}
+	}
+
+	// Only streams spanning until the end of file are reusable
+	if (rc != UPNP_E_SUCCESS || file->file_size < 0 ||
+	    file->stream_offset >= file->file_size)
+		CloseStream (file);
+
+	return rc;
+}
+
+
+/******************************************************************************
+ * Prefetch
+ *
+ * Description:
+ *	Prefetch job : fill the ring buffer from the stream, until the 
+ *	read-ahead window is full. The free part of the ring is only 
+ *	written by this job, so the network reads are done unlocked.
+ *
+ *****************************************************************************/
+static void*
+Prefetch (void* arg)
+{
+	FileBuffer* const file = arg;
+
+	ithread_mutex_lock (&file->stream_mutex);
+	while (file->stream && ! file->ra_cancel && 
+	       file->ra_len < file->ra_window) {
+		size_t const tail = (file->ra_head + file->ra_len) % 
+			READ_AHEAD_MAX;
+		size_t const size = MIN (MIN (READ_AHEAD_MAX - tail, 
+					      file->ra_window - file->ra_len),
+					 READ_AHEAD_CHUNK);
+		ithread_mutex_unlock (&file->stream_mutex);
+		
+		size_t n = 0;
+		int const rc = ReadStream (file, file->ra_buf + tail, size, 
+					   false, &n);
+
+		ithread_mutex_lock (&file->stream_mutex);
+		file->ra_len += n;
+		ithread_cond_broadcast (&file->ra_cond);
+		if (rc != UPNP_E_SUCCESS || n == 0 || 
+		    file->stream_offset >= file->file_size) {
+			if (rc != UPNP_E_SUCCESS)
+				Log_Printf (LOG_ERROR, "GetHttp url '%s' "
+					    "prefetch error %d (%s)",
+					    file->url, rc, 
+					    UpnpGetErrorMessage (rc));
+			// Next reads will go to the network directly
+			CloseStream (file);
+		}
+	}
+	file->ra_busy = false;
+	ithread_cond_broadcast (&file->ra_cond);
+	ithread_mutex_unlock (&file->stream_mutex);
+	return NULL;
+}
+
+
+/******************************************************************************
+ * StartPrefetch
+ *
+ * Description:
+ *	Schedule a prefetch job in the read-ahead thread pool.
+ *	Must be called with 'stream_mutex' locked.
+ *
+ *****************************************************************************/
+static ThreadPool	g_ra_pool;
+static bool		g_ra_pool_ok = false;
+static pthread_once_t	g_ra_pool_once = PTHREAD_ONCE_INIT;
+
+static void
+InitPrefetchPool (void)
+{
+	ThreadPoolAttr attr;
+	TPAttrInit (&attr);
+	TPAttrSetMinThreads (&attr, 0);
+	TPAttrSetMaxThreads (&attr, READ_AHEAD_THREADS);
+	TPAttrSetJobsPerThread (&attr, 1);
+	int const rc = ThreadPoolInit (&g_ra_pool, &attr);
+	if (rc != 0) 
+		Log_Printf (LOG_ERROR, "FileBuffer : can't create read-ahead "
+			    "thread pool, error %d", rc);
+	g_ra_pool_ok = (rc == 0);
+}
+
+static void
+StartPrefetch (FileBuffer* file)
+{
+	pthread_once (&g_ra_pool_once, InitPrefetchPool);
+	if (! g_ra_pool_ok)
+		return; // ---------->
+
+	if (file->ra_buf == NULL) {
+		file->ra_buf = talloc_size (file, READ_AHEAD_MAX);
+		if (file->ra_buf == NULL)
+			return; // ---------->
+		file->ra_head = 0;
+	}
+	
+	ThreadPoolJob job;
+	TPJobInit (&job, Prefetch, file);
+	TPJobSetPriority (&job, LOW_PRIORITY);
+	file->ra_busy   = true;
+	file->ra_cancel = false;
+	if (ThreadPoolAdd (&g_ra_pool, &job, NULL) != 0)
+		file->ra_busy = false;
+}
+
+
+/******************************************************************************
+ * ReadFromURL
+ *
+ * Description:
+ *	Read remote file content : served from the read-ahead ring buffer 
+ *	when possible, else directly from the HTTP stream.
+ *
+ *****************************************************************************/
+static int
+ReadFromURL (FileBuffer* file, char* buffer, size_t size, off_t offset,
+	     size_t* nread)
+{
+	int rc = UPNP_E_SUCCESS;
+	*nread = 0;
+
+	ithread_mutex_lock (&file->stream_mutex);
+
+	// Adapt read-ahead window to sequential or random access
+	if (offset == file->last_end) {
+		file->nb_sequential++;
+		if (file->nb_sequential > READ_AHEAD_SEQUENTIAL)
+			file->ra_window = MIN (file->ra_window * 2, 
+					       READ_AHEAD_MAX);
+	} else {
+		file->nb_sequential = 0;
+		file->ra_window = READ_AHEAD_MIN;
+	}
+
+	while (*nread < size) {
+		off_t const pos = offset + *nread;
+		if (pos >= file->ra_offset && 
+		    pos < file->ra_offset + file->ra_len) {
+			// Serve from ring buffer (discarding skipped data)
+			size_t const skip = pos - file->ra_offset;
+			file->ra_head = (file->ra_head + skip) % READ_AHEAD_MAX;
+			file->ra_len -= skip;
+			size_t const n = MIN (MIN (size - *nread, 
+						   file->ra_len),
+					      READ_AHEAD_MAX - file->ra_head);
+			memcpy (buffer + *nread, file->ra_buf + file->ra_head,
+				n);
+			file->ra_head = (file->ra_head + n) % READ_AHEAD_MAX;
+			file->ra_len -= n;
+			file->ra_offset = pos + n;
+			*nread += n;
+		} else if (file->ra_busy) {
+			// Wait for the data being prefetched, or stop 
+			// the prefetch on a seek
+			if (pos != file->ra_offset + file->ra_len)
+				file->ra_cancel = true;
+			ithread_cond_wait (&file->ra_cond, 
+					   &file->stream_mutex);
+		} else {
+			size_t n = 0;
+			rc = ReadDirect (file, buffer + *nread, size - *nread,
+					 pos, &n);
+			*nread += n;
+			file->ra_len    = 0;
+			file->ra_offset = pos + n;
+			break; // ---------->
+		}
+	}
+	file->last_end = offset + *nread;
+
+	if (rc == UPNP_E_SUCCESS && file->stream && ! file->ra_busy &&
+	    file->nb_sequential >= READ_AHEAD_SEQUENTIAL && 
+	    file->ra_len < file->ra_window / 2) 
+		StartPrefetch (file);
+
+	ithread_mutex_unlock (&file->stream_mutex);
+	return rc;
+}
+
+
+/******************************************************************************
+ * ReadFromCache
+ *
+ * Description:
+ *	Read remote file content by blocks, through the shared block cache.
+ *	Missing blocks are read from the network (see ReadFromURL).
+ *
+ *****************************************************************************/
+static int
+FetchBlock (void* arg, off_t offset, char* buffer, size_t size, 
+	    size_t* nread)
+{
+	return ReadFromURL ((FileBuffer*) arg, buffer, size, offset, nread);
+}
+
+static int
+ReadFromCache (FileBuffer* file, char* buffer, size_t size, off_t offset,
+	       size_t* nread)
+{
+	int rc = UPNP_E_SUCCESS;
+	char* block_buf = NULL;
+	*nread = 0;
+
+	while (*nread < size) {
+		off_t const pos = offset + *nread;
+		off_t const block = pos / BLOCK_CACHE_BLOCK_SIZE;
+		off_t const block_start = block * BLOCK_CACHE_BLOCK_SIZE;
+		size_t const block_size = MIN (BLOCK_CACHE_BLOCK_SIZE, 
+					       file->file_size - block_start);
+		
+		// Whole block requested : no need for intermediate buffer
+		bool const whole = (pos == block_start && 
+				    size - *nread >= block_size);
+		if (! whole && block_buf == NULL) {
+			block_buf = talloc_size (NULL, BLOCK_CACHE_BLOCK_SIZE);
+			if (block_buf == NULL) {
+				rc = UPNP_E_OUTOF_MEMORY;
+				break; // ---------->
+			}
+		}
+		size_t n = 0;
+		rc = BlockCache_Read (file->url, block, block_size, 
+				      (whole ? buffer + *nread : block_buf),
+				      &n, FetchBlock, file);
+		if (rc != UPNP_E_SUCCESS || n <= pos - block_start)
+			break; // ----------> error, EOF or short read
+		size_t const len = MIN (n - (pos - block_start), 
+					size - *nread);
+		if (! whole)
+			memcpy (buffer + *nread, 
+				block_buf + (pos - block_start), len);
+		*nread += len;
+	}
+
+	talloc_free (block_buf);
+	return rc;
+}
+
+
+/******************************************************************************
+ * DestroyFileBuffer
+ *
+ * Description:
+ *      FileBuffer destructor, automatically called by "talloc_free".
+ *
+ *****************************************************************************/
+static int
+DestroyFileBuffer (FileBuffer* const file)
+{
+	if (file) {
+		if (file->url) {
+			// Wait for any prefetch job to terminate
+			ithread_mutex_lock (&file->stream_mutex);
+			file->ra_cancel = true;
+			while (file->ra_busy)
+				ithread_cond_wait (&file->ra_cond, 
+						   &file->stream_mutex);
+			CloseStream (file);
+			ithread_mutex_unlock (&file->stream_mutex);
+			ithread_cond_destroy (&file->ra_cond);
+			ithread_mutex_destroy (&file->stream_mutex);
+		}
+	}
+	return 0; // ok -> deallocate memory
+}
+
+
 /******************************************************************************
  * FileBuffer_CreateFromString
  *****************************************************************************/
@@ -100,10 +563,18 @@ FileBuffer_CreateFromURL (void* talloc_context, const char* url,
 			.exact_read   = (file_size >= 0),
 			.file_size    = file_size,
 			.content      = NULL,
-			.url	      = NULL
+			.url	      = NULL,
+			.stream	      = NULL,
+			.stream_offset = 0,
+			.ra_buf	      = NULL,
+			.ra_window    = READ_AHEAD_MIN,
+			.last_end     = -1
 		};
 		if (url) {
 			file->url = talloc_strdup (file, url);
+			ithread_mutex_init (&file->stream_mutex, NULL);
+			ithread_cond_init (&file->ra_cond, NULL);
+			talloc_set_destructor (file, DestroyFileBuffer);
 		}
 	}
 	return file;
@@ -116,7 +587,7 @@ FileBuffer_CreateFromURL (void* talloc_context, const char* url,
 off_t
 FileBuffer_GetSize (const FileBuffer* file)
 {
-	return (file && file->file_size);
+	return (file ? file->file_size : -1);
 }
 
 
@@ -157,7 +628,7 @@ FileBuffer_Read (FileBuffer* file, char* buffer,
 		 * Read from URL
 		 */
 
-		Log_Printf (LOG_DEBUG, 
+		LOG_PRINTF (LOG_DEBUG, 
 			    "GetHttp url '%s' size %" PRIdMAX 
 			    " offset %" PRIdMAX " (file_size %" PRIdMAX ")",
 			    file->url, (intmax_t) size, (intmax_t) offset,
@@ -182,62 +653,22 @@ FileBuffer_Read (FileBuffer* file, char* buffer,
 		if (file->file_size >= 0) {
 			if (offset > file->file_size - size) {
 				size = MAX (0, file->file_size - offset);
-				Log_Printf (LOG_DEBUG, 
+				LOG_PRINTF (LOG_DEBUG, 
 					    "GetHttp truncate to size %" 
 					    PRIdMAX, (intmax_t) size);
 			}
 		}
 
-		// TBD
-		// TBD this is not optimised !! open / close on each read
-		// TBD
-
-		void* handle      = NULL;
-		int contentLength = 0;
-		int httpStatus    = 0;
-		char* contentType = NULL;
-		int rc = UpnpOpenHttpGetEx (file->url, &handle,
-					    &contentType, &contentLength,
-					    &httpStatus,
-					    offset, offset + size - 1,
-					    HTTP_DEFAULT_TIMEOUT
-					    );
-		if (rc != UPNP_E_SUCCESS) 
-			goto HTTP_CHECK; // ---------->
-		// TBD TBD free contentType ??? I don't know ...
-
-		/*
-		 * Read available bytes, or all bytes requested if exact_read :
-		 * perform a loop because I am not sure that HTTP GET guaranty
-		 * to return the exact number of bytes requested.
-		 */
-		do {
-			size_t read_size = size - n;
-			if (n > 0) {
-				Log_Printf (LOG_DEBUG, 
-					    "UpnpReadHttpGet loop ! url '%s' "
-					    "read %" PRIdMAX " left %" PRIdMAX,
-					    file->url, (intmax_t) n, 
-					    (intmax_t) read_size);
-			}
-			
-			rc = UpnpReadHttpGet (handle, buffer + n, &read_size,
-					      HTTP_DEFAULT_TIMEOUT);
-			if (rc != UPNP_E_SUCCESS) {
-				(void) UpnpCloseHttpGet (handle);
-				goto HTTP_CHECK; // ---------->
-			}
-
-			// Prevent infinite loop (shouldn't happen though)
-			if (read_size == 0)
-				break; // ---------->
-			n += read_size;
-
-		} while (file->exact_read && n < size);
+		if (size == 0)
+			return 0; // ---------->
 
-		rc = UpnpCloseHttpGet (handle);
+		size_t nread = 0;
+		int const rc = 
+			(BlockCache_IsEnabled() && file->file_size >= 0 ?
+			 ReadFromCache (file, buffer, size, offset, &nread) :
+			 ReadFromURL (file, buffer, size, offset, &nread));
+		n = nread;
 
-	HTTP_CHECK:
 		if (rc != UPNP_E_SUCCESS) {
 			Log_Printf (LOG_ERROR, 
 				    "GetHttp url '%s' (size %" PRIdMAX 
@@ -249,6 +680,7 @@ FileBuffer_Read (FileBuffer* file, char* buffer,
 				    rc, UpnpGetErrorMessage (rc));
 			switch (rc) {
 			case UPNP_E_OUTOF_MEMORY : 	n = -ENOMEM; break;
+			case UPNP_E_TIMEDOUT :		n = -ETIMEDOUT; break;
 			default:			n = -EIO;    break;
 			}
 		}
@@ -39,10 +39,14 @@ extern "C" {
  * @var FileBuffer
  *
  *	This opaque type encapsulates the content of a file (local or remote).
+ *	For a remote file, the HTTP stream is kept open between reads, 
+ *	and reused as long as the file is read sequentially.
  *	
- *      NOTE THAT THE FUNCTION API IS NOT THREAD SAFE. Functions which 
- *	might modify the FileBuffer state (all non-const ones) in different
- *	threads should synchronise accesses through appropriate locking.
+ *      NOTE THAT THE FUNCTION API IS NOT THREAD SAFE, except for
+ *	FileBuffer_Read which serialises accesses to the HTTP stream. 
+ *	Other functions which might modify the FileBuffer state (all 
+ *	non-const ones) in different threads should synchronise accesses 
+ *	through appropriate locking.
  *
  *****************************************************************************/
 
@@ -0,0 +1,1143 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/* $Id$
+ *
+ * FUSE low-level (inode based) interface.
+ * This file is part of djmount.
+ *
+ * (C) Copyright 2026 djmount contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#if HAVE_FUSE_LOWLEVEL
+
+// The rest of djmount is compiled against the FUSE 2.2 API (see
+// configure.ac) : the low-level API needs a more recent one.
+#undef FUSE_USE_VERSION
+#define FUSE_USE_VERSION	26
+
+#include <fuse_lowlevel.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include <upnp/ithread.h>
+#include <upnp/ThreadPool.h>
+
+#include "fuse_lowlevel_main.h"
+#include "talloc_util.h"
+#include "log.h"
+#include "string_util.h"
+#include "charset.h"
+#include "file_buffer.h"
+#include "hash.h"
+#include "minmax.h"
+#include "ptr_array.h"
+
+
+// d_ino of directory entries which have no inode yet
+#define UNKNOWN_INO	0xffffffff
+
+// Validity (in seconds) of names and attributes which do not depend
+// on cached Browse results (FUSE default)
+#define VOLATILE_TIMEOUT	1.0
+
+// Kernel cache invalidations available ?
+#if FUSE_VERSION >= 28
+#	define HAVE_FUSE_NOTIFY	1
+#endif
+
+
+static VFS*			g_vfs = NULL;
+static FuseLowLevel_Options	g_options;
+static bool			g_kernel_cache = false;
+
+
+
+/*****************************************************************************
+ * Inodes table
+ *
+ *	An inode is created by the first "lookup" of a path, and destroyed
+ *	when the kernel has forgotten all its lookups. The same path always
+ *	gets the same inode while the kernel remembers it.
+ *	Paths are stored in UTF-8, as expected by the VFS.
+ *****************************************************************************/
+
+typedef struct _Inode {
+	fuse_ino_t	ino;
+	unsigned long	nlookup;
+	char*		path;
+	char*		contents; // see VFS_Query "contents", NULL if none
+} Inode;
+
+static ithread_mutex_t	g_inodes_mutex;
+static void*		g_inodes_context = NULL;
+static Hash_table*	g_inodes_by_ino = NULL;
+static Hash_table*	g_inodes_by_path = NULL;
+static fuse_ino_t	g_next_ino = FUSE_ROOT_ID;
+
+
+static size_t
+ino_hasher (const void* entry, size_t table_size)
+{
+	return ((const Inode*) entry)->ino % table_size;
+}
+
+static bool
+ino_comparator (const void* e1, const void* e2)
+{
+	return ((const Inode*) e1)->ino == ((const Inode*) e2)->ino;
+}
+
+static size_t
+path_hasher (const void* entry, size_t table_size)
+{
+	return String_Hash (((const Inode*) entry)->path) % table_size;
+}
+
+static bool
+path_comparator (const void* e1, const void* e2)
+{
+	return strcmp (((const Inode*) e1)->path,
+		       ((const Inode*) e2)->path) == 0;
+}
+
+
+/*****************************************************************************
+ * Replace the contents identifier of an inode by "contents" (talloc'ed, 
+ * stolen by the inode). Called with "g_inodes_mutex" held.
+ *****************************************************************************/
+static void
+SetContents (Inode* inode, char* contents)
+{
+	if (inode->contents != contents) {
+		talloc_free (inode->contents);
+		inode->contents = talloc_steal (inode, contents);
+	}
+}
+
+
+/*****************************************************************************
+ * Find or create the inode of a path, and increment its lookup count.
+ * The inode takes the "contents" identifier (talloc'ed, or NULL).
+ * Returns the inode number, or 0 if error.
+ *****************************************************************************/
+static fuse_ino_t
+RefInode (const char* path, char* contents)
+{
+	fuse_ino_t ino = 0;
+
+	ithread_mutex_lock (&g_inodes_mutex);
+
+	Inode searched = { .path = (char*) path };
+	Inode* inode = hash_lookup (g_inodes_by_path, &searched);
+	if (inode == NULL) {
+		inode = talloc (g_inodes_context, Inode);
+		if (inode) {
+			*inode = (Inode) {
+				.ino     = g_next_ino++,
+				.nlookup = 0,
+				.path    = talloc_strdup (inode, path)
+			};
+			if (inode->path == NULL ||
+			    hash_insert (g_inodes_by_path, inode) == NULL) {
+				talloc_free (inode);
+				inode = NULL;
+			} else if (hash_insert (g_inodes_by_ino, inode)
+				   == NULL) {
+				hash_delete (g_inodes_by_path, inode);
+				talloc_free (inode);
+				inode = NULL;
+			}
+		}
+	}
+	if (inode) {
+		inode->nlookup++;
+		ino = inode->ino;
+		SetContents (inode, contents);
+		contents = NULL;
+	}
+
+	ithread_mutex_unlock (&g_inodes_mutex);
+
+	talloc_free (contents);
+	return ino;
+}
+
+
+/*****************************************************************************
+ * Update the contents identifier of an inode (see RefInode).
+ *****************************************************************************/
+static void
+UpdateInode (fuse_ino_t ino, char* contents)
+{
+	ithread_mutex_lock (&g_inodes_mutex);
+	Inode searched = { .ino = ino };
+	Inode* const inode = hash_lookup (g_inodes_by_ino, &searched);
+	if (inode) {
+		SetContents (inode, contents);
+		contents = NULL;
+	}
+	ithread_mutex_unlock (&g_inodes_mutex);
+	talloc_free (contents);
+}
+
+
+/*****************************************************************************
+ * Returns the inode number of a path, or UNKNOWN_INO if the path has no
+ * inode currently.
+ *****************************************************************************/
+static fuse_ino_t
+FindInode (const char* path)
+{
+	ithread_mutex_lock (&g_inodes_mutex);
+	Inode searched = { .path = (char*) path };
+	const Inode* const inode = hash_lookup (g_inodes_by_path, &searched);
+	const fuse_ino_t ino = (inode ? inode->ino : UNKNOWN_INO);
+	ithread_mutex_unlock (&g_inodes_mutex);
+	return ino;
+}
+
+
+/*****************************************************************************
+ * Decrement the lookup count of an inode, and destroy it when it reaches 0.
+ * The root inode is never destroyed.
+ *****************************************************************************/
+static void
+ForgetInode (fuse_ino_t ino, unsigned long nlookup)
+{
+	ithread_mutex_lock (&g_inodes_mutex);
+
+	Inode searched = { .ino = ino };
+	Inode* const inode = hash_lookup (g_inodes_by_ino, &searched);
+	if (inode && ino != FUSE_ROOT_ID) {
+		inode->nlookup -= MIN (nlookup, inode->nlookup);
+		if (inode->nlookup == 0) {
+			hash_delete (g_inodes_by_ino, inode);
+			hash_delete (g_inodes_by_path, inode);
+			talloc_free (inode);
+		}
+	}
+
+	ithread_mutex_unlock (&g_inodes_mutex);
+}
+
+
+/*****************************************************************************
+ * Copy the path of an inode into "buffer".
+ * Returns 0 if ok, else a negative error code.
+ *****************************************************************************/
+static int
+GetPath (fuse_ino_t ino, char* buffer, size_t size)
+{
+	int rc = 0;
+
+	ithread_mutex_lock (&g_inodes_mutex);
+
+	Inode searched = { .ino = ino };
+	const Inode* const inode = hash_lookup (g_inodes_by_ino, &searched);
+	if (inode == NULL) {
+		rc = -ESTALE;
+	} else if (strlen (inode->path) >= size) {
+		rc = -ENAMETOOLONG;
+	} else {
+		strcpy (buffer, inode->path);
+	}
+
+	ithread_mutex_unlock (&g_inodes_mutex);
+
+	return rc;
+}
+
+
+
+/*****************************************************************************
+ * Charset conversions (display <-> UTF-8) for filesystem
+ *****************************************************************************/
+
+/*
+ * Convert a string into "buffer".
+ * Returns 0 if ok, else a negative error code.
+ */
+static int
+Convert (Charset_Direction dir, const char* str, char* buffer, size_t size)
+{
+	int rc = 0;
+	char* const s = Charset_ConvertString (dir, str, buffer, size, NULL);
+	if (s == NULL) {
+		rc = -EIO;
+	} else if (s != buffer) {
+		if (strlen (s) >= size) {
+			rc = -ENAMETOOLONG;
+		} else {
+			strcpy (buffer, s);
+		}
+		if (s != str)
+			talloc_free (s);
+	}
+	return rc;
+}
+
+
+/*
+ * Build the path (UTF-8) of the entry "name" (display charset)
+ * in directory "parent".
+ */
+static int
+GetChildPath (fuse_ino_t parent, const char* name,
+	      char* buffer, size_t size)
+{
+	char utf_name [NAME_MAX + 1];
+	int rc = Convert (CHARSET_TO_UTF8, name, utf_name, sizeof (utf_name));
+	if (rc == 0)
+		rc = GetPath (parent, buffer, size);
+	if (rc == 0) {
+		size_t const len = strlen (buffer);
+		const char* const sep = (len > 0 && buffer[len-1] == '/' ?
+					 "" : "/");
+		if (snprintf (buffer + len, size - len, "%s%s",
+			      sep, utf_name) >= (int) (size - len))
+			rc = -ENAMETOOLONG;
+	}
+	return rc;
+}
+
+
+
+/*****************************************************************************
+ * Directory listings
+ *
+ *	"opendir" starts the listing in the background, then "readdir" 
+ *	returns the entries from the requested offset (the index of the 
+ *	entry in the listing) as soon as they are available : the first 
+ *	entries of a large container are returned while its next pages 
+ *	are still being received.
+ *	The listing is destroyed by the last of "releasedir" and the end
+ *	of the listing job.
+ *****************************************************************************/
+
+// Maximum number of directories listed at the same time
+#define LISTING_THREADS		8
+
+// Time (in ms) "readdir" waits for the next entries of the same Browse page
+// (which arrive in a burst), before returning the entries already listed
+#define READDIR_GATHER_TIME	10
+
+// Minimum size of an entry in the "readdir" buffer (a name and its padding)
+#define DIRENT_MIN_SIZE		32
+
+typedef struct _DirEntry {
+	char*		name;	// in display charset
+	mode_t		mode;
+	fuse_ino_t	ino;
+} DirEntry;
+
+typedef struct _DirListing {
+	ithread_mutex_t	mutex;
+	ithread_cond_t	cond;	// signals new entries, or the end
+	char*		path;
+	fuse_ino_t	ino;
+	size_t		nb_entries;
+	DirEntry*	entries;
+	bool		complete;
+	int		rc;	// listing result, if complete
+	bool		released;
+} DirListing;
+
+static ThreadPool	g_listing_pool;
+static bool		g_listing_pool_ok = false;
+
+
+static void
+DestroyListing (DirListing* dir)
+{
+	ithread_mutex_destroy (&dir->mutex);
+	ithread_cond_destroy (&dir->cond);
+	talloc_free (dir);
+}
+
+
+/*
+ * Called by VFS_Browse (in the listing job) for each entry.
+ * Note: only the listing job allocates memory below "dir".
+ */
+static int
+listing_filler (fuse_dirh_t h, const char* name, int type, ino_t ino)
+{
+	DirListing* const dir = (DirListing*) h;
+
+	DirEntry e = { .mode = DTTOIF (type), .ino = UNKNOWN_INO };
+
+	char buffer [NAME_MAX + 1];
+	int rc = Convert (CHARSET_FROM_UTF8, name, buffer, sizeof (buffer));
+	if (rc)
+		return rc; // ---------->
+	e.name = talloc_strdup (dir, buffer);
+	if (e.name == NULL)
+		return -ENOMEM; // ---------->
+
+	if (strcmp (name, ".") == 0) {
+		e.ino = dir->ino;
+	} else if (strcmp (name, "..") != 0) {
+		char* const path = talloc_asprintf
+			(dir, "%s%s%s", dir->path,
+			 (strcmp (dir->path, "/") ? "/" : ""), name);
+		if (path) {
+			e.ino = FindInode (path);
+			talloc_free (path);
+		}
+	}
+
+	ithread_mutex_lock (&dir->mutex);
+	if (dir->released) {
+		// Nobody reads the listing anymore : stop it
+		rc = -ECANCELED;
+	} else {
+		if ((dir->nb_entries & 63) == 0) {
+			DirEntry* const entries = talloc_realloc 
+				(dir, dir->entries, DirEntry, 
+				 dir->nb_entries + 64);
+			if (entries == NULL)
+				rc = -ENOMEM;
+			else 
+				dir->entries = entries;
+		}
+		if (rc == 0) {
+			dir->entries[dir->nb_entries++] = e;
+			ithread_cond_broadcast (&dir->cond);
+		}
+	}
+	ithread_mutex_unlock (&dir->mutex);
+	
+	return rc;
+}
+
+
+static void*
+ListDirectory (void* arg)
+{
+	DirListing* const dir = (DirListing*) arg;
+
+	const VFS_Query q = { .path = dir->path, .h = dir,
+			      .filler = listing_filler };
+	int const rc = VFS_Browse (g_vfs, &q);
+
+	ithread_mutex_lock (&dir->mutex);
+	dir->complete = true;
+	dir->rc = rc;
+	ithread_cond_broadcast (&dir->cond);
+	bool const released = dir->released;
+	ithread_mutex_unlock (&dir->mutex);
+
+	if (released)
+		DestroyListing (dir);
+	return NULL;
+}
+
+
+/*
+ * Start listing a directory : in the background if possible, else 
+ * the listing is complete when this function returns.
+ */
+static DirListing*
+StartListing (fuse_ino_t ino, const char* path)
+{
+	DirListing* const dir = talloc (NULL, DirListing);
+	if (dir == NULL)
+		return NULL; // ---------->
+	*dir = (DirListing) { .ino = ino, .path = talloc_strdup (dir, path) };
+	if (dir->path == NULL) {
+		talloc_free (dir);
+		return NULL; // ---------->
+	}
+	ithread_mutex_init (&dir->mutex, NULL);
+	ithread_cond_init (&dir->cond, NULL);
+
+	ThreadPoolJob job;
+	TPJobInit (&job, ListDirectory, dir);
+	if (! g_listing_pool_ok || 
+	    ThreadPoolAdd (&g_listing_pool, &job, NULL) != 0) 
+		(void) ListDirectory (dir);
+	return dir;
+}
+
+
+static void
+ReleaseListing (DirListing* dir)
+{
+	ithread_mutex_lock (&dir->mutex);
+	dir->released = true;
+	bool const complete = dir->complete;
+	ithread_mutex_unlock (&dir->mutex);
+
+	if (complete)
+		DestroyListing (dir);
+}
+
+
+
+/*****************************************************************************
+ * FUSE Operations
+ *****************************************************************************/
+
+static void
+ll_lookup (fuse_req_t req, fuse_ino_t parent, const char* name)
+{
+	char path [PATH_MAX];
+	struct fuse_entry_param e = { .ino = 0 };
+	bool cacheable = false;
+	char* contents = NULL;
+
+	int rc = GetChildPath (parent, name, path, sizeof (path));
+	if (rc == 0) {
+		const VFS_Query q = { .path = path, .stbuf = &e.attr,
+				      .cacheable = &cacheable, 
+				      .contents = &contents };
+		rc = VFS_Browse (g_vfs, &q);
+	}
+	if (rc) {
+		talloc_free (contents);
+		contents = NULL;
+	}
+	if (rc == -ENOENT && g_options.negative_timeout > 0) {
+		// Negative entry : inode 0
+		e.entry_timeout = g_options.negative_timeout;
+		fuse_reply_entry (req, &e);
+		return; // ---------->
+	}
+	if (rc == 0) {
+		e.ino = RefInode (path, contents);
+		if (e.ino == 0)
+			rc = -ENOMEM;
+	}
+	if (rc) {
+		fuse_reply_err (req, -rc);
+		return; // ---------->
+	}
+	e.attr.st_ino   = e.ino;
+	e.attr_timeout  = (cacheable ? g_options.attr_timeout : 
+			   VOLATILE_TIMEOUT);
+	e.entry_timeout = (cacheable ? g_options.entry_timeout : 
+			   VOLATILE_TIMEOUT);
+	if (fuse_reply_entry (req, &e) != 0) {
+		// The kernel did not get the entry : cancel this lookup
+		ForgetInode (e.ino, 1);
+	}
+}
+
+
+static void
+ll_forget (fuse_req_t req, fuse_ino_t ino, unsigned long nlookup)
+{
+	ForgetInode (ino, nlookup);
+	fuse_reply_none (req);
+}
+
+
+static void
+ll_getattr (fuse_req_t req, fuse_ino_t ino, struct fuse_file_info* fi)
+{
+	char path [PATH_MAX];
+	struct stat st = { .st_mode = 0 };
+	bool cacheable = false;
+	char* contents = NULL;
+
+	int rc = GetPath (ino, path, sizeof (path));
+	if (rc == 0) {
+		const VFS_Query q = { .path = path, .stbuf = &st,
+				      .cacheable = &cacheable,
+				      .contents = &contents };
+		rc = VFS_Browse (g_vfs, &q);
+	}
+	if (rc) {
+		talloc_free (contents);
+		fuse_reply_err (req, -rc);
+	} else {
+		UpdateInode (ino, contents);
+		st.st_ino = ino;
+		fuse_reply_attr (req, &st, (cacheable ? g_options.attr_timeout
+					    : VOLATILE_TIMEOUT));
+	}
+}
+
+
+static void
+ll_readlink (fuse_req_t req, fuse_ino_t ino)
+{
+	char path [PATH_MAX];
+	char link [PATH_MAX];
+
+	int rc = GetPath (ino, path, sizeof (path));
+	if (rc == 0) {
+		const VFS_Query q = { .path = path,
+				      .lnk_buf = link,
+				      .lnk_bufsiz = sizeof (link) };
+		rc = VFS_Browse (g_vfs, &q);
+	}
+	if (rc == 0) {
+		// Convert symlink content to display charset
+		rc = Convert (CHARSET_FROM_UTF8, link, path, sizeof (path));
+	}
+	if (rc) {
+		fuse_reply_err (req, -rc);
+	} else {
+		fuse_reply_readlink (req, path);
+	}
+}
+
+
+static void
+ll_opendir (fuse_req_t req, fuse_ino_t ino, struct fuse_file_info* fi)
+{
+	char path [PATH_MAX];
+
+	int rc = GetPath (ino, path, sizeof (path));
+	DirListing* dir = NULL;
+	if (rc == 0) {
+		dir = StartListing (ino, path);
+		if (dir == NULL)
+			rc = -ENOMEM;
+	}
+	if (rc) {
+		fuse_reply_err (req, -rc);
+	} else {
+		fi->fh = (intptr_t) dir;
+		if (fuse_reply_open (req, fi) != 0)
+			ReleaseListing (dir);
+	}
+}
+
+
+static void
+ll_readdir (fuse_req_t req, fuse_ino_t ino, size_t size, off_t off,
+	    struct fuse_file_info* fi)
+{
+	DirListing* const dir = (DirListing*) fi->fh;
+	size_t const first = (off > 0 ? off : 0);
+
+	char* const buf = talloc_size (NULL, size);
+	if (buf == NULL) {
+		fuse_reply_err (req, ENOMEM);
+		return; // ---------->
+	}
+
+	ithread_mutex_lock (&dir->mutex);
+	
+	// Wait for at least one entry, or the end of the listing
+	while (dir->nb_entries <= first && ! dir->complete)
+		ithread_cond_wait (&dir->cond, &dir->mutex);
+
+	// Then gather the following entries, until the buffer is full
+	struct timespec deadline;
+	clock_gettime (CLOCK_REALTIME, &deadline);
+	deadline.tv_nsec += READDIR_GATHER_TIME * 1000000L;
+	if (deadline.tv_nsec >= 1000000000L) {
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000L;
+	}
+	while (! dir->complete && 
+	       dir->nb_entries - first < size / DIRENT_MIN_SIZE &&
+	       ithread_cond_timedwait (&dir->cond, &dir->mutex, 
+				       &deadline) != ETIMEDOUT)
+		;
+
+	size_t len = 0;
+	size_t i;
+	for (i = first; i < dir->nb_entries; i++) {
+		const DirEntry* const e = dir->entries + i;
+		const struct stat st = { .st_ino = e->ino, .st_mode = e->mode };
+		// The offset of an entry is the offset of the next one
+		size_t const n = fuse_add_direntry (req, buf + len, size - len,
+						    e->name, &st, i + 1);
+		if (n > size - len)
+			break; // ---------->
+		len += n;
+	}
+	// Report an error once all the entries read before are returned
+	int const rc = (len == 0 && dir->complete ? dir->rc : 0);
+
+	ithread_mutex_unlock (&dir->mutex);
+
+	if (rc)
+		fuse_reply_err (req, -rc);
+	else 
+		fuse_reply_buf (req, buf, len);
+	talloc_free (buf);
+}
+
+
+static void
+ll_releasedir (fuse_req_t req, fuse_ino_t ino, struct fuse_file_info* fi)
+{
+	DirListing* const dir = (DirListing*) fi->fh;
+	ReleaseListing (dir);
+	fi->fh = (intptr_t) NULL;
+	fuse_reply_err (req, 0);
+}
+
+
+static void
+ll_open (fuse_req_t req, fuse_ino_t ino, struct fuse_file_info* fi)
+{
+	if ((fi->flags & O_ACCMODE) != O_RDONLY) {
+		fuse_reply_err (req, EACCES);
+		return; // ---------->
+	}
+
+	char path [PATH_MAX];
+	FileBuffer* file = NULL;
+
+	int rc = GetPath (ino, path, sizeof (path));
+	if (rc == 0) {
+		const VFS_Query q = { .path = path, .talloc_context = NULL,
+				      .file = &file };
+		rc = VFS_Browse (g_vfs, &q);
+	}
+	if (rc) {
+		talloc_free (file);
+		fuse_reply_err (req, -rc);
+		return; // ---------->
+	}
+	fi->fh = (intptr_t) file;
+	// See comment on "direct_io" in fuse_main.c : fs_open()
+	fi->direct_io = ( FileBuffer_GetSize (file) < 0 ||
+			  ! FileBuffer_HasExactRead (file) );
+	fi->keep_cache = g_kernel_cache;
+	if (fuse_reply_open (req, fi) != 0)
+		talloc_free (file);
+}
+
+
+static void
+ll_read (fuse_req_t req, fuse_ino_t ino, size_t size, off_t off,
+	 struct fuse_file_info* fi)
+{
+	FileBuffer* const file = (FileBuffer*) fi->fh;
+
+	char* const buf = talloc_size (NULL, size);
+	if (buf == NULL) {
+		fuse_reply_err (req, ENOMEM);
+		return; // ---------->
+	}
+	ssize_t const n = FileBuffer_Read (file, buf, size, off);
+	if (n < 0) {
+		fuse_reply_err (req, -n);
+	} else {
+		fuse_reply_buf (req, buf, n);
+	}
+	talloc_free (buf);
+}
+
+
+static void
+ll_release (fuse_req_t req, fuse_ino_t ino, struct fuse_file_info* fi)
+{
+	FileBuffer* const file = (FileBuffer*) fi->fh;
+	talloc_free (file);
+	fi->fh = (intptr_t) NULL;
+	fuse_reply_err (req, 0);
+}
+
+
+/*
+ * Unset operations are answered by the FUSE library : read-only
+ * operations with a default result, the others with ENOSYS
+ * (the file system is mounted read-only anyway).
+ */
+static const struct fuse_lowlevel_ops ll_oper = {
+	.lookup		= ll_lookup,
+	.forget		= ll_forget,
+	.getattr	= ll_getattr,
+	.readlink	= ll_readlink,
+	.opendir	= ll_opendir,
+	.readdir	= ll_readdir,
+	.releasedir	= ll_releasedir,
+	.open		= ll_open,
+	.read		= ll_read,
+	.release	= ll_release,
+};
+
+
+
+/*****************************************************************************
+ * Options handled by the high-level FUSE library only
+ *****************************************************************************/
+
+enum {
+	KEY_KERNEL_CACHE,
+};
+
+static const struct fuse_opt ll_opts[] = {
+	FUSE_OPT_KEY ("kernel_cache", KEY_KERNEL_CACHE),
+	// inode numbers are always provided
+	FUSE_OPT_KEY ("readdir_ino", FUSE_OPT_KEY_DISCARD),
+	FUSE_OPT_END
+};
+
+static int
+ll_opt_proc (void* data, const char* arg, int key,
+	     struct fuse_args* outargs)
+{
+	if (key == KEY_KERNEL_CACHE) {
+		g_kernel_cache = true;
+		return 0; // ---------->
+	}
+	return 1; // keep
+}
+
+
+
+/*****************************************************************************
+ * Kernel cache invalidations
+ *
+ *	The kernel must not be notified from a thread which may hold a
+ *	lock needed by a FUSE operation (e.g. the device list lock) :
+ *	the notification waits for the operations in progress on the 
+ *	same directory. The invalidated paths are queued, and sent by
+ *	a dedicated thread.
+ *****************************************************************************/
+
+#if HAVE_FUSE_NOTIFY
+
+typedef struct _Invalidation {
+	struct _Invalidation*	next;
+	char*			path;
+	char*			contents; // NULL to invalidate "path" itself
+} Invalidation;
+
+static ithread_mutex_t	g_notify_mutex = PTHREAD_MUTEX_INITIALIZER;
+static ithread_cond_t	g_notify_cond = PTHREAD_COND_INITIALIZER;
+static bool		g_notify_running = false;
+static Invalidation*	g_pending = NULL;
+static ithread_t	g_notify_thread;
+static struct fuse_chan* g_chan = NULL;
+
+
+static void
+SendInvalidation (const char* path)
+{
+	const char* const base = strrchr (path, '/');
+	if (base == NULL)
+		return; // ---------->
+
+	char parent [PATH_MAX];
+	size_t const len = MAX (base - path, 1);
+	if (len >= sizeof (parent))
+		return; // ---------->
+	strncpy (parent, path, len);
+	parent[len] = NUL;
+
+	fuse_ino_t const ino = FindInode (path);
+	if (ino != UNKNOWN_INO)
+		fuse_lowlevel_notify_inval_inode (g_chan, ino, 0, 0);
+
+	fuse_ino_t const parent_ino = FindInode (parent);
+	char name [NAME_MAX + 1];
+	if (base[1] && parent_ino != UNKNOWN_INO &&
+	    Convert (CHARSET_FROM_UTF8, base + 1, name, sizeof (name)) == 0) {
+		// Also drops the entries below this one
+		fuse_lowlevel_notify_inval_entry (g_chan, parent_ino, 
+						  name, strlen (name));
+		// Listing and link count of the parent
+		fuse_lowlevel_notify_inval_inode (g_chan, parent_ino, 0, 0);
+	}
+}
+
+
+// Paths of the inodes at or below a path, with given contents
+typedef struct _ContentsMatch {
+	const char*	path;
+	size_t		path_len;
+	const char*	contents;
+	PtrArray*	paths;
+} ContentsMatch;
+
+static bool
+match_contents (void* entry, void* data)
+{
+	const Inode* const inode = (const Inode*) entry;
+	ContentsMatch* const m = (ContentsMatch*) data;
+	if (inode->contents && strcmp (inode->contents, m->contents) == 0 &&
+	    strncmp (inode->path, m->path, m->path_len) == 0 &&
+	    (inode->path [m->path_len] == NUL || 
+	     inode->path [m->path_len] == '/'))
+		PtrArray_Append (m->paths, talloc_strdup (m->paths, 
+							  inode->path));
+	return true; // continue
+}
+
+static void
+SendContentsInvalidation (const char* path, const char* contents)
+{
+	ContentsMatch m = { 
+		.path	  = path,
+		.path_len = strlen (path),
+		.contents = contents,
+		.paths    = PtrArray_Create (NULL),
+	};
+	if (m.paths == NULL)
+		return; // ---------->
+
+	ithread_mutex_lock (&g_inodes_mutex);
+	hash_do_for_each (g_inodes_by_ino, match_contents, &m);
+	ithread_mutex_unlock (&g_inodes_mutex);
+
+	const char* p;
+	PTR_ARRAY_FOR_EACH_PTR (m.paths, p) {
+		if (p)
+			SendInvalidation (p);
+	} PTR_ARRAY_FOR_EACH_PTR_END;
+	talloc_free (m.paths);
+}
+
+
+static void*
+NotifyThread (void* arg)
+{
+	ithread_mutex_lock (&g_notify_mutex);
+	while (g_notify_running) {
+		Invalidation* const inv = g_pending;
+		if (inv == NULL) {
+			ithread_cond_wait (&g_notify_cond, &g_notify_mutex);
+		} else {
+			g_pending = inv->next;
+			ithread_mutex_unlock (&g_notify_mutex);
+			LOG_PRINTF (LOG_DEBUG, "FUSE invalidate '%s' %s%s", 
+				    inv->path, (inv->contents ? 
+						"contents=" : ""),
+				    NN(inv->contents));
+			if (inv->contents)
+				SendContentsInvalidation (inv->path, 
+							  inv->contents);
+			else
+				SendInvalidation (inv->path);
+			free (inv);
+			ithread_mutex_lock (&g_notify_mutex);
+		}
+	}
+	ithread_mutex_unlock (&g_notify_mutex);
+	return NULL;
+}
+
+
+static void
+StartNotifications (struct fuse_chan* ch)
+{
+	ithread_mutex_lock (&g_notify_mutex);
+	g_chan = ch;
+	g_notify_running = true;
+	if (ithread_create (&g_notify_thread, NULL, NotifyThread, NULL)) {
+		Log_Printf (LOG_ERROR, "Can't create FUSE notification thread");
+		g_notify_running = false;
+	}
+	ithread_mutex_unlock (&g_notify_mutex);
+}
+
+
+static void
+StopNotifications ()
+{
+	ithread_mutex_lock (&g_notify_mutex);
+	bool const running = g_notify_running;
+	g_notify_running = false;
+	ithread_cond_broadcast (&g_notify_cond);
+	ithread_mutex_unlock (&g_notify_mutex);
+
+	if (running)
+		ithread_join (g_notify_thread, NULL);
+	
+	while (g_pending) {
+		Invalidation* const inv = g_pending;
+		g_pending = inv->next;
+		free (inv);
+	}
+	g_chan = NULL;
+}
+
+#endif // HAVE_FUSE_NOTIFY
+
+
+/*****************************************************************************
+ * FuseLowLevel_Invalidate
+ * FuseLowLevel_InvalidateContents
+ *****************************************************************************/
+static void
+QueueInvalidation (const char* path, const char* contents)
+{
+#if HAVE_FUSE_NOTIFY
+	if (path == NULL)
+		return; // ---------->
+
+	ithread_mutex_lock (&g_notify_mutex);
+	if (g_notify_running) {
+		// Same invalidation already pending ?
+		Invalidation** last = &g_pending;
+		while (*last && ! (strcmp ((*last)->path, path) == 0 &&
+				   ((*last)->contents == NULL ? 
+				    contents == NULL : 
+				    (contents && strcmp ((*last)->contents,
+							 contents) == 0))))
+			last = &(*last)->next;
+		if (*last == NULL) {
+			// Note: malloc'ed, because the caller may hold any
+			// lock (talloc contexts are not thread safe).
+			size_t const len = strlen (path) + 1;
+			size_t const clen = (contents ? strlen (contents) + 1
+					     : 0);
+			Invalidation* const inv = 
+				malloc (sizeof (Invalidation) + len + clen);
+			if (inv) {
+				inv->next = NULL;
+				inv->path = (char*) (inv + 1);
+				memcpy (inv->path, path, len);
+				inv->contents = (contents ? inv->path + len
+						 : NULL);
+				if (contents)
+					memcpy (inv->contents, contents, clen);
+				*last = inv;
+				ithread_cond_signal (&g_notify_cond);
+			}
+		}
+	}
+	ithread_mutex_unlock (&g_notify_mutex);
+#endif
+}
+
+void
+FuseLowLevel_Invalidate (const char* path)
+{
+	QueueInvalidation (path, NULL);
+}
+
+void
+FuseLowLevel_InvalidateContents (const char* path, const char* contents)
+{
+	if (contents)
+		QueueInvalidation (path, contents);
+}
+
+
+
+/*****************************************************************************
+ * FuseLowLevel_Main
+ *****************************************************************************/
+
+int
+FuseLowLevel_Main (int argc, char* argv[], VFS* vfs,
+		   const FuseLowLevel_Options* options)
+{
+	struct fuse_args args = FUSE_ARGS_INIT (argc, argv);
+	char* mountpoint = NULL;
+	int rc = -1;
+
+	g_vfs = vfs;
+	g_options = *options;
+
+	/*
+	 * Create inodes table, with the root inode
+	 */
+	ithread_mutex_init (&g_inodes_mutex, NULL);
+	g_inodes_context = talloc_new (NULL);
+	g_inodes_by_ino  = hash_initialize (1024, NULL, ino_hasher,
+					    ino_comparator, NULL);
+	g_inodes_by_path = hash_initialize (1024, NULL, path_hasher,
+					    path_comparator, NULL);
+	if (g_inodes_context == NULL || g_inodes_by_ino == NULL ||
+	    g_inodes_by_path == NULL || RefInode ("/", NULL) != FUSE_ROOT_ID) {
+		Log_Printf (LOG_ERROR, "Failed to create inodes table");
+		goto cleanup; // ---------->
+	}
+
+	/*
+	 * Create thread pool for directory listings
+	 */
+	ThreadPoolAttr attr;
+	TPAttrInit (&attr);
+	TPAttrSetMinThreads (&attr, 0);
+	TPAttrSetMaxThreads (&attr, LISTING_THREADS);
+	// Jobs wait for the network : start a thread for each job, 
+	// up to the maximum.
+	TPAttrSetJobsPerThread (&attr, 0);
+	g_listing_pool_ok = (ThreadPoolInit (&g_listing_pool, &attr) == 0);
+	if (! g_listing_pool_ok) 
+		Log_Printf (LOG_ERROR, "Can't create listing thread pool : "
+			    "directories will be listed on opendir");
+
+	/*
+	 * Mount, and run session
+	 */
+	if (fuse_opt_parse (&args, NULL, ll_opts, ll_opt_proc) == -1 ||
+	    fuse_parse_cmdline (&args, &mountpoint, NULL, NULL) == -1)
+		goto cleanup; // ---------->
+
+	struct fuse_chan* const ch = fuse_mount (mountpoint, &args);
+	if (ch == NULL)
+		goto cleanup; // ---------->
+
+	struct fuse_session* const se = fuse_lowlevel_new
+		(&args, &ll_oper, sizeof (ll_oper), NULL);
+	if (se) {
+		if (fuse_set_signal_handlers (se) == 0) {
+			fuse_session_add_chan (se, ch);
+			LOG_PRINTF (LOG_DEBUG, "FUSE low-level session on '%s'"
+				    " : entry_timeout=%g attr_timeout=%g "
+				    "negative_timeout=%g",
+				    mountpoint, g_options.entry_timeout,
+				    g_options.attr_timeout,
+				    g_options.negative_timeout);
+#if HAVE_FUSE_NOTIFY
+			StartNotifications (ch);
+#endif
+			rc = fuse_session_loop_mt (se);
+#if HAVE_FUSE_NOTIFY
+			StopNotifications ();
+#endif
+			fuse_remove_signal_handlers (se);
+			fuse_session_remove_chan (ch);
+		}
+		fuse_session_destroy (se);
+	}
+	fuse_unmount (mountpoint, ch);
+
+cleanup:
+	if (g_listing_pool_ok) {
+		ThreadPoolShutdown (&g_listing_pool);
+		g_listing_pool_ok = false;
+	}
+	free (mountpoint);
+	fuse_opt_free_args (&args);
+	if (g_inodes_by_path)
+		hash_free (g_inodes_by_path);
+	if (g_inodes_by_ino)
+		hash_free (g_inodes_by_ino);
+	g_inodes_by_path = g_inodes_by_ino = NULL;
+	talloc_free (g_inodes_context);
+	g_inodes_context = NULL;
+	ithread_mutex_destroy (&g_inodes_mutex);
+
+	return rc;
+}
+
+
+#endif // HAVE_FUSE_LOWLEVEL
@@ -0,0 +1,121 @@
+/* $Id$
+ *
+ * FUSE low-level (inode based) interface.
+ * This file is part of djmount.
+ *
+ * (C) Copyright 2026 djmount contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef FUSE_LOWLEVEL_MAIN_H_INCLUDED
+#define FUSE_LOWLEVEL_MAIN_H_INCLUDED
+
+#include "vfs.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/******************************************************************************
+ * Low-level front end
+ *
+ *	Alternative to the path based "fuse_operations" : the kernel
+ *	addresses files by inode numbers, which are allocated on "lookup"
+ *	and released on "forget". Each inode remembers its path in the
+ *	virtual file system, so that an operation does not need the FUSE
+ *	library to rebuild the path from the directory tree.
+ *
+ *	Entries and attributes are returned with the configured timeouts,
+ *	during which the kernel answers "stat" and path lookups by itself.
+ *	These timeouts only apply to files and directories which depend 
+ *	on cached Browse results (see VFS_Query "cacheable") : the others
+ *	(e.g. debug files) are revalidated after VOLATILE_TIMEOUT.
+ *	The kernel caches can also be dropped before their timeout, 
+ *	using FuseLowLevel_Invalidate.
+ *
+ *	Only available if compiled against FUSE >= 2.7
+ *	(see HAVE_FUSE_LOWLEVEL).
+ *
+ *****************************************************************************/
+
+
+/******************************************************************************
+ * @var FuseLowLevel_Options
+ *	Settings of the low-level front end.
+ *****************************************************************************/
+
+typedef struct _FuseLowLevel_Options {
+
+	// Validity (in seconds) of names and attributes cached by the kernel
+	double	entry_timeout;
+	double	attr_timeout;
+
+	// Validity (in seconds) of non-existent names, 0 if not cached
+	double	negative_timeout;
+
+} FuseLowLevel_Options;
+
+
+/*****************************************************************************
+ * @brief Mount the file system, and run the FUSE session (multi-threaded)
+ *	until the file system is unmounted or the program is interrupted.
+ *
+ * @param argc, argv	FUSE arguments, as for "fuse_main"
+ * @param vfs		the virtual file system to mount
+ * @param options	settings of the front end
+ * @return 0 if ok, non 0 if error
+ *****************************************************************************/
+int
+FuseLowLevel_Main (int argc, char* argv[], VFS* vfs,
+		   const FuseLowLevel_Options* options);
+
+
+/*****************************************************************************
+ * @brief Drop what the kernel has cached about a path : its name (or its
+ *	non-existence) in the parent directory, and its attributes.
+ *	The kernel is notified asynchronously, so this function can be 
+ *	called from any thread, with any lock held. It does nothing if 
+ *	the low-level session is not running, or if the FUSE library 
+ *	cannot notify the kernel (FUSE < 2.8).
+ *
+ * @param path		the path in the virtual file system (UTF-8)
+ *****************************************************************************/
+void
+FuseLowLevel_Invalidate (const char* path);
+
+
+/*****************************************************************************
+ * @brief Drop what the kernel has cached about the directories, at or 
+ *	below "path", which list the Browse results "contents" (see 
+ *	VFS_Query "contents") : as FuseLowLevel_Invalidate on each of 
+ *	these directories. 
+ *	The directories are those currently known by the kernel.
+ *
+ * @param path		the path in the virtual file system (UTF-8)
+ * @param contents	the identifier of the Browse results
+ *****************************************************************************/
+void
+FuseLowLevel_InvalidateContents (const char* path, const char* contents);
+
+
+#ifdef __cplusplus
+}; // extern "C"
+#endif
+
+
+#endif // FUSE_LOWLEVEL_MAIN_H_INCLUDED
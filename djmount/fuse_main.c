@@ -48,8 +48,11 @@
 #include "string_util.h"
 #include "djfs.h"
 #include "content_dir.h"
+#include "didl_object.h"
 #include "charset.h"
+#include "block_cache.h"
 #include "minmax.h"
+#include "fuse_lowlevel_main.h"
 
 
 
@@ -77,6 +80,13 @@
 #	define HAVE_FUSE_FILE_INFO_DIRECT_IO	1
 #endif
 
+// "-o entry_timeout=T", "-o attr_timeout=T" and "-o negative_timeout=T"
+// options available ?
+// (also true if the low-level interface is available : FUSE >= 2.7)
+#if FUSE_VERSION >= 25
+#	define HAVE_FUSE_O_TIMEOUTS	1
+#endif
+
 
 
 /*****************************************************************************
@@ -93,6 +103,19 @@ static const DJFS_Flags DEFAULT_DJFS_FLAGS =
 // set to 0 to disable "search" sub-directories
 static const size_t DEFAULT_SEARCH_HISTORY_SIZE = 100;
 
+// maximum size (in MB) of files content cached in memory, and in "cache_dir".
+// No memory cache by default : it reads whole blocks from the servers, 
+// which only pays off when the same parts of the files are read again.
+static const int DEFAULT_BLOCK_CACHE_MEMORY = 0;
+static const int DEFAULT_BLOCK_CACHE_SIZE = 1024;
+
+// validity (in seconds) of names and attributes cached by the kernel, 
+// with the low-level interface : same as the Browse results they are 
+// made of. The path based interface keeps the FUSE defaults, because it
+// can not tell these results from the others (e.g. debug files), and
+// can not notify the kernel when a device changes.
+static const double DEFAULT_LOWLEVEL_TIMEOUT = CONTENT_DIR_CACHE_TIMEOUT;
+
 
 static VFS* g_djfs = NULL;
 
@@ -467,6 +490,40 @@ static struct fuse_operations fs_oper = {
 };
 
 
+/*****************************************************************************
+ * @fn 		device_event
+ * @brief 	Device list changes.
+ *
+ *	Drop the nodes resolved from the Browse results of the changed
+ *	object, which the ContentDir has just invalidated, and what the 
+ *	kernel has cached about the directories listing it ; or all of 
+ *	them under the device directory if any object may have changed 
+ *	(see "djfs.c" : the path of a device is "/<deviceName>").
+ *	Only the low-level interface can notify the kernel.
+ *
+ * Parameters:
+ * 	See DeviceList_EventCallback prototype.
+ *
+ *****************************************************************************/
+
+static void
+device_event (DeviceList_EventType type, const char* deviceName,
+	      const char* objectId)
+{
+	char path [PATH_MAX];
+	if (snprintf (path, sizeof (path), "/%s", deviceName) 
+	    < (int) sizeof (path)) {
+		VFS_InvalidateContents (g_djfs, path, objectId);
+#if HAVE_FUSE_LOWLEVEL
+		if (objectId)
+			FuseLowLevel_InvalidateContents (path, objectId);
+		else
+			FuseLowLevel_Invalidate (path);
+#endif
+	}
+}
+
+
 /*****************************************************************************
  * @fn 		stdout_print 
  * @brief 	Output log messages.
@@ -537,10 +594,36 @@ usage (FILE* stream, const char* progname)
      "    iocharset=<charset>    filenames encoding (default: environment)\n"
 #endif
      "    playlists              use playlists for AV files, instead of plain files\n"
+     "    cache_mem=<size>       memory cache for files content in MB (default: %d)\n"
+     "                           (0 : no memory cache)\n"
+     "    cache_dir=<dir>        cache files content also in this directory\n"
+     "    cache_size=<size>      maximum size of cache_dir in MB (default: %d)\n"
+     "    connect_timeout=<secs> timeout to connect to a server (default: %d)\n"
+     "                           (set to 0 to use the system timeout)\n"
      "    search_history=<size>  number of remembered searches (default: %d)\n"
      "                           (set to 0 to disable search)\n"
+     "    browse_stale=<secs>    show expired directory listings while they are\n"
+     "                           refreshed, up to this time (default: 0)\n"
+     "    browse_snapshot=<dir>  save directory listings in this directory, as\n"
+     "                           they complete, to list them at once after remount\n"
+     "                           if unchanged\n"
+#if HAVE_FUSE_O_TIMEOUTS
+     "    entry_timeout=<secs>   cache timeout for names\n"
+     "    attr_timeout=<secs>    cache timeout for attributes\n"
+     "    negative_timeout=<secs> cache timeout for non-existent names\n"
+     "                           (default: %g with lowlevel, else FUSE default)\n"
+#endif
+#if HAVE_FUSE_LOWLEVEL
+     "    lowlevel               use the inode based FUSE interface\n"
+#endif
      "    sloppy                 ignore unknown options (e.g., for /etc/fstab)\n"
-     "\n", DEFAULT_SEARCH_HISTORY_SIZE);
+     "\n", DEFAULT_BLOCK_CACHE_MEMORY, DEFAULT_BLOCK_CACHE_SIZE, 
+     DEFAULT_CONNECT_TIMEOUT,
+     DEFAULT_SEARCH_HISTORY_SIZE
+#if HAVE_FUSE_O_TIMEOUTS
+     , DEFAULT_LOWLEVEL_TIMEOUT
+#endif
+     );
   fprintf 
     (stream,
      "See FUSE documentation for the following mount options:\n%s",
@@ -627,6 +710,17 @@ main (int argc, char *argv[])
 	char* charset = NULL;
 	DJFS_Flags djfs_flags = DEFAULT_DJFS_FLAGS;
 	size_t search_history_size = DEFAULT_SEARCH_HISTORY_SIZE;
+	int cache_mem = DEFAULT_BLOCK_CACHE_MEMORY;
+	char* cache_dir = NULL;
+	int cache_size = DEFAULT_BLOCK_CACHE_SIZE;
+	int connect_timeout = DEFAULT_CONNECT_TIMEOUT;
+	int browse_stale = 0;
+	char* browse_snapshot = NULL;
+	// Timeouts < 0 : not set
+	double entry_timeout = -1;
+	double attr_timeout = -1;
+	double negative_timeout = -1;
+	bool lowlevel = false;
 
 	char* fuse_argv[32] = { argv[0] };
 	int fuse_argc = 1;
@@ -681,6 +775,37 @@ main (int argc, char *argv[])
 				} else if (strncmp(s, "search_history=", 15)
 					   == 0) {
 					search_history_size = atoi (s+15);
+				} else if (strncmp(s, "cache_mem=", 10) == 0) {
+					cache_mem = atoi (s+10);
+				} else if (strncmp(s, "cache_dir=", 10) == 0) {
+					cache_dir = talloc_strdup(tmp_ctx, s+10);
+				} else if (strncmp(s, "cache_size=", 11) == 0) {
+					cache_size = atoi (s+11);
+				} else if (strncmp(s, "connect_timeout=", 16)
+					   == 0) {
+					connect_timeout = atoi (s+16);
+				} else if (strncmp(s, "browse_stale=", 13)
+					   == 0) {
+					browse_stale = atoi (s+13);
+				} else if (strncmp(s, "browse_snapshot=", 16)
+					   == 0) {
+					browse_snapshot = talloc_strdup 
+						(tmp_ctx, s+16);
+#if HAVE_FUSE_O_TIMEOUTS
+				} else if (strncmp(s, "entry_timeout=", 14)
+					   == 0) {
+					entry_timeout = atof (s+14);
+				} else if (strncmp(s, "attr_timeout=", 13)
+					   == 0) {
+					attr_timeout = atof (s+13);
+				} else if (strncmp(s, "negative_timeout=", 17)
+					   == 0) {
+					negative_timeout = atof (s+17);
+#endif
+#if HAVE_FUSE_LOWLEVEL
+				} else if (strcmp(s, "lowlevel") == 0) {
+					lowlevel = true;
+#endif
 				//check for '-s|-o sloppy' -- ignore unknown options
 				} else if (strncmp(s, "sloppy", 15) == 0 ||
 						(strlen(s) == 1 && strncmp(s, "s", 1) == 0)) {
@@ -781,6 +906,26 @@ main (int argc, char *argv[])
 	FUSE_ARG ("-o");
 	FUSE_ARG ("direct_io");
 #endif
+#if HAVE_FUSE_O_TIMEOUTS
+	if (! lowlevel) {
+		if (entry_timeout >= 0) {
+			FUSE_ARG ("-o");
+			FUSE_ARG (talloc_asprintf (tmp_ctx, "entry_timeout=%g",
+						   entry_timeout));
+		}
+		if (attr_timeout >= 0) {
+			FUSE_ARG ("-o");
+			FUSE_ARG (talloc_asprintf (tmp_ctx, "attr_timeout=%g",
+						   attr_timeout));
+		}
+		if (negative_timeout >= 0) {
+			FUSE_ARG ("-o");
+			FUSE_ARG (talloc_asprintf (tmp_ctx, 
+						   "negative_timeout=%g",
+						   negative_timeout));
+		}
+	}
+#endif
 
 	/*
 	 * Set charset encoding
@@ -791,6 +936,20 @@ main (int argc, char *argv[])
 			    NN(charset));
 	}
 
+	/*
+	 * Set cache for remote files content
+	 */
+	if (cache_mem > 0 || cache_dir) {
+		rc = BlockCache_Initialize ((size_t) MAX (cache_mem, 0) 
+					    * 1024 * 1024, cache_dir,
+					    (off_t) cache_size * 1024 * 1024);
+		if (rc) {
+			Log_Printf (LOG_ERROR, "Error initialising cache_dir="
+				    "'%s' : disk cache disabled", 
+				    NN(cache_dir));
+		}
+	}
+
 	/* 
 	 * Create virtual file system
 	 */
@@ -825,7 +984,18 @@ main (int argc, char *argv[])
 	 * Initialise UPnP Control point and starts FUSE file system
 	 */
 	
-	rc = DeviceList_Start (CONTENT_DIR_SERVICE_TYPE, NULL);
+	rc = UpnpSetConnectTimeout (MAX (connect_timeout, 0));
+	if (rc != UPNP_E_SUCCESS) {
+		Log_Printf (LOG_ERROR, "Error setting connect_timeout=%d : %d",
+			    connect_timeout, rc);
+	}
+
+	ContentDir_SetMaxStale (MAX (browse_stale, 0));
+	ContentDir_SetSnapshotDir (browse_snapshot);
+	// The source of DIDL-Lite objects is only needed for .metadata files
+	DIDLObject_SetKeepXML ((djfs_flags & DJFS_SHOW_METADATA) != 0);
+
+	rc = DeviceList_Start (CONTENT_DIR_SERVICE_TYPE, device_event);
 	if (rc != UPNP_E_SUCCESS) {
 		Log_Printf (LOG_ERROR, 
 			    "Error starting UPnP Control Point : %d (%s)",
@@ -835,7 +1005,20 @@ main (int argc, char *argv[])
 	
 
 	fuse_argv[fuse_argc] = NULL; // End FUSE arguments list
-	rc = fuse_main (fuse_argc, fuse_argv, &fs_oper);
+#if HAVE_FUSE_LOWLEVEL
+	if (lowlevel) {
+#define LL_TIMEOUT(T)	((T) >= 0 ? (T) : DEFAULT_LOWLEVEL_TIMEOUT)
+		const FuseLowLevel_Options ll_options = {
+			.entry_timeout    = LL_TIMEOUT (entry_timeout),
+			.attr_timeout     = LL_TIMEOUT (attr_timeout),
+			.negative_timeout = LL_TIMEOUT (negative_timeout),
+		};
+#undef LL_TIMEOUT
+		rc = FuseLowLevel_Main (fuse_argc, fuse_argv, g_djfs, 
+					&ll_options);
+	} else
+#endif
+		rc = fuse_main (fuse_argc, fuse_argv, &fs_oper);
 	if (rc != 0) {
 		Log_Printf (LOG_ERROR, "Error in FUSE main loop = %d", rc);
 	}
@@ -104,6 +104,28 @@ typedef void (*Log_PrintFunction) (Log_Level level, const char* string);
 #endif
 
 
+/**
+ * @brief Log a message, as "Log_Printf", but the arguments are only 
+ *	evaluated if the message is allowed by the current log level.
+ *	To be used on frequent paths (browse, read, events), or when 
+ *	the arguments are costly to compute (e.g. a document converted 
+ *	to a string) : nothing is paid if the level is not activated.
+ *	The LOG_DEBUG messages are compiled out unless DEBUG is defined
+ *	(see LOG_IS_DEBUG_ACTIVATED).
+ *	Note that LEVEL is evaluated several times.
+ *
+ * @param LEVEL log level for the message	
+ * @param ...   format (see printf), followed by its arguments.
+ */
+#define LOG_PRINTF(LEVEL,...)					\
+	do {							\
+		if ((LEVEL) == LOG_DEBUG ?			\
+		    LOG_IS_DEBUG_ACTIVATED :			\
+		    Log_IsActivated (LEVEL))			\
+			Log_Printf (LEVEL, __VA_ARGS__);	\
+	} while (0)
+
+
 /*****************************************************************************
  * Functions
  *****************************************************************************/
@@ -142,21 +142,14 @@ MediaFile_GetPreferred (const DIDLObject* const o, MediaFile* file)
 	if (o == NULL)
 		return false; // ---------->
 
-	IXML_NodeList* const reslist = 
-		ixmlElement_getElementsByTagName (o->element, "res");
-	if (reslist == NULL)
-		return false; // ---------->
-
-	int i;
+	size_t i;
 	// Loop until first result
 	bool found = false;
-	for (i = 0; i < ixmlNodeList_length (reslist) && !found; i++) {
-		IXML_Element* const res = 
-			(IXML_Element*) ixmlNodeList_item (reslist, i);
+	for (i = 0; i < o->nb_res && !found; i++) {
+		const DIDLResource* const res = o->res + i;
 		
-		const char* const protocol = 
-			ixmlElement_getAttribute (res, "protocolInfo");
-		const char* const uri = XMLUtil_GetElementValue (res);
+		const char* const protocol = res->protocol_info;
+		const char* const uri = res->uri;
 		char mimetype [64] = "";
 		if (uri == NULL || protocol == NULL || 
 		    sscanf (protocol, "http-get:*:%63[^:;]", mimetype) != 1) 
@@ -194,7 +187,6 @@ MediaFile_GetPreferred (const DIDLObject* const o, MediaFile* file)
 			format++;
 		}
 	}
-	ixmlNodeList_free (reslist);
 	return found;
 }
 
@@ -253,8 +245,7 @@ MediaFile_GetPlaylistContent (const MediaFile* const file,
 		 * 2) "M3U" playlist - Winamp, MP3, ... 
 		 *     and default for all audio files 
 		 */
-		const char* const duration = 
-			ixmlElement_getAttribute (file->res, "duration");
+		const char* const duration = file->res->duration;
 		int seconds = -1;
 		if (duration) {
 			int hh = 0;
@@ -280,10 +271,8 @@ MediaFile_GetPlaylistContent (const MediaFile* const file,
 off_t
 MediaFile_GetResSize (const MediaFile* const file)
 {
-	const char* const str = ixmlElement_getAttribute (file->res, "size");
-	off_t res;
-	STRING_TO_INT (str, res, 8ULL * 1024 * 1024 * 1024);
-	return res;
+	return (file->res->size >= 0 ? file->res->size 
+		: 8LL * 1024 * 1024 * 1024);
 }
 
 
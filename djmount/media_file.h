@@ -46,7 +46,7 @@ typedef struct _MediaFile {
 	char			extension [10];
 	const char*		playlist;
 	const char*  		uri;
-	IXML_Element*  		res;
+	const DIDLResource*	res;
 } MediaFile;
 
 
@@ -60,7 +60,7 @@ typedef struct _MediaFile {
  * @return	true if success, false if error
  *****************************************************************************/
 bool
-MediaFile_GetPreferred (const DIDLObject* o, OUT MediaFile* file);
+MediaFile_GetPreferred (const DIDLObject* o, MediaFile* file);
 
 
 /*****************************************************************************
@@ -0,0 +1,488 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/* $Id$
+ *
+ * Streaming (SAX-like) XML parser.
+ * This file is part of djmount.
+ *
+ * (C) Copyright 2026 djmount contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include "sax_parser.h"
+#include "talloc_util.h"
+#include "log.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+
+/******************************************************************************
+ * Parser
+ *
+ * Description:
+ *	Parsing state. Names, attribute values and texts are decoded into
+ *	"buf" ; the names of the open elements are kept in "stack".
+ *
+ *****************************************************************************/
+typedef struct _Parser {
+	const char*	p;	// current position in the document
+	int		depth;
+
+	char*		buf;
+	size_t		buf_size;
+	size_t		buf_used;
+
+	size_t*		stack;	// offsets in "names" of the open elements
+	size_t		stack_size;
+	char*		names;
+	size_t		names_size;
+	size_t		names_used;
+
+	size_t*		atts_off;
+	const char**	atts;
+	size_t		atts_size;
+} Parser;
+
+
+/******************************************************************************
+ * Buffer helpers
+ *****************************************************************************/
+static bool
+buf_reserve (void* ctx, char** buf, size_t* size, size_t needed)
+{
+	if (needed > *size) {
+		size_t n = (*size ? *size * 2 : 256);
+		while (n < needed)
+			n *= 2;
+		char* const b = talloc_realloc (ctx, *buf, char, n);
+		if (b == NULL)
+			return false; // ---------->
+		*buf = b;
+		*size = n;
+	}
+	return true;
+}
+
+static inline bool
+buf_append (Parser* ps, const char* s, size_t len)
+{
+	if (! buf_reserve (ps, &ps->buf, &ps->buf_size, 
+			   ps->buf_used + len + 1))
+		return false; // ---------->
+	memcpy (ps->buf + ps->buf_used, s, len);
+	ps->buf_used += len;
+	ps->buf [ps->buf_used] = '\0';
+	return true;
+}
+
+
+/******************************************************************************
+ * append_utf8
+ *	Append a character reference, encoded in UTF-8
+ *****************************************************************************/
+static bool
+append_utf8 (Parser* ps, unsigned long c)
+{
+	char s [4];
+	size_t n;
+	if (c < 0x80) {
+		s[0] = c;
+		n = 1;
+	} else if (c < 0x800) {
+		s[0] = 0xC0 | (c >> 6);
+		s[1] = 0x80 | (c & 0x3F);
+		n = 2;
+	} else if (c < 0x10000) {
+		s[0] = 0xE0 | (c >> 12);
+		s[1] = 0x80 | ((c >> 6) & 0x3F);
+		s[2] = 0x80 | (c & 0x3F);
+		n = 3;
+	} else if (c < 0x110000) {
+		s[0] = 0xF0 | (c >> 18);
+		s[1] = 0x80 | ((c >> 12) & 0x3F);
+		s[2] = 0x80 | ((c >> 6) & 0x3F);
+		s[3] = 0x80 | (c & 0x3F);
+		n = 4;
+	} else {
+		return false; // ---------->
+	}
+	return buf_append (ps, s, n);
+}
+
+
+/******************************************************************************
+ * append_decoded
+ *
+ * Description:
+ *	Append "s" (of length "len") to "buf", decoding the entities.
+ *	Returns false if bad entity or memory error.
+ *
+ *****************************************************************************/
+static bool
+append_decoded (Parser* ps, const char* s, size_t len)
+{
+	const char* const end = s + len;
+	while (s < end) {
+		const char* const amp = memchr (s, '&', end - s);
+		if (amp == NULL)
+			return buf_append (ps, s, end - s); // ---------->
+		if (! buf_append (ps, s, amp - s))
+			return false; // ---------->
+
+		const char* const semi = memchr (amp, ';', end - amp);
+		if (semi == NULL)
+			return false; // ---------->
+		const char* const e = amp + 1;
+		size_t const n = semi - e;
+		bool ok;
+		if (n > 1 && e[0] == '#') {
+			char* endptr = NULL;
+			unsigned long const c = (e[1] == 'x' ?
+						 strtoul (e+2, &endptr, 16) :
+						 strtoul (e+1, &endptr, 10));
+			ok = (endptr == semi && c > 0 && 
+			      append_utf8 (ps, c));
+		} else if (n == 2 && strncmp (e, "lt", 2) == 0) {
+			ok = buf_append (ps, "<", 1);
+		} else if (n == 2 && strncmp (e, "gt", 2) == 0) {
+			ok = buf_append (ps, ">", 1);
+		} else if (n == 3 && strncmp (e, "amp", 3) == 0) {
+			ok = buf_append (ps, "&", 1);
+		} else if (n == 4 && strncmp (e, "quot", 4) == 0) {
+			ok = buf_append (ps, "\"", 1);
+		} else if (n == 4 && strncmp (e, "apos", 4) == 0) {
+			ok = buf_append (ps, "'", 1);
+		} else {
+			ok = false;
+		}
+		if (! ok)
+			return false; // ---------->
+		s = semi + 1;
+	}
+	return true;
+}
+
+
+/******************************************************************************
+ * Lexical helpers
+ *****************************************************************************/
+static inline bool
+is_space (char c)
+{
+	return (c == ' ' || c == '\t' || c == '\n' || c == '\r');
+}
+
+static inline bool
+is_name_char (char c)
+{
+	return (c != '\0' && ! is_space (c) && 
+		strchr ("<>/=\"'&;!?", c) == NULL);
+}
+
+static inline void
+skip_spaces (Parser* ps)
+{
+	while (is_space (*ps->p))
+		ps->p++;
+}
+
+// Skip up to, and including, "delim". Returns false if not found.
+static bool
+skip_past (Parser* ps, const char* delim)
+{
+	const char* const s = strstr (ps->p, delim);
+	if (s == NULL)
+		return false; // ---------->
+	ps->p = s + strlen (delim);
+	return true;
+}
+
+// Name at the current position, or 0 length if none
+static size_t
+scan_name (Parser* ps)
+{
+	const char* s = ps->p;
+	while (is_name_char (*s))
+		s++;
+	return s - ps->p;
+}
+
+
+// Room for "n" attribute pointers
+static bool
+reserve_atts (Parser* ps, size_t n)
+{
+	if (n > ps->atts_size) {
+		size_t const size = 2 * n;
+		size_t* const o = talloc_realloc (ps, ps->atts_off, size_t,
+						  size);
+		if (o == NULL)
+			return false; // ---------->
+		ps->atts_off = o;
+		const char** const a = talloc_realloc (ps, ps->atts, 
+						       const char*, size);
+		if (a == NULL)
+			return false; // ---------->
+		ps->atts = a;
+		ps->atts_size = size;
+	}
+	return true;
+}
+
+
+/******************************************************************************
+ * parse_start_tag
+ *
+ * Description:
+ *	Parse a start tag, "ps->p" being after the '<'. Calls the "start"
+ *	handler, and the "end" handler if empty element.
+ *	Returns 0 if ok, or error.
+ *
+ *****************************************************************************/
+static int
+parse_start_tag (Parser* ps, const SaxParser_Handler* handler, void* user)
+{
+	const char* const tag = ps->p - 1;
+	size_t const name_len = scan_name (ps);
+	if (name_len == 0)
+		return -1; // ---------->
+
+	// Remember the element name on the stack (for the end tag)
+	if (ps->depth >= (int) ps->stack_size) {
+		size_t const n = (ps->stack_size ? ps->stack_size * 2 : 16);
+		size_t* const s = talloc_realloc (ps, ps->stack, size_t, n);
+		if (s == NULL)
+			return -1; // ---------->
+		ps->stack = s;
+		ps->stack_size = n;
+	}
+	if (! buf_reserve (ps, &ps->names, &ps->names_size,
+			   ps->names_used + name_len + 1))
+		return -1; // ---------->
+	char* const name = ps->names + ps->names_used;
+	memcpy (name, ps->p, name_len);
+	name [name_len] = '\0';
+	ps->p += name_len;
+
+	// Attributes, decoded into "buf" (the pointers are set at the end,
+	// "buf" may move in the meantime)
+	size_t nb_atts = 0;
+	ps->buf_used = 0;
+	for (;;) {
+		if (! reserve_atts (ps, 2 * nb_atts + 1))
+			return -1; // ---------->
+		skip_spaces (ps);
+		if (*ps->p == '>' || (ps->p[0] == '/' && ps->p[1] == '>'))
+			break; // ---------->
+
+		size_t const att_len = scan_name (ps);
+		if (att_len == 0 || ! reserve_atts (ps, 2 * nb_atts + 3))
+			return -1; // ---------->
+		ps->atts_off [2*nb_atts] = ps->buf_used;
+		if (! buf_append (ps, ps->p, att_len))
+			return -1; // ---------->
+		ps->buf_used++; // keep the '\0'
+		ps->p += att_len;
+
+		skip_spaces (ps);
+		if (*ps->p++ != '=')
+			return -1; // ---------->
+		skip_spaces (ps);
+		char const quote = *ps->p++;
+		if (quote != '"' && quote != '\'')
+			return -1; // ---------->
+		const char* const value = ps->p;
+		const char* const value_end = strchr (value, quote);
+		if (value_end == NULL)
+			return -1; // ---------->
+		ps->atts_off [2*nb_atts + 1] = ps->buf_used;
+		if (! buf_append (ps, "", 0) ||
+		    ! append_decoded (ps, value, value_end - value))
+			return -1; // ---------->
+		ps->buf_used++;
+		ps->p = value_end + 1;
+		nb_atts++;
+	}
+	size_t i;
+	for (i = 0; i < 2 * nb_atts; i++)
+		ps->atts[i] = ps->buf + ps->atts_off[i];
+	ps->atts [2 * nb_atts] = NULL;
+
+	bool const empty = (*ps->p == '/');
+	ps->p += (empty ? 2 : 1);
+
+	int rc = 0;
+	if (handler->start)
+		rc = handler->start (user, ps->depth, name, ps->atts, tag);
+	if (rc == 0 && empty) {
+		if (handler->end)
+			rc = handler->end (user, ps->depth, name, ps->p);
+	} else if (rc == 0) {
+		ps->stack [ps->depth++] = ps->names_used;
+		ps->names_used += name_len + 1;
+	}
+	return rc;
+}
+
+
+/******************************************************************************
+ * parse_end_tag
+ *
+ * Description:
+ *	Parse an end tag, "ps->p" being after the "</".
+ *	Returns 0 if ok, or error.
+ *
+ *****************************************************************************/
+static int
+parse_end_tag (Parser* ps, const SaxParser_Handler* handler, void* user)
+{
+	if (ps->depth == 0)
+		return -1; // ---------->
+	size_t const offset = ps->stack [ps->depth - 1];
+	const char* const name = ps->names + offset;
+	size_t const name_len = scan_name (ps);
+	if (name_len != strlen (name) || strncmp (ps->p, name, name_len) != 0)
+		return -1; // ---------->
+	ps->p += name_len;
+	skip_spaces (ps);
+	if (*ps->p++ != '>')
+		return -1; // ---------->
+
+	ps->depth--;
+	int const rc = (handler->end ?
+			handler->end (user, ps->depth, name, ps->p) : 0);
+	ps->names_used = offset;
+	return rc;
+}
+
+
+/******************************************************************************
+ * parse_text
+ *
+ * Description:
+ *	Parse character data up to the next markup.
+ *	Returns 0 if ok, or error.
+ *
+ *****************************************************************************/
+static int
+parse_text (Parser* ps, const SaxParser_Handler* handler, void* user)
+{
+	const char* const s = ps->p;
+	const char* e = strchr (s, '<');
+	if (e == NULL)
+		e = s + strlen (s);
+	ps->p = e;
+	if (ps->depth == 0) {
+		// Only spaces allowed outside the root element
+		const char* c;
+		for (c = s; c < e; c++) {
+			if (! is_space (*c))
+				return -1; // ---------->
+		}
+		return 0; // ---------->
+	}
+	if (handler->text == NULL)
+		return 0; // ---------->
+	ps->buf_used = 0;
+	if (! buf_append (ps, "", 0) || ! append_decoded (ps, s, e - s))
+		return -1; // ---------->
+	return handler->text (user, ps->depth - 1, ps->buf, ps->buf_used);
+}
+
+
+/*****************************************************************************
+ * SaxParser_Parse
+ *****************************************************************************/
+int
+SaxParser_Parse (const char* xml, const SaxParser_Handler* handler,
+		 void* user_data)
+{
+	if (xml == NULL || handler == NULL) {
+		Log_Printf (LOG_ERROR, "SaxParser_Parse NULL parameter");
+		return -1; // ---------->
+	}
+
+	Parser* const ps = talloc_zero (NULL, Parser);
+	if (ps == NULL)
+		return -1; // ---------->
+	ps->p = xml;
+	// Skip UTF-8 byte order mark
+	if (strncmp (ps->p, "\xEF\xBB\xBF", 3) == 0)
+		ps->p += 3;
+
+	int rc = 0;
+	bool root_seen = false;
+	while (rc == 0 && *ps->p) {
+		if (*ps->p != '<') {
+			rc = parse_text (ps, handler, user_data);
+		} else if (strncmp (ps->p, "<?", 2) == 0) {
+			rc = (skip_past (ps, "?>") ? 0 : -1);
+		} else if (strncmp (ps->p, "<!--", 4) == 0) {
+			rc = (skip_past (ps, "-->") ? 0 : -1);
+		} else if (strncmp (ps->p, "<![CDATA[", 9) == 0) {
+			const char* const s = ps->p + 9;
+			if (ps->depth == 0 || ! skip_past (ps, "]]>"))
+				rc = -1;
+			else if (handler->text)
+				rc = handler->text (user_data, ps->depth - 1,
+						    s, ps->p - 3 - s);
+		} else if (strncmp (ps->p, "<!", 2) == 0) {
+			// DOCTYPE : skip the internal subset if any
+			const char* const gt = strchr (ps->p, '>');
+			const char* const bracket = strchr (ps->p, '[');
+			if (bracket && gt && bracket < gt)
+				rc = (skip_past (ps, "]") &&
+				      skip_past (ps, ">") ? 0 : -1);
+			else
+				rc = (skip_past (ps, ">") ? 0 : -1);
+		} else if (ps->p[1] == '/') {
+			ps->p += 2;
+			rc = parse_end_tag (ps, handler, user_data);
+		} else if (ps->depth == 0 && root_seen) {
+			rc = -1; // only one root element
+		} else {
+			root_seen = true;
+			ps->p++;
+			rc = parse_start_tag (ps, handler, user_data);
+		}
+	}
+	if (rc == 0 && (ps->depth > 0 || ! root_seen))
+		rc = -1;
+
+	talloc_free (ps);
+	return rc;
+}
+
+
+/*****************************************************************************
+ * SaxParser_GetAttribute
+ *****************************************************************************/
+const char*
+SaxParser_GetAttribute (const char** atts, const char* name)
+{
+	if (atts && name) {
+		for (; atts[0]; atts += 2) {
+			if (strcmp (atts[0], name) == 0)
+				return atts[1]; // ---------->
+		}
+	}
+	return NULL;
+}
+
@@ -0,0 +1,119 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/* $Id$
+ *
+ * Streaming (SAX-like) XML parser.
+ * This file is part of djmount.
+ *
+ * (C) Copyright 2026 djmount contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef SAX_PARSER_H_INCLUDED
+#define SAX_PARSER_H_INCLUDED
+
+#include <stddef.h>
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/******************************************************************************
+ * SaxParser
+ *
+ *	Parse an XML document in one pass, calling a handler for each
+ *	element and text, without building a DOM tree (see <upnp/ixml.h>).
+ *	This is much faster, and uses much less memory, to extract some
+ *	data from large documents e.g. DIDL-Lite results.
+ *
+ *	Element names are not namespace-processed : they are passed with
+ *	their prefix (e.g. "dc:title"). Character and predefined entities
+ *	are decoded in texts and attribute values. Comments, processing
+ *	instructions and DOCTYPE declarations are skipped.
+ *
+ *****************************************************************************/
+
+
+/******************************************************************************
+ * @var SaxParser_Handler
+ *
+ *	Callbacks called by SaxParser_Parse (each one may be NULL).
+ *	The strings passed are only valid during the call. A callback
+ *	returning non 0 stops the parsing.
+ *
+ *	start	start of element : "atts" is a NULL-terminated list of
+ *		attribute names and values, "atts[2*i]" and "atts[2*i+1]".
+ *		"tag" points to the '<' of the start tag in the document.
+ *	end	end of element : "tag_end" points after the '>' of the
+ *		end tag (or of the start tag if empty element) in the
+ *		document.
+ *	text	character data, inside the root element. The text of an
+ *		element may be passed in several pieces (e.g. if containing
+ *		CDATA sections).
+ *
+ *	"depth" is the number of enclosing elements (0 for the root element).
+ *	For a text, it is the depth of the element containing the text.
+ *****************************************************************************/
+
+typedef struct _SaxParser_Handler {
+
+	int (*start) (void* user_data, int depth, const char* name,
+		      const char** atts, const char* tag);
+
+	int (*end)   (void* user_data, int depth, const char* name,
+		      const char* tag_end);
+
+	int (*text)  (void* user_data, int depth,
+		      const char* text, size_t len);
+
+} SaxParser_Handler;
+
+
+/*****************************************************************************
+ * @brief Parse a document.
+ *
+ * @param xml		the document (nul-terminated)
+ * @param handler	the callbacks
+ * @param user_data	passed to the callbacks
+ * @return 0 if ok, -1 if the document is not well-formed, or the non 0
+ *	   value returned by a callback.
+ *	   Note: the callbacks may have been called before an error is
+ *	   detected.
+ *****************************************************************************/
+int
+SaxParser_Parse (const char* xml, const SaxParser_Handler* handler,
+		 void* user_data);
+
+
+/*****************************************************************************
+ * @brief Returns the value of an attribute, or NULL if not found.
+ *
+ * @param atts		the list of attributes passed to "start"
+ * @param name		the attribute name
+ *****************************************************************************/
+const char*
+SaxParser_GetAttribute (const char** atts, const char* name);
+
+
+
+#ifdef __cplusplus
+}; // extern "C"
+#endif
+
+
+#endif // SAX_PARSER_H_INCLUDED
+
@@ -60,20 +60,19 @@ Service_SubscribeEventURL (Service* serv)
 			    "Service_SubscribeEventURL NULL Service");
 		rc = UPNP_E_INVALID_SERVICE;
 	} else {
-		Log_Printf (LOG_DEBUG, "Subscribing to EventURL %s", 
+		LOG_PRINTF (LOG_DEBUG, "Subscribing to EventURL %s", 
 			    NN(serv->eventURL));
 		int timeout = SUBSCRIBE_DEFAULT_TIMEOUT;    
 		Upnp_SID sid;
 		rc = UpnpSubscribe (serv->ctrlpt_handle, serv->eventURL, 
 				    &timeout, sid);
-		talloc_free (serv->sid);
 		if ( rc == UPNP_E_SUCCESS ) {
-			serv->sid = talloc_strdup (serv, sid);
-			Log_Printf (LOG_DEBUG, 
+			Service_SetSid (serv, sid);
+			LOG_PRINTF (LOG_DEBUG, 
 				    "Subscribed to %s EventURL with SID=%s", 
-				    talloc_get_name (serv), serv->sid);
+				    talloc_get_name (serv), sid);
 		} else {
-			serv->sid = NULL;
+			Service_SetSid (serv, NULL);
 			Log_Printf (LOG_ERROR, 
 				    "Error Subscribing to %s EventURL -- %d", 
 				    talloc_get_name (serv), rc);
@@ -103,7 +102,7 @@ Service_UnsubscribeEventURL (Service* serv)
 		rc = UpnpUnSubscribe (serv->ctrlpt_handle, 
 				      serv->sid);
 		if ( UPNP_E_SUCCESS == rc ) {
-			Log_Printf(LOG_DEBUG, 
+			LOG_PRINTF(LOG_DEBUG, 
 				   "Unsubscribed from %s EventURL with SID=%s",
 				   talloc_get_name (serv), serv->sid);
 		} else {
@@ -138,6 +137,8 @@ finalize (Object* obj)
 		 */
 		ListDestroy (&serv->variables, /*freeItem=>*/ 0);
 		
+		ithread_mutex_destroy (&serv->mutex);
+
 		// The "talloc'ed" strings will be deleted automatically : 
 		// nothing to do 
 	}
@@ -156,8 +157,10 @@ Service_SetSid (Service* serv, Upnp_SID sid)
 		Log_Printf (LOG_ERROR, "Service_SetSid NULL Service");
 		rc = UPNP_E_INVALID_SERVICE;
 	} else {
+		ithread_mutex_lock (&serv->mutex);
 		talloc_free (serv->sid);
 		serv->sid = (sid ? talloc_strdup (serv, sid) : NULL);
+		ithread_mutex_unlock (&serv->mutex);
 	}
 	return rc;
 }
@@ -188,7 +191,8 @@ GetVariable (const Service* serv, const char* name)
  * Service_UpdateState
  *****************************************************************************/
 int
-Service_UpdateState (Service* serv, IXML_Document* changedVariables)
+Service_UpdateState (Service* serv, IXML_Document* changedVariables,
+		     Service_Changes* changes)
 {
   int rc = UPNP_E_SUCCESS;
 
@@ -197,9 +201,11 @@ Service_UpdateState (Service* serv, IXML_Document* changedVariables)
     rc = UPNP_E_INVALID_SERVICE;
   } else {
 
-    Log_Printf (LOG_DEBUG, "State Update for service %s", 
+    LOG_PRINTF (LOG_DEBUG, "State Update for service %s", 
 		talloc_get_name (serv));
 
+    ithread_mutex_lock (&serv->mutex);
+
     /*
      * Find all of the <e:property> tags in the document 
      */
@@ -233,7 +239,7 @@ Service_UpdateState (Service* serv, IXML_Document* changedVariables)
 	    
 	    if (name && strcmp (name, "e:property") != 0) {
 	      const char* value = XMLUtil_GetElementValue (variable);
-	      Log_Printf (LOG_DEBUG, "Variable Update '%s' = '%s'",
+	      LOG_PRINTF (LOG_DEBUG, "Variable Update '%s' = '%s'",
 			  NN(name), NN(value));
 	      
 	      ListNode* node = GetVariable (serv, name);
@@ -252,7 +258,8 @@ Service_UpdateState (Service* serv, IXML_Document* changedVariables)
 	      }
 	      if (OBJECT_METHOD (serv,update_variable))
 		OBJECT_METHOD (serv, update_variable) (serv, 
-						       var->name, var->value);
+						       var->name, var->value,
+						       changes);
 	    }
 	  }
 	}
@@ -262,6 +269,8 @@ Service_UpdateState (Service* serv, IXML_Document* changedVariables)
     }
     ixmlNodeList_free (properties);
     properties = NULL;
+
+    ithread_mutex_unlock (&serv->mutex);
   }
   return rc;
 }
@@ -307,6 +316,8 @@ static void
 ActionError (Service* serv, const char* actionName,
 	     int rc, IXML_Document** response)
 {
+	ithread_mutex_lock (&serv->mutex);
+
 	talloc_free (serv->la_name);
 	serv->la_name   = talloc_strdup (serv, actionName);
 	serv->la_result = rc;
@@ -320,11 +331,12 @@ ActionError (Service* serv, const char* actionName,
 			    "Error in UpnpSendAction '%s' -- %d (%s)", 
 			    actionName, rc, UpnpGetErrorMessage (rc));
 		if (response && *response) { 
-			DOMString s = ixmlDocumenttoString (*response);
-			Log_Printf (LOG_DEBUG, 
-				    "Error in UpnpSendAction, response = %s", 
-				    s);
-			ixmlFreeDOMString (s);
+			if (Log_IsActivated (LOG_DEBUG)) {
+				DOMString s = ixmlDocumenttoString (*response);
+				Log_Printf (LOG_DEBUG, "Error in UpnpSendAction, "
+					    "response = %s", s);
+				ixmlFreeDOMString (s);
+			}
 			// rc > 0 : SOAP-protocol error
 			serv->la_error_code = talloc_strdup 
 				(serv, XMLUtil_FindFirstElementValue
@@ -343,6 +355,7 @@ ActionError (Service* serv, const char* actionName,
 		}
 	}
 
+	ithread_mutex_unlock (&serv->mutex);
 }
 
 
@@ -356,7 +369,7 @@ Service_SendActionAsync (const Service* serv,
 			 int nb_params, const StringPair* params)
 {
   int rc = UPNP_E_SUCCESS;
-  Log_Printf (LOG_DEBUG, "Service_SendActionAsync '%s'", NN(actionName));
+  LOG_PRINTF (LOG_DEBUG, "Service_SendActionAsync '%s'", NN(actionName));
   
   if (serv == NULL) {
     Log_Printf (LOG_ERROR, "Service_SendActionAsync NULL Service");
@@ -400,7 +413,7 @@ Service_SendActionAsyncVa (const Service* serv,
     nb++;
   }
   va_end (ap);
-  Log_Printf (LOG_DEBUG, "Service_SendActionAsyncVa : %d pairs found", nb);
+  LOG_PRINTF (LOG_DEBUG, "Service_SendActionAsyncVa : %d pairs found", nb);
   
   return Service_SendActionAsync (serv, callback, actionName, nb, params);
 }
@@ -416,7 +429,7 @@ Service_SendAction (Service* serv,
 		    int nb_params, const StringPair* params)
 {
   int rc = UPNP_E_SUCCESS;
-  Log_Printf (LOG_DEBUG, "Service_SendAction '%s'", NN(actionName));
+  LOG_PRINTF (LOG_DEBUG, "Service_SendAction '%s'", NN(actionName));
   
   if (serv == NULL) {
     Log_Printf (LOG_ERROR, "Service_SendAction NULL Service");
@@ -463,7 +476,7 @@ Service_SendActionVa (Service* serv,
     nb++;
   }
   va_end (ap);
-  Log_Printf (LOG_DEBUG, "Service_SendActionVa : %d pairs found", nb);
+  LOG_PRINTF (LOG_DEBUG, "Service_SendActionVa : %d pairs found", nb);
   
   return Service_SendAction (serv, response, actionName, nb, params);
 }
@@ -491,6 +504,9 @@ get_status_string (const Service* serv,
 	tpr (&p, "%s+- EventURL        = %s\n", spacer, NN(serv->eventURL));
 	tpr (&p, "%s+- ControlURL      = %s\n", spacer, NN(serv->controlURL));
 	
+	Service* const mserv = discard_const_p (Service, serv);
+	ithread_mutex_lock (&mserv->mutex);
+
 	// Print variables
 	tpr (&p, "%s+- ServiceStateTable\n", spacer);
 	ListNode* node;
@@ -516,6 +532,8 @@ get_status_string (const Service* serv,
 	
 	tpr (&p, "%s+- SID             = %s\n", spacer, NN(serv->sid));
 	
+	ithread_mutex_unlock (&mserv->mutex);
+
 	return p;
 }
 
@@ -540,6 +558,19 @@ Service_GetSid (const Service* serv)
   return (serv ? serv->sid : NULL);
 }
 
+bool
+Service_IsSubscribed (const Service* serv)
+{
+  bool subscribed = false;
+  if (serv) {
+    Service* const mserv = discard_const_p (Service, serv);
+    ithread_mutex_lock (&mserv->mutex);
+    subscribed = (serv->sid != NULL);
+    ithread_mutex_unlock (&mserv->mutex);
+  }
+  return subscribed;
+}
+
 const char*
 Service_GetEventURL (const Service* serv)
 {
@@ -594,11 +625,11 @@ Service_Create (void* talloc_context,
 
 	self->serviceType = talloc_strdup (self, XMLUtil_FindFirstElementValue
 					   (node, "serviceType", false, true));
-	Log_Printf (LOG_DEBUG, "Service_Create: %s", NN(self->serviceType));
+	LOG_PRINTF (LOG_DEBUG, "Service_Create: %s", NN(self->serviceType));
 	
 	self->serviceId = talloc_strdup (self, XMLUtil_FindFirstElementValue
 					 (node, "serviceId", false, true));
-	Log_Printf (LOG_DEBUG, "serviceId: %s", NN(self->serviceId));
+	LOG_PRINTF (LOG_DEBUG, "serviceId: %s", NN(self->serviceId));
 	
 	const char* relcontrolURL = XMLUtil_FindFirstElementValue
 		(node, "controlURL", false, true);
@@ -617,6 +648,8 @@ Service_Create (void* talloc_context,
 	self->la_name = self->la_error_code = self->la_error_desc = NULL;
 	self->la_result = UPNP_E_SUCCESS;
 
+	ithread_mutex_init (&self->mutex, NULL);
+
 	return self; // ---------->
 }
 
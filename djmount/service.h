@@ -31,6 +31,7 @@
 
 #include "string_util.h"	// for StringPair
 #include "object.h"
+#include "ptr_array.h"
 
 
 #ifdef __cplusplus
@@ -46,9 +47,11 @@ extern "C" {
  *
  *	This opaque type encapsulates access to a generic UPnP service.
  *	
- *      NOTE THAT THE FUNCTION API IS NOT THREAD SAFE. Function should 
- *      be called through the global functions in "devicelist.h", 
- *	who lock the global service and device list.
+ *	The functions can be called concurrently from several threads 
+ *	(the service state is protected by an internal lock, which is not
+ *	held during network requests), but the Service itself should be 
+ *	accessed through the global functions in "devicelist.h", which 
+ *	prevent it from being destroyed while in use.
  *
  *****************************************************************************/
 
@@ -148,6 +151,19 @@ Service_SendActionVa (Service* serv,
 
 
 
+/*****************************************************************************
+ * @brief Objects of the service which have changed, as reported by
+ *	  an event (see Service_UpdateState).
+ *****************************************************************************/
+typedef struct _Service_Changes {
+
+	bool	  all;		// any object may have changed
+	PtrArray* objects;	// ids (char*) of the changed objects, 
+				// allocated in this array
+
+} Service_Changes;
+
+
 /*****************************************************************************
  * @brief Update a service state table.  
  *	Called when an event is received.
@@ -155,11 +171,14 @@ Service_SendActionVa (Service* serv,
  * @param serv         	     the service object
  * @param changedVariables   DOM document representing the XML received
  *                           with the event
+ * @param changes	     if not NULL, the objects changed by the event
+ *			     are added to it (e.g. ContentDir containers)
  *
  *****************************************************************************/
 int 
 Service_UpdateState (IN Service* serv, 
-		     IN IXML_Document* changedVariables);
+		     IN IXML_Document* changedVariables,
+		     OUT Service_Changes* changes);
   
 
 
@@ -184,6 +203,9 @@ const char*	Service_GetServiceType (const Service* serv);
 
 int		Service_SetSid (Service* serv, Upnp_SID sid);
 
+// true if subscribed to the events of the service (i.e. has a SID)
+bool		Service_IsSubscribed (const Service* serv);
+
 
 
 #ifdef __cplusplus
@@ -29,6 +29,7 @@
 #include "object_p.h"
 
 #include <upnp/LinkedList.h>
+#include <upnp/ithread.h>
 
 
 /******************************************************************************
@@ -55,13 +56,20 @@ OBJECT_DEFINE_STRUCT(Service,
 		     int   la_result;
 		     char* la_error_code;
 		     char* la_error_desc;
+
+		     // Protects the mutable fields above (sid, variables,
+		     // last action) and talloc allocations on the Service.
+		     // Never held during network requests.
+		     ithread_mutex_t mutex;
 		     );
 
 OBJECT_DEFINE_METHODS(Service,
 		      // Additional Virtual methods
+		      // (update_variable is called with the Service locked)
 		      void  (*update_variable) (Service*, 
 						const char* name, 
-						const char* value);
+						const char* value,
+						Service_Changes* changes);
 		      char* (*get_status_string) (const Service* serv, 
 						  void* result_context, 
 						  bool debug, 
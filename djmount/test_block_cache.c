@@ -0,0 +1,149 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/* $Id$
+ *
+ * Testing BlockCache - shared cache for remote files content.
+ * This file is part of djmount.
+ *
+ * (C) Copyright 2026 djmount contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+ 
+#include <config.h>
+
+#include "block_cache.h"
+#include "talloc_util.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <upnp/ithread.h>
+
+
+#undef NDEBUG
+#include <assert.h>
+
+
+#define NB_MEM_BLOCKS	2
+#define NB_DISK_BLOCKS	4
+#define NB_THREADS	8
+
+static const char* const URL = "http://test.url/file";
+
+static int g_nb_fetch = 0;
+
+
+static int fetch (void* arg, off_t offset, char* buffer, size_t size, 
+		  size_t* nread)
+{
+	__sync_fetch_and_add (&g_nb_fetch, 1);
+	if (arg)
+		usleep (100000); // slow network
+	memset (buffer, 'a' + offset / BLOCK_CACHE_BLOCK_SIZE, size);
+	*nread = size;
+	return 0;
+}
+
+// Read a block, and returns the number of fetch needed (0 or 1)
+static int read_block (const char* url, int i)
+{
+	static char buffer [BLOCK_CACHE_BLOCK_SIZE];
+	int const nb_fetch = g_nb_fetch;
+	size_t n = 0;
+	int rc = BlockCache_Read (url, i, BLOCK_CACHE_BLOCK_SIZE, buffer, &n, 
+				  fetch, NULL);
+	assert (rc == 0);
+	assert (n == BLOCK_CACHE_BLOCK_SIZE);
+	assert (buffer[0] == 'a' + i && buffer[n-1] == 'a' + i);
+	return g_nb_fetch - nb_fetch;
+}
+
+static void* read_block_thread (void* arg)
+{
+	char* const buffer = malloc (BLOCK_CACHE_BLOCK_SIZE);
+	size_t n = 0;
+	int rc = BlockCache_Read (URL, 10, BLOCK_CACHE_BLOCK_SIZE, buffer, &n, 
+				  fetch, "slow");
+	assert (rc == 0 && n == BLOCK_CACHE_BLOCK_SIZE);
+	assert (buffer[0] == 'a' + 10 && buffer[n-1] == 'a' + 10);
+	free (buffer);
+	return NULL;
+}
+
+
+int 
+main (int argc, char* argv[])
+{
+	char dir[] = "/tmp/test_block_cache.XXXXXX";
+	assert (mkdtemp (dir) != NULL);
+
+	// Not initialised : always fetch
+	assert (! BlockCache_IsEnabled());
+	assert (read_block (URL, 0) == 1);
+	assert (read_block (URL, 0) == 1);
+
+	// Room for NB_DISK_BLOCKS blocks on disk (the URL is also stored)
+	int rc = BlockCache_Initialize 
+		(NB_MEM_BLOCKS * BLOCK_CACHE_BLOCK_SIZE, dir,
+		 NB_DISK_BLOCKS * (BLOCK_CACHE_BLOCK_SIZE + 100));
+	assert (rc == 0);
+	assert (BlockCache_IsEnabled());
+
+	int i;
+	for (i = 0; i < NB_DISK_BLOCKS; i++) 
+		assert (read_block (URL, i) == 1);
+	// From memory or disk
+	for (i = 0; i < NB_DISK_BLOCKS; i++) 
+		assert (read_block (URL, i) == 0);
+
+	// Other URL : not in cache
+	assert (read_block ("http://test.url/other", 0) == 1);
+
+	// Block 0 is now the least recently used on disk : evicted first
+	assert (read_block (URL, 1) == 0);
+	assert (read_block (URL, NB_DISK_BLOCKS) == 1);
+	assert (read_block (URL, 0) == 1);
+	assert (read_block (URL, 1) == 0);
+
+	// Concurrent misses on the same block : only one fetch
+	g_nb_fetch = 0;
+	ithread_t threads [NB_THREADS];
+	for (i = 0; i < NB_THREADS; i++) 
+		ithread_create (&threads[i], NULL, read_block_thread, NULL);
+	for (i = 0; i < NB_THREADS; i++) 
+		ithread_join (threads[i], NULL);
+	assert (g_nb_fetch == 1);
+
+	printf ("BlockCache Status = \n%s\n", 
+		BlockCache_GetStatusString (NULL));
+
+	// Delete cache directory
+	DIR* const d = opendir (dir);
+	assert (d != NULL);
+	struct dirent* de;
+	while ((de = readdir (d))) {
+		if (de->d_name[0] != '.') {
+			char path [sizeof (dir) + 256];
+			sprintf (path, "%s/%s", dir, de->d_name);
+			assert (unlink (path) == 0);
+		}
+	}
+	closedir (d);
+	assert (rmdir (dir) == 0);
+
+	exit (EXIT_SUCCESS);
+}
+
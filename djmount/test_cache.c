@@ -26,6 +26,7 @@
 #define TEST_CACHE 1
 #include "cache.h"
 #include <stdio.h>
+#include <string.h>
 #include "talloc_util.h"
 #include <unistd.h>
 
@@ -71,6 +72,20 @@ static void free_expired_data (const char* key, void* data)
 	talloc_free (data);
 }
 
+static bool match_prefix (const char* key, void* prefix)
+{
+	return (strncmp (key, prefix, strlen (prefix)) == 0);
+}
+
+static int nb_visited = 0;
+
+static void visit_entry (const char* key, void* data, void* first_key)
+{
+	// Most recently used entry first
+	if (nb_visited++ == 0)
+		assert (strcmp (key, first_key) == 0);
+}
+
 static void fill_cache (Cache* cache, bool create, int a, int b)
 {
 	int i;
@@ -122,17 +137,17 @@ main (int argc, char* argv[])
 	
 	sleep (AGE+1);
 
-	_Cache_PurgeExpiredEntries (cache0);
+	Cache_PurgeExpiredEntries (cache0);
 	assert (Cache_GetNrEntries (cache0) == 100);
 
-	_Cache_PurgeExpiredEntries (cache1);
+	Cache_PurgeExpiredEntries (cache1);
 	assert (Cache_GetNrEntries (cache1) == 0);
 
 	fill_cache (cache1, true, 0, 10);
 	assert (Cache_GetNrEntries (cache1) == 10);
 
 	sleep (AGE/2+1);
-	_Cache_PurgeExpiredEntries (cache1);
+	Cache_PurgeExpiredEntries (cache1);
 	assert (Cache_GetNrEntries (cache1) == 10);
 
 	fill_cache (cache1, true, 10, 20);
@@ -140,11 +155,71 @@ main (int argc, char* argv[])
 
 	sleep (AGE/2+1);
 
-	_Cache_PurgeExpiredEntries (cache1);
+	Cache_PurgeExpiredEntries (cache1);
+	assert (Cache_GetNrEntries (cache1) == 10);
+
+	assert (Cache_Remove (cache1, "[15]") == true);
+	assert (Cache_Remove (cache1, "[15]") == false);
+	assert (Cache_GetNrEntries (cache1) == 9);
+	fill_cache (cache1, true, 15, 16);
 	assert (Cache_GetNrEntries (cache1) == 10);
 
+	assert (Cache_RemoveMatching (cache0, match_prefix, "[1") == 11);
+	assert (Cache_GetNrEntries (cache0) == 89);
+	fill_cache (cache0, false, 20, 100);
+	fill_cache (cache0, true, 10, 20);
+	assert (Cache_GetNrEntries (cache0) == 99);
+
+	Cache_ForEach (cache0, visit_entry, "[19]");
+	assert (nb_visited == 99);
+
+	// Stale entries
+	Cache_SetMaxStale (cache1, 2*AGE);
+	sleep (AGE+1);
+	bool stale = false;
+	int** iptr = (int**) Cache_GetStale (cache1, "[12]", &stale);
+	assert (iptr != NULL && *iptr != NULL && **iptr == 12 && stale);
+	Cache_PurgeExpiredEntries (cache1);
+	assert (Cache_GetNrEntries (cache1) == 10);
+	assert (Cache_Remove (cache1, "[12]") == true);
+	fill_cache (cache1, true, 12, 13);
+	iptr = (int**) Cache_GetStale (cache1, "[12]", &stale);
+	assert (iptr != NULL && *iptr != NULL && ! stale);
+	sleep (2*AGE);
+	Cache_PurgeExpiredEntries (cache1);
+	assert (Cache_GetNrEntries (cache1) == 1);
+
+	// Size limits : least recently used entries are removed first
+	Cache* cache2 = Cache_Create (ctx, 10, AGE, free_expired_data);
+	assert (cache2 != NULL);
+	Cache_SetLimits (cache2, 5, 0, NULL);
+	fill_cache (cache2, true, 0, 5);
+	fill_cache (cache2, false, 0, 1);
+	fill_cache (cache2, true, 5, 6);
+	assert (Cache_GetNrEntries (cache2) == 5);
+	assert (*Cache_Get (cache2, "[0]") != NULL);
+	assert (*Cache_Get (cache2, "[1]") == NULL);
+	assert (Cache_GetNrEntries (cache2) == 5);
+	assert (*Cache_Get (cache2, "[2]") == NULL);
+	fill_cache (cache2, false, 4, 5);
+	assert (Cache_GetNrEntries (cache2) == 5);
+
+	// Memory : "[1]" and "[2]" have no data, "[5]" is removed
+	Cache_SetLimits (cache2, 0, 2 * sizeof (int), NULL);
+	assert (Cache_GetNrEntries (cache2) == 4);
+	assert (*Cache_Get (cache2, "[5]") == NULL);
+	assert (Cache_GetNrEntries (cache2) == 5);
+	*Cache_Get (cache2, "[6]") = talloc (cache2, int);
+	fill_cache (cache2, false, 4, 5);
+	assert (Cache_GetNrEntries (cache2) == 5);
+	assert (*Cache_Get (cache2, "[0]") == NULL);
+	
 	PRINT_CACHE (cache0);
 	PRINT_CACHE (cache1);
+	PRINT_CACHE (cache2);
+
+	assert (Cache_RemoveMatching (cache1, NULL, NULL) == 1);
+	assert (Cache_GetNrEntries (cache1) == 0);
 	
 	// Delete all storage
 	talloc_free (ctx);
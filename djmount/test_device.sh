@@ -96,6 +96,8 @@ diff -u -b -B - <(echo "$res" |egrep -v '(Discover|talloc)') <<EOF || fatal
             +- Cache size      = 1024
             +- Cache max age   = 60 seconds
             +- Cached entries  = 0 (0%)
+            +- Max entries     = 4096
+            +- Cache memory    = 0 KB (max 32768 KB)
             +- Cache access    = 0
 EOF
 
@@ -143,6 +145,8 @@ diff -u -b -B - <(echo "$res" |egrep -v '(Discover|talloc)') <<EOF || fatal
             +- Cache size      = 1024
             +- Cache max age   = 60 seconds
             +- Cached entries  = 0 (0%)
+            +- Max entries     = 4096
+            +- Cache memory    = 0 KB (max 32768 KB)
             +- Cache access    = 0
 EOF
 
@@ -192,6 +196,8 @@ diff -u -b -B - <(echo "$res" |egrep -v '(Discover|talloc)') <<EOF || fatal
             +- Cache size      = 1024
             +- Cache max age   = 60 seconds
             +- Cached entries  = 0 (0%)
+            +- Max entries     = 4096
+            +- Cache memory    = 0 KB (max 32768 KB)
             +- Cache access    = 0
 EOF
 
@@ -304,6 +310,8 @@ diff -u -b -B - <(echo "$res" |egrep -v '(Discover|talloc)') <<EOF || fatal
             +- Cache size      = 1024
             +- Cache max age   = 60 seconds
             +- Cached entries  = 0 (0%)
+            +- Max entries     = 4096
+            +- Cache memory    = 0 KB (max 32768 KB)
             +- Cache access    = 0
 EOF
 
@@ -410,6 +418,8 @@ diff -u -b -B - <(echo "$res" |egrep -v '(Discover|talloc)') <<EOF || fatal
             +- Cache size      = 1024
             +- Cache max age   = 60 seconds
             +- Cached entries  = 0 (0%)
+            +- Max entries     = 4096
+            +- Cache memory    = 0 KB (max 32768 KB)
             +- Cache access    = 0
 EOF
 
@@ -0,0 +1,152 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/* $Id$
+ *
+ * Testing the DIDL-Lite objects.
+ * This file is part of djmount.
+ *
+ * (C) Copyright 2026 djmount contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+ 
+#include <config.h>
+
+#include "didl_object.h"
+#include "ptr_array.h"
+#include "talloc_util.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#undef NDEBUG
+#include <assert.h>
+
+
+static const char* const DIDL = 
+	"<?xml version=\"1.0\"?>\n"
+	"<DIDL-Lite xmlns=\"urn:schemas-upnp-org:metadata-1-0/DIDL-Lite/\""
+	" xmlns:dc=\"http://purl.org/dc/elements/1.1/\""
+	" xmlns:upnp=\"urn:schemas-upnp-org:metadata-1-0/upnp/\">\n"
+	"<container id=\"1\" parentID=\"0\" searchable=\"1\">"
+	"<dc:title>Music &amp; Videos</dc:title>"
+	"<upnp:class> object.container </upnp:class></container>\n"
+	"<item id=\"2\" parentID=\"0\">"
+	"<dc:title>Song</dc:title><dc:title>Other title</dc:title>"
+	"<upnp:class>object.item.audioItem</upnp:class>"
+	"<res/>"
+	"<res protocolInfo=\"http-get:*:audio/mpeg:*\" size=\"1234\""
+	" duration=\"0:03:10\">http://host/a?x=1&amp;y=2</res>"
+	"<res protocolInfo=\"http-get:*:audio/wav:*\"></res>"
+	"</item>\n"
+	"<item parentID=\"0\"><dc:title>No id</dc:title></item>\n"
+	"<item id=\"4\"><dc:title>.hidden</dc:title></item>\n"
+	"</DIDL-Lite>\n";
+
+
+static void
+check_objects (PtrArray* containers, PtrArray* items)
+{
+	assert (PtrArray_GetSize (containers) == 1);
+	assert (PtrArray_GetSize (items) == 2);
+
+	const DIDLObject* o = PtrArray_GetElementAt (containers, 0);
+	assert (o->is_container && o->searchable);
+	assert (strcmp (o->id, "1") == 0);
+	assert (strcmp (o->title, "Music & Videos") == 0);
+	assert (strcmp (o->cds_class, "object.container") == 0);
+	assert (o->nb_res == 0);
+
+	// The first title is kept, the resources without URI are dropped
+	o = PtrArray_GetElementAt (items, 0);
+	assert (! o->is_container && ! o->searchable);
+	assert (strcmp (o->title, "Song") == 0);
+	assert (o->nb_res == 1);
+	assert (strcmp (o->res[0].uri, "http://host/a?x=1&y=2") == 0);
+	assert (strcmp (o->res[0].protocol_info, 
+			"http-get:*:audio/mpeg:*") == 0);
+	assert (o->res[0].size == 1234);
+	assert (strcmp (o->res[0].duration, "0:03:10") == 0);
+
+	// Reserved file name
+	o = PtrArray_GetElementAt (items, 1);
+	assert (strcmp (o->title, ".hidden") == 0);
+	assert (strcmp (o->basename, "-hidden") == 0);
+	assert (strcmp (o->cds_class, "") == 0);
+	assert (o->nb_res == 0);
+}
+
+
+int 
+main (int argc, char* argv[])
+{
+	void* const ctx = talloc_new (NULL);
+
+	// Objects with their XML source
+	PtrArray* containers = PtrArray_Create (ctx);
+	PtrArray* items = PtrArray_Create (ctx);
+	assert (DIDLObject_CreateList (DIDL, containers, items) == 4);
+	check_objects (containers, items);
+	const DIDLObject* o = PtrArray_GetElementAt (containers, 0);
+	assert (o->xml && strncmp (o->xml, "<container id=\"1\"", 17) == 0);
+	char* s = DIDLObject_GetElementString (o, ctx);
+	assert (strcmp (s, o->xml) == 0);
+
+	// Objects rebuilt from their fields, then parsed again 
+	DIDLObject_SetKeepXML (false);
+	PtrArray* const objects = PtrArray_Create (ctx);
+	assert (DIDLObject_CreateList (DIDL, objects, objects) == 4);
+	assert (PtrArray_GetSize (objects) == 3);
+	o = PtrArray_GetElementAt (objects, 0);
+	assert (o->xml == NULL);
+	s = DIDLObject_GetElementString (o, ctx);
+	assert (strcmp (s, "<container id=\"1\" searchable=\"1\">"
+			"<dc:title>Music &amp; Videos</dc:title>"
+			"<upnp:class>object.container</upnp:class>"
+			"</container>") == 0);
+	o = PtrArray_GetElementAt (objects, 1);
+	s = DIDLObject_GetElementString (o, ctx);
+	assert (strcmp (s, "<item id=\"2\"><dc:title>Song</dc:title>"
+			"<upnp:class>object.item.audioItem</upnp:class>"
+			"<res protocolInfo=\"http-get:*:audio/mpeg:*\""
+			" size=\"1234\" duration=\"0:03:10\">"
+			"http://host/a?x=1&amp;y=2</res></item>") == 0);
+
+	char* didl = talloc_strdup (ctx, "<DIDL-Lite>");
+	PTR_ARRAY_FOR_EACH_PTR (objects, o) {
+		s = DIDLObject_GetElementString (o, ctx);
+		didl = talloc_asprintf_append (didl, "%s", s);
+	} PTR_ARRAY_FOR_EACH_PTR_END;
+	didl = talloc_asprintf_append (didl, "</DIDL-Lite>");
+	containers = PtrArray_Create (ctx);
+	items = PtrArray_Create (ctx);
+	assert (DIDLObject_CreateList (didl, containers, items) == 3);
+	check_objects (containers, items);
+	DIDLObject_SetKeepXML (true);
+
+	// Not well-formed
+	PtrArray* const bad = PtrArray_Create (ctx);
+	assert (DIDLObject_CreateList ("<DIDL-Lite><item id=\"1\">", 
+				       bad, bad) == -1);
+	assert (DIDLObject_CreateList ("", bad, bad) == -1);
+
+	talloc_free (ctx);
+
+	size_t bytes = talloc_total_size (NULL);
+	assert (bytes == 0);
+
+	exit (EXIT_SUCCESS);
+}
+
@@ -0,0 +1,181 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/* $Id$
+ *
+ * Testing the SAX parser.
+ * This file is part of djmount.
+ *
+ * (C) Copyright 2026 djmount contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+ 
+#include <config.h>
+
+#include "sax_parser.h"
+#include "talloc_util.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#undef NDEBUG
+#include <assert.h>
+
+
+// Events printed as : "<depth:name att=value>", "[text]", "</depth:name>"
+static char* events = NULL;
+
+// Stop parsing at this element, if not NULL
+static const char* stop_at = NULL;
+
+static int
+start (void* user, int depth, const char* name, const char** atts,
+       const char* tag)
+{
+	assert (tag[0] == '<' && strncmp (tag + 1, name, strlen (name)) == 0);
+	events = talloc_asprintf_append (events, "<%d:%s", depth, name);
+	for (; *atts; atts += 2)
+		events = talloc_asprintf_append (events, " %s=%s", 
+						 atts[0], atts[1]);
+	events = talloc_asprintf_append (events, ">");
+	return (stop_at && strcmp (name, stop_at) == 0 ? 42 : 0);
+}
+
+static int
+end (void* user, int depth, const char* name, const char* tag_end)
+{
+	assert (tag_end[-1] == '>');
+	events = talloc_asprintf_append (events, "</%d:%s>", depth, name);
+	return 0;
+}
+
+static int
+text (void* user, int depth, const char* s, size_t len)
+{
+	events = talloc_asprintf_append (events, "[%.*s]", (int) len, s);
+	return 0;
+}
+
+static const SaxParser_Handler handler = { start, end, text };
+
+static int
+parse (const char* xml)
+{
+	talloc_free (events);
+	events = talloc_strdup (NULL, "");
+	return SaxParser_Parse (xml, &handler, NULL);
+}
+
+
+// Extract a slice of the document, with the "tag" and "tag_end" pointers
+static const char* slice_start = NULL;
+static char* slice = NULL;
+
+static int
+slice_start_cb (void* user, int depth, const char* name, const char** atts,
+		const char* tag)
+{
+	if (depth == 1)
+		slice_start = tag;
+	return 0;
+}
+
+static int
+slice_end_cb (void* user, int depth, const char* name, const char* tag_end)
+{
+	if (depth == 1)
+		slice = talloc_asprintf_append (slice, "{%.*s}", 
+						(int) (tag_end - slice_start),
+						slice_start);
+	return 0;
+}
+
+
+int 
+main (int argc, char* argv[])
+{
+	// Elements, attributes, texts
+	assert (parse ("<?xml version=\"1.0\"?>\n"
+		       "<!DOCTYPE a [ <!ENTITY x \"y\"> ]>\n"
+		       "<a x='1' y = \"2\"><!-- comment -->"
+		       "<b/> hello <c:d e=\"\"></c:d></a>\n") == 0);
+	assert (strcmp (events, "<0:a x=1 y=2><1:b></1:b>[ hello ]"
+			"<1:c:d e=></1:c:d></0:a>") == 0);
+
+	// Entities and CDATA
+	assert (parse ("\xEF\xBB\xBF<a t=\"&lt;&amp;&#65;&#x42;&quot;\">"
+		       "&gt;&apos;&#xE9;<![CDATA[<&amp;>]]></a>") == 0);
+	assert (strcmp (events, "<0:a t=<&AB\">[>'\xC3\xA9][<&amp;>]</0:a>")
+		== 0);
+
+	// Stop in a callback
+	stop_at = "c";
+	assert (parse ("<a><b/><c/><d/></a>") == 42);
+	assert (strcmp (events, "<0:a><1:b></1:b><1:c>") == 0);
+	stop_at = NULL;
+
+	// Not well-formed
+	assert (parse ("") == -1);
+	assert (parse ("text") == -1);
+	assert (parse ("<a>") == -1);
+	assert (parse ("<a></b>") == -1);
+	assert (parse ("<a></a><b/>") == -1);
+	assert (parse ("<a></a>text") == -1);
+	assert (parse ("<a x=1/>") == -1);
+	assert (parse ("<a x=\"1/>") == -1);
+	assert (parse ("<a>&unknown;</a>") == -1);
+	assert (parse ("<a>& </a>") == -1);
+	assert (parse ("<a><!-- </a>") == -1);
+	assert (parse ("<a></a></a>") == -1);
+	assert (parse ("< a/>") == -1);
+
+	// Raw slices of the root children
+	slice = talloc_strdup (NULL, "");
+	const SaxParser_Handler slicer = { 
+		.start = slice_start_cb, .end = slice_end_cb 
+	};
+	assert (SaxParser_Parse ("<r><i a='1'>x<j/></i>\n<k/></r>", 
+				 &slicer, NULL) == 0);
+	assert (strcmp (slice, "{<i a='1'>x<j/></i>}{<k/>}") == 0);
+	talloc_free (slice);
+
+	// Deep nesting, many attributes
+	char* xml = talloc_strdup (NULL, "");
+	int i;
+	for (i = 0; i < 1000; i++)
+		xml = talloc_asprintf_append (xml, "<e%d a%d='%d'>", i, i, i);
+	for (i = 999; i >= 0; i--)
+		xml = talloc_asprintf_append (xml, "</e%d>", i);
+	assert (parse (xml) == 0);
+	assert (strstr (events, "<999:e999 a999=999></999:e999>") != NULL);
+	talloc_free (xml);
+	xml = talloc_strdup (NULL, "<a");
+	for (i = 0; i < 100; i++)
+		xml = talloc_asprintf_append (xml, " a%d='%d'", i, i);
+	xml = talloc_asprintf_append (xml, "/>");
+	assert (parse (xml) == 0);
+	assert (strstr (events, " a0=0 a1=1 ") && 
+		strstr (events, " a99=99></0:a>"));
+	talloc_free (xml);
+
+	talloc_free (events);
+	events = NULL;
+
+	size_t bytes = talloc_total_size (NULL);
+	assert (bytes == 0);
+
+	exit (EXIT_SUCCESS);
+}
+
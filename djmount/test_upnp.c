@@ -299,10 +299,10 @@ process_command (const char* cmdline)
 					  CONTENT_DIR_BROWSE_DIRECT_CHILDREN);
 		if (res) {
 			const DIDLObject* o = NULL;
-			PTR_ARRAY_FOR_EACH_PTR (res->children->objects, o) {
+			CONTENT_DIR_CHILDREN_FOR_EACH (res->children, o) {
 				Log_Printf (LOG_MAIN, "%6s \"%s\"", 
 					    NN(o->id), NN(o->basename));
-			} PTR_ARRAY_FOR_EACH_PTR_END;
+			} CONTENT_DIR_CHILDREN_FOR_EACH_END;
 		}
 	}
 	break;
@@ -316,7 +316,8 @@ process_command (const char* cmdline)
 					  CONTENT_DIR_BROWSE_METADATA);
 		if (res && res->children) {
 			const DIDLObject* const o = 
-				PtrArray_GetHead (res->children->objects);
+				ContentDir_Children_GetObject 
+				(res->children, 0);
 			if (o) {
 				Log_Printf (LOG_MAIN, "metadata = %s",
 					    DIDLObject_GetElementString 
@@ -363,9 +364,9 @@ process_command (const char* cmdline)
 					  tmp_ctx, strarg[2], strarg[3]);
 		if (res) {
 			const DIDLObject* o = NULL;
-			PTR_ARRAY_FOR_EACH_PTR (res->children->objects, o) {
+			CONTENT_DIR_CHILDREN_FOR_EACH (res->children, o) {
 				Log_Printf (LOG_MAIN, "  %s", NN(o->basename));
-			} PTR_ARRAY_FOR_EACH_PTR_END;
+			} CONTENT_DIR_CHILDREN_FOR_EACH_END;
 		}
 		break;
 	}
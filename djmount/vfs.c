@@ -37,6 +37,8 @@
 #include "content_dir.h"
 #include "device_list.h"
 #include "xml_util.h"
+#include "cache.h"
+#include "ptr_array.h"
 
 
 
@@ -48,6 +50,15 @@ static const off_t DEFAULT_SIZE = 0;
 static const time_t DEFAULT_TIME = 946724400; // Y2K
 
 
+// Number of entries in the node table. Set to zero to deactivate it.
+#define NODE_CACHE_SIZE		4096
+
+// Node table timeout, in seconds, counted from when the node is stored.
+// The nodes are derived from Browse results, so use the same timeout,
+// and see VFS_InvalidateContents when these results change.
+#define NODE_CACHE_TIMEOUT	CONTENT_DIR_CACHE_TIMEOUT
+
+
 
 /*****************************************************************************
  * vfs_match_start_of_path
@@ -62,7 +73,7 @@ vfs_match_start_of_path (const char* path, const char* name)
 		path += len; 
 		while (*path == '/') 
 			path++;					
-		Log_Printf (LOG_DEBUG, "matched '%s' left '%s'", name, path);
+		LOG_PRINTF (LOG_DEBUG, "matched '%s' left '%s'", name, path);
 		return path;
 	}
 	return NULL;
@@ -78,6 +89,8 @@ vfs_dir_begin (register const VFS_Query* const q)
 {
 	int rc = 0;
 
+	if (q->node)
+		*(q->node) = (VFS_Node) { .cacheable = false };
 	if (q->stbuf) {
 		q->stbuf->st_mode  = S_IFDIR | 0555;
 		q->stbuf->st_nlink = 2;			
@@ -90,7 +103,7 @@ vfs_dir_begin (register const VFS_Query* const q)
 			rc = q->filler (q->h, "..", DT_DIR, 0);	
 	}
 	if (q->lnk_buf) {
-		Log_Printf (LOG_DEBUG, "error, readlink on directory : '%s'", 
+		LOG_PRINTF (LOG_DEBUG, "error, readlink on directory : '%s'", 
 			    q->path);
 		rc = -EINVAL;
 	}
@@ -107,9 +120,11 @@ vfs_file_begin (int const d_type, register const VFS_Query* const q)
 {
 	int rc = 0;
 
-	Log_Printf (LOG_DEBUG, "%s_BEGIN '%s'", 
+	LOG_PRINTF (LOG_DEBUG, "%s_BEGIN '%s'", 
 		    (d_type == DT_LNK ? "SYMLINK" : "FILE"), q->path);    
 	
+	if (q->node)
+		*(q->node) = (VFS_Node) { .cacheable = false };
 	if (q->stbuf) {	
 		q->stbuf->st_mode  = DTTOIF(d_type) | 0444;     
 		q->stbuf->st_nlink = 1;
@@ -117,7 +132,7 @@ vfs_file_begin (int const d_type, register const VFS_Query* const q)
 		vfs_set_time (DEFAULT_TIME, q);
 	}
 	if (q->filler) {
-		Log_Printf (LOG_DEBUG, "error, listing not a directory : '%s'",
+		LOG_PRINTF (LOG_DEBUG, "error, listing not a directory : '%s'",
 			    q->path);
 		rc = -ENOTDIR;
 	}
@@ -129,7 +144,7 @@ vfs_file_begin (int const d_type, register const VFS_Query* const q)
 			if (q->lnk_bufsiz > 0) 
 				*(q->lnk_buf) = NUL;
 		} else {
-			Log_Printf (LOG_DEBUG, 
+			LOG_PRINTF (LOG_DEBUG, 
 				    "error, readlink on regular file : '%s'", 
 				    q->path);
 			rc = -EINVAL;
@@ -179,9 +194,13 @@ vfs_file_set_url (const char* const url, off_t size,
 					 q->path, location);
 		}
 	}
+	if (q->node) {
+		q->node->url  = url;
+		q->node->size = size;
+	}
 	if (size >= 0 && q->stbuf) {	
 		q->stbuf->st_size = size;
-		Log_Printf (LOG_DEBUG, "FILE_SET_URL size = %" PRIdMAX,	
+		LOG_PRINTF (LOG_DEBUG, "FILE_SET_URL size = %" PRIdMAX,	
 			    (intmax_t) size);
 	} 
 }
@@ -274,21 +293,129 @@ BrowseDebug (VFS* const self, const char* const sub_path,
 }
 
 
+/*****************************************************************************
+ * free_expired_node
+ *****************************************************************************/
+static void 
+free_expired_node (const char* key, void* data)
+{
+	talloc_free (data);
+}
+
+
+/*****************************************************************************
+ * LookupNode
+ *
+ * Description:
+ *	Answer the query from the node table, if possible.
+ *	Returns true if found.
+ *
+ *****************************************************************************/
+static bool
+LookupNode (VFS* const self, const VFS_Query* q)
+{
+	// Note: listings and symlinks are not in the node table
+	if (self->nodes == NULL || q->filler || q->lnk_buf)
+		return false; // ---------->
+	
+	ithread_mutex_lock (&self->nodes_mutex);
+	VFS_Node** const np = (VFS_Node**) Cache_Get (self->nodes, q->path);
+	const VFS_Node* const node = (np ? *np : NULL);
+	bool const found = (node && (q->file == NULL || node->url));
+	if (found) {
+		if (q->cacheable)
+			*(q->cacheable) = true;
+		if (q->stbuf)
+			*(q->stbuf) = node->st;
+		if (q->contents)
+			*(q->contents) = talloc_strdup (q->talloc_context,
+							node->contents);
+		if (q->file) {
+			*(q->file) = FileBuffer_CreateFromURL 
+				(q->talloc_context, node->url, node->size);
+			if (*(q->file))
+				talloc_set_name (*(q->file), 
+						 "file[%s] from node table",
+						 q->path);
+		}
+	}
+	ithread_mutex_unlock (&self->nodes_mutex);
+
+	if (found)
+		LOG_PRINTF (LOG_DEBUG, "fuse browse : '%s' in node table",
+			    q->path);
+	return found;
+}
+
+
+/*****************************************************************************
+ * StoreNode
+ *
+ * Description:
+ *	Store a resolved node in the node table, unless the table has been
+ *	invalidated since "generation" (the node may then be out-of-date).
+ *
+ *****************************************************************************/
+static void
+StoreNode (VFS* const self, const char* path, const VFS_Node* resolved,
+	   unsigned long generation)
+{
+	if (! (S_ISDIR (resolved->st.st_mode) || resolved->url))
+		return; // ---------->
+
+	ithread_mutex_lock (&self->nodes_mutex);
+	VFS_Node** const np = (self->nodes_generation != generation ? NULL :
+			       (VFS_Node**) Cache_Get (self->nodes, path));
+	if (np) {
+		talloc_free (*np);
+		*np = talloc (self->nodes, VFS_Node);
+		if (*np) {
+			**np = *resolved;
+			(*np)->url = talloc_strdup (*np, resolved->url);
+			(*np)->source = talloc_strdup (*np, resolved->source);
+			(*np)->contents = talloc_strdup (*np, 
+							 resolved->contents);
+		}
+	}
+	ithread_mutex_unlock (&self->nodes_mutex);
+}
+
+
 /*****************************************************************************
  * VFS_Browse
  *****************************************************************************/
 
 int
-VFS_Browse (VFS* const self, const VFS_Query* q)
+VFS_Browse (VFS* const self, const VFS_Query* query)
 {
-	if (q == NULL || q->path == NULL || *(q->path) == NUL)
+	if (query == NULL || query->path == NULL || *(query->path) == NUL)
 		return -EFAULT; // ---------->
 
-	Log_Printf (LOG_DEBUG, "fuse browse : looking for '%s' ...", q->path);
+	if (LookupNode (self, query))
+		return 0; // ---------->
+
+	unsigned long generation = 0;
+	if (self->nodes) {
+		ithread_mutex_lock (&self->nodes_mutex);
+		generation = self->nodes_generation;
+		ithread_mutex_unlock (&self->nodes_mutex);
+	}
+
+	LOG_PRINTF (LOG_DEBUG, "fuse browse : looking for '%s' ...", 
+		    query->path);
 	
 	// Create a working context for temporary memory allocations
 	void* tmp_ctx = talloc_new (NULL);
 	
+	// Resolve the attributes in any case, for the node table
+	VFS_Node node = { .cacheable = false };
+	struct stat st = { .st_mode = 0 };
+	VFS_Query q_node = *query;
+	q_node.node = &node;
+	if (q_node.stbuf == NULL)
+		q_node.stbuf = &st;
+	const VFS_Query* const q = &q_node;
+
 	BROWSE_BEGIN(q->path, q) {
 		_DIR_BEGIN("", true) {
 			VFS_BrowseFunction func = 
@@ -321,17 +448,30 @@ VFS_Browse (VFS* const self, const VFS_Query* q)
 		s.rc = -ENOENT;
 	}
 
-	// Delete all temporary storage
-	talloc_free (tmp_ctx);
-	tmp_ctx = NULL;
-	
 	// Adjust some fields
-	if (s.rc == 0 && q->stbuf) {
+	if (s.rc == 0) {
 		q->stbuf->st_blocks = (q->stbuf->st_size + 511) / 512;
 	}
 	
+	// Keep the node for the next queries. 
+	// Note: not from a listing, which does not resolve the url.
+	if (s.rc == 0 && node.cacheable && q->filler == NULL && self->nodes) {
+		node.st = *(q->stbuf);
+		StoreNode (self, q->path, &node, generation);
+	}
+	if (q->cacheable)
+		*(q->cacheable) = (s.rc == 0 && node.cacheable);
+	if (q->contents)
+		*(q->contents) = (s.rc == 0 ? talloc_strdup (q->talloc_context,
+							     node.contents)
+				  : NULL);
+
+	// Delete all temporary storage
+	talloc_free (tmp_ctx);
+	tmp_ctx = NULL;
+	
 	if (s.rc) 
-		Log_Printf (LOG_DEBUG, "fuse browse => error %d (%s) : "
+		LOG_PRINTF (LOG_DEBUG, "fuse browse => error %d (%s) : "
 			    "path='%s', stops at='%s'", 
 			    s.rc, strerror (-s.rc), q->path, s.ptr);
 	
@@ -339,6 +479,130 @@ VFS_Browse (VFS* const self, const VFS_Query* q)
 }
 
 
+/*****************************************************************************
+ * VFS_Invalidate
+ *****************************************************************************/
+
+static bool
+is_path_or_below (const char* key, void* path)
+{
+	size_t const len = strlen (path);
+	return (strncmp (key, path, len) == 0 && 
+		(key[len] == NUL || key[len] == '/'));
+}
+
+void
+VFS_Invalidate (VFS* const self, const char* path)
+{
+	if (self == NULL || self->nodes == NULL || path == NULL)
+		return; // ---------->
+
+	// Paths in the table start with '/'
+	const char* const p = (path[0] == '/' && path[1] != NUL ? path : "");
+	
+	ithread_mutex_lock (&self->nodes_mutex);
+	self->nodes_generation++;
+	long const n = (*p ? Cache_RemoveMatching (self->nodes, 
+						   is_path_or_below, 
+						   discard_const_p (char, p))
+			: Cache_RemoveMatching (self->nodes, NULL, NULL));
+	ithread_mutex_unlock (&self->nodes_mutex);
+
+	LOG_PRINTF (LOG_DEBUG, "VFS invalidate '%s' : %ld nodes removed",
+		    path, n);
+}
+
+
+/*****************************************************************************
+ * VFS_InvalidateContents
+ *****************************************************************************/
+
+typedef struct _ContentsMatch {
+	const char*	path;
+	const char*	contents;
+	PtrArray*	paths;
+} ContentsMatch;
+
+static void
+match_contents (const char* key, void* data, void* visit_data)
+{
+	const VFS_Node* const node = (const VFS_Node*) data;
+	ContentsMatch* const m = (ContentsMatch*) visit_data;
+	if (node && is_path_or_below (key, discard_const_p (char, m->path)) &&
+	    ( (node->source && strcmp (node->source, m->contents) == 0) ||
+	      (node->contents && strcmp (node->contents, m->contents) == 0) ))
+		PtrArray_Append (m->paths, talloc_strdup (m->paths, key));
+}
+
+void
+VFS_InvalidateContents (VFS* const self, const char* path, 
+			const char* contents)
+{
+	if (self == NULL || self->nodes == NULL || path == NULL)
+		return; // ---------->
+	if (contents == NULL) {
+		VFS_Invalidate (self, path);
+		return; // ---------->
+	}
+
+	ContentsMatch m = { 
+		.path     = (path[0] == '/' && path[1] != NUL ? path : ""),
+		.contents = contents,
+		.paths    = PtrArray_Create (NULL),
+	};
+	if (m.paths == NULL) {
+		VFS_Invalidate (self, path);
+		return; // ---------->
+	}
+
+	long n = 0;
+	ithread_mutex_lock (&self->nodes_mutex);
+	self->nodes_generation++;
+	Cache_ForEach (self->nodes, match_contents, &m);
+	// Remove the matching nodes, and the nodes below them : their paths
+	// may not exist anymore.
+	const char* p;
+	PTR_ARRAY_FOR_EACH_PTR (m.paths, p) {
+		if (p) {
+			long const r = Cache_RemoveMatching 
+				(self->nodes, is_path_or_below, 
+				 discard_const_p (char, p));
+			if (r > 0)
+				n += r;
+		}
+	} PTR_ARRAY_FOR_EACH_PTR_END;
+	ithread_mutex_unlock (&self->nodes_mutex);
+	talloc_free (m.paths);
+
+	LOG_PRINTF (LOG_DEBUG, "VFS invalidate '%s' contents='%s' : "
+		    "%ld nodes removed", path, contents, n);
+}
+
+
+/*****************************************************************************
+ * finalize
+ *
+ * Description: 
+ *	VFS destructor
+ *
+ *****************************************************************************/
+static void
+finalize (Object* obj)
+{
+	VFS* const self = (VFS*) obj;
+
+	if (self && self->nodes) {
+		// Stop the cache janitor before the mutex is destroyed
+		talloc_free (self->nodes);
+		self->nodes = NULL;
+		ithread_mutex_destroy (&self->nodes_mutex);
+	}
+
+	// Other "talloc'ed" fields will be deleted automatically : 
+	// nothing to do 
+}
+
+
 /*****************************************************************************
  * OBJECT_INIT_CLASS
  *****************************************************************************/
@@ -347,6 +611,7 @@ VFS_Browse (VFS* const self, const VFS_Query* q)
 static void
 init_class (VFS_Class* const isa)
 {
+	CLASS_BASE_CAST(isa)->finalize = finalize;
         isa->browse_root  = NULL;
         isa->browse_debug = BrowseDebug;
 }
@@ -363,6 +628,17 @@ VFS_Create (void* talloc_context, bool show_debug_dir)
 	OBJECT_SUPER_CONSTRUCT (VFS, Object_Create, talloc_context, NULL);
         if (self) {
 		self->show_debug_dir = show_debug_dir;
+		
+		if (NODE_CACHE_SIZE > 0 && NODE_CACHE_TIMEOUT > 0) {
+			self->nodes = Cache_Create (self, NODE_CACHE_SIZE,
+						    NODE_CACHE_TIMEOUT,
+						    free_expired_node);
+			if (self->nodes) {
+				ithread_mutex_init (&self->nodes_mutex, NULL);
+				Cache_StartJanitor (self->nodes, 
+						    &self->nodes_mutex);
+			}
+		}
 	}
 	return self;
 }
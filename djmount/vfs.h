@@ -64,6 +64,20 @@ typedef struct _VFS_Query {
 	 * STAT 
 	 */
 	struct stat* stbuf; 
+
+	/*
+	 * optional, for all operations : set to true if the result 
+	 * only depends on cached Browse results, i.e. should not change
+	 * before CONTENT_DIR_CACHE_TIMEOUT (unless the cache is invalidated)
+	 */
+	bool* cacheable;
+
+	/*
+	 * optional, for all operations : set to the identifier of the 
+	 * Browse results listed by the directory (see VFS_SET_CONTENTS), 
+	 * allocated in "talloc_context", or NULL if none
+	 */
+	char** contents;
 	
 	/* 
 	 * GETDIR 
@@ -83,6 +97,11 @@ typedef struct _VFS_Query {
 	char*	lnk_buf;
 	size_t	lnk_bufsiz;
 
+	/*
+	 * private : node being resolved, set by VFS_Browse
+	 */
+	struct _VFS_Node* node;
+
 } VFS_Query;
 
 
@@ -112,6 +131,45 @@ int
 VFS_Browse (VFS* self, const VFS_Query* query);
 
 
+/*****************************************************************************
+ * @fn 		VFS_Invalidate
+ * @brief	drop the resolved nodes of a path, and of all the paths 
+ *		below it, from the node table (see VFS_Query "cacheable").
+ *
+ *	To be called when the content they were derived from has changed
+ *	(e.g. the Browse results of a device). Browse in progress do not
+ *	store their result in the node table.
+ *	This function does not lock anything else than the node table,
+ *	so it can be called from any thread, with any lock held.
+ *
+ * @param self		the VFS object
+ * @param path		the path, "/" for the whole file system
+ *
+ *****************************************************************************/
+void
+VFS_Invalidate (VFS* self, const char* path);
+
+
+/*****************************************************************************
+ * @fn 		VFS_InvalidateContents
+ * @brief	drop, from the node table, the resolved nodes at or below 
+ *		a path which have been derived from the Browse results 
+ *		"contents", or which list them (see VFS_Query "contents"),
+ *		with all the paths below these nodes.
+ *
+ *	As VFS_Invalidate, when only some Browse results have changed 
+ *	(e.g. a ContentDirectory container). Same locking as VFS_Invalidate.
+ *
+ * @param self		the VFS object
+ * @param path		the path, "/" for the whole file system
+ * @param contents	the identifier of the Browse results, or NULL 
+ *			to invalidate all the nodes below "path"
+ *
+ *****************************************************************************/
+void
+VFS_InvalidateContents (VFS* self, const char* path, const char* contents);
+
+
 
 #endif // VFS_H_INCLUDED
 
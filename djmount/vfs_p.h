@@ -27,6 +27,7 @@
 
 #include "vfs.h"
 #include "object_p.h"
+#include <upnp/ithread.h>
 
 #include <errno.h>
 #include <dirent.h>
@@ -46,10 +47,29 @@
 OBJECT_DEFINE_STRUCT(VFS,
 		     
 		     bool show_debug_dir;
+
+		     struct _Cache*  nodes;	// path -> VFS_Node
+		     ithread_mutex_t nodes_mutex;
+		     unsigned long   nodes_generation; // see VFS_Invalidate
 		     
                      );
 
 
+/*
+ * Node resolved by a browse operation, kept in the node table 
+ * if it is "cacheable" (see VFS_SET_CACHEABLE) : directory, or file 
+ * with URL content.
+ */
+typedef struct _VFS_Node {
+	bool		cacheable;
+	struct stat	st;
+	const char*	url;	// NULL if not a file with URL content
+	off_t		size;
+	const char*	source;	  // see VFS_SET_CACHEABLE
+	const char*	contents; // see VFS_SET_CONTENTS, NULL if none
+} VFS_Node;
+
+
 typedef struct _VFS_BrowseStatus {
     int rc;
     const char* ptr;
@@ -134,6 +154,24 @@ vfs_symlink_set_path (const char* const p, register const VFS_Query* const q);
 extern void
 vfs_set_time (const time_t t, register const VFS_Query* const q);
 
+static inline void
+vfs_set_cacheable (const char* const source, 
+		   register const VFS_Query* const q)
+{
+	if (q->node) {
+		q->node->cacheable = true;
+		q->node->source = source;
+	}
+}
+
+static inline void
+vfs_set_contents (const char* const contents, 
+		  register const VFS_Query* const q)
+{
+	if (q->node)
+		q->node->contents = contents;
+}
+
 
 
 /*****************************************************************************
@@ -237,6 +275,25 @@ vfs_set_time (const time_t t, register const VFS_Query* const q);
 
 #define VFS_SET_TIME(TIME_T)	vfs_set_time (TIME_T, _q)
 
+/*
+ * Mark the current directory or file as depending only on cached Browse
+ * results : if it is the last component of the path, the result is kept 
+ * in the node table, and the next queries on this path do not browse 
+ * the tree again (until CONTENT_DIR_CACHE_TIMEOUT, or until the results
+ * "SOURCE" it has been found in change : see VFS_InvalidateContents). 
+ * The string shall be valid until the end of the browse operation.
+ */
+#define VFS_SET_CACHEABLE(SOURCE)	vfs_set_cacheable (SOURCE, _q)
+
+/*
+ * Set the identifier of the Browse results listed by the current 
+ * directory (e.g. the ContentDirectory container id), so that the caches
+ * of this directory can be dropped when these results change (see 
+ * VFS_Query "contents"). The string shall be valid until the end of 
+ * the browse operation.
+ */
+#define VFS_SET_CONTENTS(ID)	vfs_set_contents (ID, _q)
+
 
 
 #endif // VFS_P_INCLUDED
@@ -106,7 +106,7 @@ XMLUtil_FindFirstElement (const IXML_Node* const node,
 			res = findFirstElementRecursive (n, tagname, deep);
 		}
 		if (res == NULL) {
-			Log_Printf ((log_error ? LOG_ERROR : LOG_DEBUG), 
+			LOG_PRINTF ((log_error ? LOG_ERROR : LOG_DEBUG), 
 				    "Can't find '%s' element in XML Node"
 				    " (deep search=%d)", tagname, (int) deep);
 		}
@@ -177,3 +177,40 @@ XMLUtil_GetNodeString (void* context, const IXML_Node* node)
 }
 
 
+/*****************************************************************************
+ * XMLUtil_Escape
+ *****************************************************************************/
+char*
+XMLUtil_Escape (void* context, const char* s)
+{
+	if (s == NULL)
+		return NULL; // ---------->
+
+	size_t len = 0;
+	const char* p;
+	for (p = s; *p; p++)
+		len += (*p == '<' || *p == '>' ? 4 : *p == '&' ? 5 : 
+			*p == '"' || *p == '\'' ? 6 : 1);
+	char* const ret = talloc_size (context, len + 1);
+	if (ret) {
+		char* q = ret;
+		for (p = s; *p; p++) {
+			const char* e = NULL;
+			switch (*p) {
+			case '<':  e = "&lt;";   break;
+			case '>':  e = "&gt;";   break;
+			case '&':  e = "&amp;";  break;
+			case '"':  e = "&quot;"; break;
+			case '\'': e = "&apos;"; break;
+			default:   *q++ = *p;	 break;
+			}
+			if (e) {
+				strcpy (q, e);
+				q += strlen (e);
+			}
+		}
+		*q = '\0';
+	}
+	return ret;
+}
+
@@ -149,6 +149,15 @@ char*
 XMLUtil_GetNodeString (void* talloc_context, IN const IXML_Node* node);
 
 
+/*****************************************************************************
+ * @brief Returns a copy of a string where the XML special characters
+ *	  are replaced by entities, for use in a text or attribute value.
+ * 	  The returned string should be freed using "talloc_free".
+ *****************************************************************************/
+char*
+XMLUtil_Escape (void* talloc_context, const char* s);
+
+
 
 
 #ifdef __cplusplus
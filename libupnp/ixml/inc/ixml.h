@@ -169,6 +169,8 @@ typedef struct _IXML_Node
 typedef struct _IXML_Document
 {
     IXML_Node    n;
+    struct _IXML_Arena *arena;  // memory of the nodes, NULL if each node
+                                // is allocated separately
 } IXML_Document;
 
 typedef struct _IXML_CDATASection
@@ -197,8 +199,9 @@ typedef struct _IXML_Text
 
 typedef struct _IXML_NodeList
 {
-    IXML_Node    *nodeItem;
-    struct  _IXML_NodeList *next;
+    IXML_Node     **items;
+    unsigned long length;
+    unsigned long capacity;
 } IXML_NodeList;
 
 
@@ -610,6 +613,8 @@ ixmlNode_hasAttributes(IXML_Node *node
                       );
 
   /** Frees a {\bf Node} and all {\bf Node}s in its subtree.
+   *  A {\bf Node} removed from its {\bf Document} must be freed before 
+   *  the {\bf Document} itself.
    *
    *  @return [void] This function does not return a value.
    */
@@ -1649,7 +1654,7 @@ ixmlNamedNodeMap_free(IXML_NamedNodeMap *nnMap
 //@{
 
   /** Retrieves a {\bf Node} from a {\bf NodeList} specified by a 
-   *  numerical index.
+   *  numerical index, in constant time.
    *
    *  @return [Node*] A pointer to a {\bf Node} or {\tt NULL} if there was an 
    *                  error.
@@ -1797,6 +1802,40 @@ ixmlParseBufferEx(char *buffer,
 		        parses or {\bf NULL} on an error. */
                 );
 
+  /** Parses an XML text buffer converting it into an IXML DOM representation,
+   *  allocated in an arena.
+   *
+   *  The {\bf ixmlParseBufferArenaEx} API differs from the 
+   *  {\bf ixmlParseBufferEx} API in that the nodes and strings of the 
+   *  document are allocated in a few large blocks instead of one by one, 
+   *  and are all released at once by {\bf ixmlDocument_free}. This is 
+   *  faster, and fragments the heap less, for documents which are parsed, 
+   *  read and then discarded.
+   *
+   *  The document can still be modified, but the memory of the removed 
+   *  or replaced nodes and values is only reclaimed when the document is 
+   *  freed. No node of the document (even removed from it) can be used 
+   *  after {\bf ixmlDocument_free}, except clones.
+   *
+   *  @return [int] An integer representing one of the following:
+   *    \begin{itemize}
+   *      \item {\tt IXML_SUCCESS}: The operation completed successfully.
+   *      \item {\tt IXML_INVALID_PARAMETER}: The {\bf buffer} is not a valid 
+   *            pointer.
+   *      \item {\tt IXML_INSUFFICIENT_MEMORY}: Not enough free memory exists 
+   *            to complete this operation.
+   *    \end{itemize}
+   */
+
+int
+ixmlParseBufferArenaEx(char *buffer, 
+		    /** The buffer that contains the XML text to convert to a 
+		        {\bf Document}. */
+                  IXML_Document** doc 
+		    /** A point to store the {\bf Document} if file correctly 
+		        parses or {\bf NULL} on an error. */
+                );
+
   /** Parses an XML text file converting it into an IXML DOM representation.
    *
    *  @return [Document*] A {\bf Document} if the file correctly parses or 
@@ -55,10 +55,85 @@ ixmlDocument_init( IN IXML_Document * doc )
 void
 ixmlDocument_free( IN IXML_Document * doc )
 {
-    if( doc != NULL ) {
+    ixml_arena *arena;
+
+    if( doc == NULL ) {
+        return;
+    }
+
+    arena = doc->arena;
+    if( arena == NULL ) {
         ixmlNode_free( ( IXML_Node * ) doc );
+    } else {
+        // only free the nodes allocated outside the arena (if any),
+        // then all the arena at once (including the document itself)
+        if( arena->mixed ) {
+            ixmlNode_free( doc->n.firstChild );
+        }
+        ixml_arena_destroy( arena );
     }
+}
 
+/*================================================================
+*   ixmlDocument_allocMem
+*       Allocates memory for a node (or a node field) of the
+*       document : in the document arena if any, else in the heap.
+*       doc may be NULL.
+*       Internal function.
+*
+*=================================================================*/
+void *
+ixmlDocument_allocMem( IN IXML_Document * doc,
+                       IN size_t size )
+{
+    if( doc != NULL && doc->arena != NULL ) {
+        return ixml_arena_alloc( doc->arena, size );
+    }
+    return malloc( size );
+}
+
+/*================================================================
+*   ixmlDocument_strdup
+*       Copies a string, for a node field of the document.
+*       Internal function.
+*
+*=================================================================*/
+char *
+ixmlDocument_strdup( IN IXML_Document * doc,
+                     IN const char *s )
+{
+    char *copy;
+    size_t len;
+
+    if( doc == NULL || doc->arena == NULL ) {
+        return strdup( s );
+    }
+
+    len = strlen( s ) + 1;
+    copy = ( char * )ixml_arena_alloc( doc->arena, len );
+    if( copy != NULL ) {
+        memcpy( copy, s, len );
+    }
+    return copy;
+}
+
+/*================================================================
+*   ixmlDocument_freeMem
+*       Frees memory allocated by ixmlDocument_allocMem or 
+*       ixmlDocument_strdup, or by malloc (e.g. nodes cloned outside
+*       of the document, then inserted). Memory in the document arena
+*       is only freed with the whole document.
+*       Internal function.
+*
+*=================================================================*/
+void
+ixmlDocument_freeMem( IN IXML_Document * doc,
+                      IN void *p )
+{
+    if( doc != NULL && ixml_arena_owns( doc->arena, p ) ) {
+        return;
+    }
+    free( p );
 }
 
 /*================================================================
@@ -127,6 +202,10 @@ ixmlDocument_importNode( IN IXML_Document * doc,
         return IXML_FAILED;
     }
 
+    // the clone is allocated in the heap, not in the document arena
+    if( doc->arena != NULL ) {
+        doc->arena->mixed = TRUE;
+    }
     ixmlDocument_setOwnerDocument( doc, newNode );
     *rtNode = newNode;
 
@@ -160,14 +239,17 @@ ixmlDocument_createElementEx( IN IXML_Document * doc,
         goto ErrorHandler;
     }
 
-    newElement = ( IXML_Element * ) malloc( sizeof( IXML_Element ) );
+    newElement =
+        ( IXML_Element * ) ixmlDocument_allocMem( doc,
+                                                  sizeof( IXML_Element ) );
     if( newElement == NULL ) {
         errCode = IXML_INSUFFICIENT_MEMORY;
         goto ErrorHandler;
     }
 
     ixmlElement_init( newElement );
-    newElement->tagName = strdup( tagName );
+    newElement->n.ownerDocument = doc;
+    newElement->tagName = ixmlDocument_strdup( doc, tagName );
     if( newElement->tagName == NULL ) {
         ixmlElement_free( newElement );
         newElement = NULL;
@@ -176,7 +258,7 @@ ixmlDocument_createElementEx( IN IXML_Document * doc,
     }
     // set the node fields 
     newElement->n.nodeType = eELEMENT_NODE;
-    newElement->n.nodeName = strdup( tagName );
+    newElement->n.nodeName = ixmlDocument_strdup( doc, tagName );
     if( newElement->n.nodeName == NULL ) {
         ixmlElement_free( newElement );
         newElement = NULL;
@@ -184,8 +266,6 @@ ixmlDocument_createElementEx( IN IXML_Document * doc,
         goto ErrorHandler;
     }
 
-    newElement->n.ownerDocument = doc;
-
   ErrorHandler:
     *rtElement = newElement;
     return errCode;
@@ -228,20 +308,48 @@ ixmlDocument_createElement( IN IXML_Document * doc,
 *=================================================================*/
 int
 ixmlDocument_createDocumentEx( OUT IXML_Document ** rtDoc )
+{
+    return ixmlDocument_createArenaDocumentEx( NULL, rtDoc );
+}
+
+/*================================================================
+*   ixmlDocument_createArenaDocumentEx
+*       Creates an document object, whose nodes are allocated in
+*       the given arena (the document takes ownership of it).
+*       Internal function.
+*   Parameters:
+*       arena:  the arena, or NULL to allocate each node separately
+*       rtDoc:  the document created or NULL on failure
+*   Return Value:
+*       IXML_SUCCESS
+*       IXML_INSUFFICIENT_MEMORY:   if not enough memory to finish this operations.
+*
+*=================================================================*/
+int
+ixmlDocument_createArenaDocumentEx( IN ixml_arena * arena,
+                                    OUT IXML_Document ** rtDoc )
 {
     IXML_Document *doc;
     int errCode = IXML_SUCCESS;
 
     doc = NULL;
-    doc = ( IXML_Document * ) malloc( sizeof( IXML_Document ) );
+    if( arena != NULL ) {
+        doc = ( IXML_Document * ) ixml_arena_alloc( arena,
+                                                    sizeof
+                                                    ( IXML_Document ) );
+    } else {
+        doc = ( IXML_Document * ) malloc( sizeof( IXML_Document ) );
+    }
     if( doc == NULL ) {
+        ixml_arena_destroy( arena );
         errCode = IXML_INSUFFICIENT_MEMORY;
         goto ErrorHandler;
     }
 
     ixmlDocument_init( doc );
+    doc->arena = arena;
 
-    doc->n.nodeName = strdup( DOCUMENTNODENAME );
+    doc->n.nodeName = ixmlDocument_strdup( doc, DOCUMENTNODENAME );
     if( doc->n.nodeName == NULL ) {
         ixmlDocument_free( doc );
         doc = NULL;
@@ -304,15 +412,17 @@ ixmlDocument_createTextNodeEx( IN IXML_Document * doc,
         goto ErrorHandler;
     }
 
-    returnNode = ( IXML_Node * ) malloc( sizeof( IXML_Node ) );
+    returnNode = ( IXML_Node * ) ixmlDocument_allocMem( doc,
+                                                        sizeof( IXML_Node ) );
     if( returnNode == NULL ) {
         rc = IXML_INSUFFICIENT_MEMORY;
         goto ErrorHandler;
     }
     // initialize the node
     ixmlNode_init( returnNode );
+    returnNode->ownerDocument = doc;
 
-    returnNode->nodeName = strdup( TEXTNODENAME );
+    returnNode->nodeName = ixmlDocument_strdup( doc, TEXTNODENAME );
     if( returnNode->nodeName == NULL ) {
         ixmlNode_free( returnNode );
         returnNode = NULL;
@@ -321,7 +431,7 @@ ixmlDocument_createTextNodeEx( IN IXML_Document * doc,
     }
     // add in node value
     if( data != NULL ) {
-        returnNode->nodeValue = strdup( data );
+        returnNode->nodeValue = ixmlDocument_strdup( doc, data );
         if( returnNode->nodeValue == NULL ) {
             ixmlNode_free( returnNode );
             returnNode = NULL;
@@ -331,7 +441,6 @@ ixmlDocument_createTextNodeEx( IN IXML_Document * doc,
     }
 
     returnNode->nodeType = eTEXT_NODE;
-    returnNode->ownerDocument = doc;
 
   ErrorHandler:
     *textNode = returnNode;
@@ -379,25 +488,25 @@ ixmlDocument_createAttributeEx( IN IXML_Document * doc,
     IXML_Attr *attrNode = NULL;
     int errCode = IXML_SUCCESS;
 
-    attrNode = ( IXML_Attr * ) malloc( sizeof( IXML_Attr ) );
-    if( attrNode == NULL ) {
-        errCode = IXML_INSUFFICIENT_MEMORY;
+    if( ( doc == NULL ) || ( name == NULL ) ) {
+        errCode = IXML_INVALID_PARAMETER;
         goto ErrorHandler;
     }
 
-    if( ( doc == NULL ) || ( name == NULL ) ) {
-        ixmlAttr_free( attrNode );
-        attrNode = NULL;
-        errCode = IXML_INVALID_PARAMETER;
+    attrNode = ( IXML_Attr * ) ixmlDocument_allocMem( doc,
+                                                      sizeof( IXML_Attr ) );
+    if( attrNode == NULL ) {
+        errCode = IXML_INSUFFICIENT_MEMORY;
         goto ErrorHandler;
     }
 
     ixmlAttr_init( attrNode );
 
     attrNode->n.nodeType = eATTRIBUTE_NODE;
+    attrNode->n.ownerDocument = doc;
 
     // set the node fields
-    attrNode->n.nodeName = strdup( name );
+    attrNode->n.nodeName = ixmlDocument_strdup( doc, name );
     if( attrNode->n.nodeName == NULL ) {
         ixmlAttr_free( attrNode );
         attrNode = NULL;
@@ -405,8 +514,6 @@ ixmlDocument_createAttributeEx( IN IXML_Document * doc,
         goto ErrorHandler;
     }
 
-    attrNode->n.ownerDocument = doc;
-
   ErrorHandler:
     *rtAttr = attrNode;
     return errCode;
@@ -470,7 +577,7 @@ ixmlDocument_createAttributeNSEx( IN IXML_Document * doc,
         goto ErrorHandler;
     }
     // set the namespaceURI field 
-    attrNode->n.namespaceURI = strdup( namespaceURI );
+    attrNode->n.namespaceURI = ixmlDocument_strdup( doc, namespaceURI );
     if( attrNode->n.namespaceURI == NULL ) {
         ixmlAttr_free( attrNode );
         attrNode = NULL;
@@ -543,7 +650,9 @@ ixmlDocument_createCDATASectionEx( IN IXML_Document * doc,
     }
 
     cDSectionNode =
-        ( IXML_CDATASection * ) malloc( sizeof( IXML_CDATASection ) );
+        ( IXML_CDATASection * ) ixmlDocument_allocMem( doc,
+                                                       sizeof
+                                                       ( IXML_CDATASection ) );
     if( cDSectionNode == NULL ) {
         errCode = IXML_INSUFFICIENT_MEMORY;
         goto ErrorHandler;
@@ -552,7 +661,8 @@ ixmlDocument_createCDATASectionEx( IN IXML_Document * doc,
     ixmlCDATASection_init( cDSectionNode );
 
     cDSectionNode->n.nodeType = eCDATA_SECTION_NODE;
-    cDSectionNode->n.nodeName = strdup( CDATANODENAME );
+    cDSectionNode->n.ownerDocument = doc;
+    cDSectionNode->n.nodeName = ixmlDocument_strdup( doc, CDATANODENAME );
     if( cDSectionNode->n.nodeName == NULL ) {
         ixmlCDATASection_free( cDSectionNode );
         cDSectionNode = NULL;
@@ -560,7 +670,7 @@ ixmlDocument_createCDATASectionEx( IN IXML_Document * doc,
         goto ErrorHandler;
     }
 
-    cDSectionNode->n.nodeValue = strdup( data );
+    cDSectionNode->n.nodeValue = ixmlDocument_strdup( doc, data );
     if( cDSectionNode->n.nodeValue == NULL ) {
         ixmlCDATASection_free( cDSectionNode );
         cDSectionNode = NULL;
@@ -568,8 +678,6 @@ ixmlDocument_createCDATASectionEx( IN IXML_Document * doc,
         goto ErrorHandler;
     }
 
-    cDSectionNode->n.ownerDocument = doc;
-
   ErrorHandler:
     *rtCD = cDSectionNode;
     return errCode;
@@ -633,7 +741,7 @@ ixmlDocument_createElementNSEx( IN IXML_Document * doc,
         goto ErrorHandler;
     }
     // set the namespaceURI field 
-    newElement->n.namespaceURI = strdup( namespaceURI );
+    newElement->n.namespaceURI = ixmlDocument_strdup( doc, namespaceURI );
     if( newElement->n.namespaceURI == NULL ) {
         ixmlElement_free( newElement );
         newElement = NULL;
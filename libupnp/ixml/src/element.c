@@ -81,10 +81,11 @@ ixmlElement_setTagName( IN IXML_Element * element,
     }
 
     if( element->tagName != NULL ) {
-        free( element->tagName );
+        ixmlDocument_freeMem( element->n.ownerDocument, element->tagName );
     }
 
-    element->tagName = strdup( tagName );
+    element->tagName = ixmlDocument_strdup( element->n.ownerDocument,
+                                            tagName );
     if( element->tagName == NULL ) {
         rc = IXML_INSUFFICIENT_MEMORY;
     }
@@ -179,7 +180,8 @@ ixmlElement_setAttribute( IN IXML_Element * element,
 
         attrNode = ( IXML_Node * ) newAttrNode;
 
-        attrNode->nodeValue = strdup( value );
+        attrNode->nodeValue = ixmlDocument_strdup( attrNode->ownerDocument,
+                                                   value );
         if( attrNode->nodeValue == NULL ) {
             ixmlAttr_free( newAttrNode );
             errCode = IXML_INSUFFICIENT_MEMORY;
@@ -195,10 +197,12 @@ ixmlElement_setAttribute( IN IXML_Element * element,
 
     } else {
         if( attrNode->nodeValue != NULL ) { // attribute name has a value already
-            free( attrNode->nodeValue );
+            ixmlDocument_freeMem( attrNode->ownerDocument,
+                                  attrNode->nodeValue );
         }
 
-        attrNode->nodeValue = strdup( value );
+        attrNode->nodeValue = ixmlDocument_strdup( attrNode->ownerDocument,
+                                                   value );
         if( attrNode->nodeValue == NULL ) {
             errCode = IXML_INSUFFICIENT_MEMORY;
         }
@@ -241,7 +245,8 @@ ixmlElement_removeAttribute( IN IXML_Element * element,
 
     if( attrNode != NULL ) {    // has the attribute
         if( attrNode->nodeValue != NULL ) {
-            free( attrNode->nodeValue );
+            ixmlDocument_freeMem( attrNode->ownerDocument,
+                                  attrNode->nodeValue );
             attrNode->nodeValue = NULL;
         }
     }
@@ -607,22 +612,26 @@ ixmlElement_setAttributeNS( IN IXML_Element * element,
 
     if( attrNode != NULL ) {
         if( attrNode->prefix != NULL ) {
-            free( attrNode->prefix );   // remove the old prefix
+            // remove the old prefix
+            ixmlDocument_freeMem( attrNode->ownerDocument, attrNode->prefix );
         }
         // replace it with the new prefix
-        attrNode->prefix = strdup( newAttrNode.prefix );
+        attrNode->prefix = ixmlDocument_strdup( attrNode->ownerDocument,
+                                                newAttrNode.prefix );
         if( attrNode->prefix == NULL ) {
             Parser_freeNodeContent( &newAttrNode );
             return IXML_INSUFFICIENT_MEMORY;
         }
 
         if( attrNode->nodeValue != NULL ) {
-            free( attrNode->nodeValue );
+            ixmlDocument_freeMem( attrNode->ownerDocument,
+                                  attrNode->nodeValue );
         }
 
-        attrNode->nodeValue = strdup( value );
+        attrNode->nodeValue = ixmlDocument_strdup( attrNode->ownerDocument,
+                                                   value );
         if( attrNode->nodeValue == NULL ) {
-            free( attrNode->prefix );
+            ixmlDocument_freeMem( attrNode->ownerDocument, attrNode->prefix );
             Parser_freeNodeContent( &newAttrNode );
             return IXML_INSUFFICIENT_MEMORY;
         }
@@ -637,7 +646,8 @@ ixmlElement_setAttributeNS( IN IXML_Element * element,
             return rc;
         }
 
-        newAttr->n.nodeValue = strdup( value );
+        newAttr->n.nodeValue = ixmlDocument_strdup( newAttr->n.ownerDocument,
+                                                    value );
         if( newAttr->n.nodeValue == NULL ) {
             ixmlAttr_free( newAttr );
             return IXML_INSUFFICIENT_MEMORY;
@@ -694,7 +704,8 @@ ixmlElement_removeAttributeNS( IN IXML_Element * element,
 
     if( attrNode != NULL ) {    // has the attribute
         if( attrNode->nodeValue != NULL ) {
-            free( attrNode->nodeValue );
+            ixmlDocument_freeMem( attrNode->ownerDocument,
+                                  attrNode->nodeValue );
             attrNode->nodeValue = NULL;
         }
     }
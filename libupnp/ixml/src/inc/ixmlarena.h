@@ -0,0 +1,72 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2026 djmount contributors
+// All rights reserved. 
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met: 
+//
+// * Redistributions of source code must retain the above copyright notice, 
+// this list of conditions and the following disclaimer. 
+// * Redistributions in binary form must reproduce the above copyright notice, 
+// this list of conditions and the following disclaimer in the documentation 
+// and/or other materials provided with the distribution. 
+// * Neither name of Intel Corporation nor the names of its contributors 
+// may be used to endorse or promote products derived from this software 
+// without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR 
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL INTEL OR 
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR 
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY 
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS 
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef _IXML_ARENA_H
+#define _IXML_ARENA_H
+
+#include <stdlib.h>
+#include "ixml.h"
+
+/*
+ * Arena of memory, holding the nodes of a parsed document (see
+ * ixmlParseBufferArenaEx). Memory is allocated by bumping a pointer in 
+ * large chunks, and is only released when the whole arena is destroyed.
+ */
+
+typedef struct _ixml_arena_chunk
+{
+	struct _ixml_arena_chunk	*next;
+	size_t				size;
+	size_t				used;
+	// data follows
+} ixml_arena_chunk;
+
+typedef struct _IXML_Arena // ixml_arena
+{
+	ixml_arena_chunk	*chunks;	// current chunk first
+	size_t			next_size;
+
+	// TRUE if some nodes of the document have been allocated outside
+	// the arena (e.g. cloned, then inserted in the document)
+	BOOL			mixed;
+
+} ixml_arena;
+
+//--------------------------------------------------
+//////////////// functions /////////////////////////
+//--------------------------------------------------
+
+ixml_arena *ixml_arena_create(IN size_t size_hint);
+void ixml_arena_destroy(INOUT ixml_arena *a);
+void *ixml_arena_alloc(INOUT ixml_arena *a, IN size_t size);
+BOOL ixml_arena_owns(IN const ixml_arena *a, IN const void *p);
+
+#endif // _IXML_ARENA_H
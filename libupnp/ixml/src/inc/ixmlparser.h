@@ -34,6 +34,7 @@
 
 #include "ixml.h"
 #include "ixmlmembuf.h"
+#include "ixmlarena.h"
 
 // Parser definitions
 #define QUOT        "&quot;"
@@ -83,18 +84,25 @@ typedef struct _Parser
     PARSER_STATE        state;
 
     BOOL                bHasTopLevel;
+    BOOL                bArena;         // allocate the document in an arena
 
 } Parser;
 
 
 
-int     Parser_LoadDocument( IXML_Document **retDoc, char * xmlFile, BOOL file);
+int     Parser_LoadDocument( IXML_Document **retDoc, char * xmlFile, BOOL file,
+                             BOOL arena);
 BOOL    Parser_isValidXmlName( DOMString name);
 int     Parser_setNodePrefixAndLocalName(IXML_Node *newIXML_NodeIXML_Attr);
 void    Parser_freeNodeContent( IXML_Node *IXML_Nodeptr);
 
 void    Parser_setErrorChar( char c );
 
+int     ixmlDocument_createArenaDocumentEx(ixml_arena *arena, IXML_Document **rtDoc);
+void   *ixmlDocument_allocMem(IXML_Document *doc, size_t size);
+char   *ixmlDocument_strdup(IXML_Document *doc, const char *s);
+void    ixmlDocument_freeMem(IXML_Document *doc, void *p);
+
 void    ixmlAttr_free(IXML_Attr *attrNode);
 void    ixmlAttr_init(IXML_Attr *attrNode);
 
@@ -113,7 +121,10 @@ void    ixmlNode_getElementsByTagNameNS( IXML_Node *IXML_Node, char *namespaceUR
 int     ixmlNode_setNodeProperties(IXML_Node* node, IXML_Node *src);
 int     ixmlNode_setNodeName( IXML_Node* node, DOMString qualifiedName);
 
+#define NODELIST_MIN_CAPACITY   8
+
 void    ixmlNodeList_init(IXML_NodeList *nList);
+int     ixmlNodeList_reserve(IXML_NodeList **nList, unsigned long capacity);
 int     ixmlNodeList_addToNodeList(IXML_NodeList **nList, IXML_Node *add);
 
 #endif  // _IXMLPARSER_H
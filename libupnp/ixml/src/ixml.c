@@ -332,7 +332,7 @@ ixmlLoadDocumentEx( IN char *xmlFile,
         return IXML_INVALID_PARAMETER;
     }
 
-    return Parser_LoadDocument( doc, xmlFile, TRUE );
+    return Parser_LoadDocument( doc, xmlFile, TRUE, FALSE );
 }
 
 /*================================================================
@@ -429,7 +429,30 @@ ixmlParseBufferEx( IN char *buffer,
         return IXML_INVALID_PARAMETER;
     }
 
-    return Parser_LoadDocument( retDoc, buffer, FALSE );
+    return Parser_LoadDocument( retDoc, buffer, FALSE, FALSE );
+}
+
+/*================================================================
+*   ixmlParseBufferArenaEx
+*       Parse xml file stored in buffer, allocating the document
+*       in an arena.
+*       External function.
+*
+*=================================================================*/
+int
+ixmlParseBufferArenaEx( IN char *buffer,
+                        IXML_Document ** retDoc )
+{
+
+    if( ( buffer == NULL ) || ( retDoc == NULL ) ) {
+        return IXML_INVALID_PARAMETER;
+    }
+
+    if( strlen( buffer ) == 0 ) {
+        return IXML_INVALID_PARAMETER;
+    }
+
+    return Parser_LoadDocument( retDoc, buffer, FALSE, TRUE );
 }
 
 /*================================================================
@@ -0,0 +1,204 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2026 djmount contributors
+// All rights reserved. 
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met: 
+//
+// * Redistributions of source code must retain the above copyright notice, 
+// this list of conditions and the following disclaimer. 
+// * Redistributions in binary form must reproduce the above copyright notice, 
+// this list of conditions and the following disclaimer in the documentation 
+// and/or other materials provided with the distribution. 
+// * Neither name of Intel Corporation nor the names of its contributors 
+// may be used to endorse or promote products derived from this software 
+// without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR 
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL INTEL OR 
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR 
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY 
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS 
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ixmlarena.h"
+#include "ixmlmembuf.h"
+
+// Alignment of the allocated blocks
+typedef union 
+{
+	void	*p;
+	long	l;
+	double	d;
+} ixml_arena_align;
+
+#define ARENA_ALIGN		sizeof( ixml_arena_align )
+#define ARENA_ROUND( s )	( ( (s) + ARENA_ALIGN - 1 ) & ~( ARENA_ALIGN - 1 ) )
+#define ARENA_HEADER		ARENA_ROUND( sizeof( ixml_arena_chunk ) )
+#define ARENA_DATA( c )		( (char *)(c) + ARENA_HEADER )
+
+#define ARENA_MIN_SIZE		4096
+#define ARENA_MAX_SIZE		( 1024 * 1024 )
+
+/*================================================================
+*   ixml_arena_add_chunk
+*
+*   Allocates a new chunk, with at least 'size' bytes available,
+*   and makes it the current one.
+*
+*   returns:
+*       the new chunk, or NULL if not enough memory
+*
+*=================================================================*/
+static ixml_arena_chunk *
+ixml_arena_add_chunk( INOUT ixml_arena * a,
+                      IN size_t size )
+{
+    ixml_arena_chunk *c;
+    size_t chunk_size = MAXVAL( a->next_size, size );
+
+    c = ( ixml_arena_chunk * ) malloc( ARENA_HEADER + chunk_size );
+    if( c == NULL ) {
+        return NULL;
+    }
+
+    c->size = chunk_size;
+    c->used = 0;
+    c->next = a->chunks;
+    a->chunks = c;
+
+    // grow geometrically, so that the number of chunks stays small
+    if( a->next_size < ARENA_MAX_SIZE ) {
+        a->next_size *= 2;
+    }
+
+    return c;
+}
+
+/*================================================================
+*   ixml_arena_create
+*
+*   Creates an arena. 'size_hint' is the expected amount of
+*   memory needed, or 0 if unknown.
+*
+*   returns:
+*       the arena, or NULL if not enough memory
+*
+*=================================================================*/
+ixml_arena *
+ixml_arena_create( IN size_t size_hint )
+{
+    ixml_arena *a;
+
+    a = ( ixml_arena * ) malloc( sizeof( ixml_arena ) );
+    if( a == NULL ) {
+        return NULL;
+    }
+
+    a->chunks = NULL;
+    a->next_size = MINVAL( MAXVAL( ARENA_ROUND( size_hint ),
+                                   ARENA_MIN_SIZE ), ARENA_MAX_SIZE );
+    a->mixed = FALSE;
+
+    if( ixml_arena_add_chunk( a, 0 ) == NULL ) {
+        free( a );
+        return NULL;
+    }
+
+    return a;
+}
+
+/*================================================================
+*   ixml_arena_destroy
+*
+*   Releases all the memory allocated in the arena.
+*
+*=================================================================*/
+void
+ixml_arena_destroy( INOUT ixml_arena * a )
+{
+    ixml_arena_chunk *c;
+    ixml_arena_chunk *next;
+
+    if( a == NULL ) {
+        return;
+    }
+
+    for( c = a->chunks; c != NULL; c = next ) {
+        next = c->next;
+        free( c );
+    }
+    free( a );
+}
+
+/*================================================================
+*   ixml_arena_alloc
+*
+*   Allocates 'size' bytes in the arena. The memory can not be 
+*   freed individually.
+*
+*   returns:
+*       the memory, or NULL if not enough memory
+*
+*=================================================================*/
+void *
+ixml_arena_alloc( INOUT ixml_arena * a,
+                  IN size_t size )
+{
+    ixml_arena_chunk *c;
+    void *p;
+
+    assert( a != NULL );
+
+    size = ARENA_ROUND( MAXVAL( size, 1 ) );
+    c = a->chunks;
+    if( c == NULL || c->size - c->used < size ) {
+        c = ixml_arena_add_chunk( a, size );
+        if( c == NULL ) {
+            return NULL;
+        }
+    }
+
+    p = ARENA_DATA( c ) + c->used;
+    c->used += size;
+    return p;
+}
+
+/*================================================================
+*   ixml_arena_owns
+*
+*   returns:
+*       TRUE if 'p' has been allocated in the arena.
+*
+*=================================================================*/
+BOOL
+ixml_arena_owns( IN const ixml_arena * a,
+                 IN const void *p )
+{
+    const ixml_arena_chunk *c;
+
+    if( a == NULL || p == NULL ) {
+        return FALSE;
+    }
+
+    for( c = a->chunks; c != NULL; c = c->next ) {
+        const char *const data = ARENA_DATA( c );
+
+        if( ( const char * )p >= data && ( const char * )p < data + c->used ) {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
@@ -648,7 +648,8 @@ Parser_readFileOrBuffer( IN Parser * xmlParser,
 int
 Parser_LoadDocument( OUT IXML_Document ** retDoc,
                      IN char *xmlFileName,
-                     IN BOOL file )
+                     IN BOOL file,
+                     IN BOOL arena )
 {
     int rc = IXML_SUCCESS;
     Parser *xmlParser = NULL;
@@ -665,6 +666,7 @@ Parser_LoadDocument( OUT IXML_Document ** retDoc,
     }
 
     xmlParser->curPtr = xmlParser->dataBuffer;
+    xmlParser->bArena = arena;
     rc = Parser_parseDocument( retDoc, xmlParser );
     return rc;
 
@@ -904,7 +906,18 @@ Parser_parseDocument( OUT IXML_Document ** retDoc,
 
     ixmlNode_init( &newNode );
 
-    rc = ixmlDocument_createDocumentEx( &gRootDoc );
+    if( xmlParser->bArena ) {
+        // the nodes and their names take a few times the size of the text
+        ixml_arena *arena =
+            ixml_arena_create( 4 * strlen( xmlParser->dataBuffer ) );
+        if( arena == NULL ) {
+            rc = IXML_INSUFFICIENT_MEMORY;
+            goto ErrorHandler;
+        }
+        rc = ixmlDocument_createArenaDocumentEx( arena, &gRootDoc );
+    } else {
+        rc = ixmlDocument_createDocumentEx( &gRootDoc );
+    }
     if( rc != IXML_SUCCESS ) {
         goto ErrorHandler;
     }
@@ -1606,7 +1619,8 @@ Parser_addNamespace( IN Parser * xmlParser )
             // it would be wrong that pNode->namespace != NULL.
             assert( pNode->namespaceURI == NULL );
 
-            pNode->namespaceURI = strdup( pCur->namespaceUri );
+            pNode->namespaceURI = ixmlDocument_strdup( pNode->ownerDocument,
+                                                       pCur->namespaceUri );
             if( pNode->namespaceURI == NULL ) {
                 return IXML_INSUFFICIENT_MEMORY;
             }
@@ -1622,7 +1636,8 @@ Parser_addNamespace( IN Parser * xmlParser )
 
         namespaceUri = Parser_getNameSpace( xmlParser, pCur->prefix );
         if( namespaceUri != NULL ) {
-            pNode->namespaceURI = strdup( namespaceUri );
+            pNode->namespaceURI = ixmlDocument_strdup( pNode->ownerDocument,
+                                                       namespaceUri );
             if( pNode->namespaceURI == NULL ) {
                 return IXML_INSUFFICIENT_MEMORY;
             }
@@ -1657,7 +1672,8 @@ Parser_setNodePrefixAndLocalName( IN IXML_Node * node )
     pStrPrefix = strchr( node->nodeName, ':' );
     if( pStrPrefix == NULL ) {
         node->prefix = NULL;
-        node->localName = strdup( node->nodeName );
+        node->localName = ixmlDocument_strdup( node->ownerDocument,
+                                               node->nodeName );
         if( node->localName == NULL ) {
             return IXML_INSUFFICIENT_MEMORY;
         }
@@ -1666,7 +1682,8 @@ Parser_setNodePrefixAndLocalName( IN IXML_Node * node )
 
         pLocalName = ( char * )pStrPrefix + 1;
         nPrefix = pStrPrefix - node->nodeName;
-        node->prefix = malloc( nPrefix + 1 );
+        node->prefix = ixmlDocument_allocMem( node->ownerDocument,
+                                              nPrefix + 1 );
         if( node->prefix == NULL ) {
             return IXML_INSUFFICIENT_MEMORY;
         }
@@ -1674,9 +1691,10 @@ Parser_setNodePrefixAndLocalName( IN IXML_Node * node )
         memset( node->prefix, 0, nPrefix + 1 );
         strncpy( node->prefix, node->nodeName, nPrefix );
 
-        node->localName = strdup( pLocalName );
+        node->localName = ixmlDocument_strdup( node->ownerDocument,
+                                               pLocalName );
         if( node->localName == NULL ) {
-            free( node->prefix );
+            ixmlDocument_freeMem( node->ownerDocument, node->prefix );
             node->prefix = NULL;    //no need to free really, main loop will frees it
             //when return code is not success
             return IXML_INSUFFICIENT_MEMORY;
@@ -2002,7 +2020,8 @@ Parser_setElementNamespace( IN IXML_Element * newElement,
         if( newElement->n.namespaceURI != NULL ) {
             return IXML_SYNTAX_ERR;
         } else {
-            ( newElement->n ).namespaceURI = strdup( nsURI );
+            ( newElement->n ).namespaceURI =
+                ixmlDocument_strdup( newElement->n.ownerDocument, nsURI );
             if( ( newElement->n ).namespaceURI == NULL ) {
                 return IXML_INSUFFICIENT_MEMORY;
             }
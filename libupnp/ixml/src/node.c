@@ -81,34 +81,37 @@ void
 ixmlNode_freeSingleNode( IN IXML_Node * nodeptr )
 {
     IXML_Element *element = NULL;
+    IXML_Document *doc;
 
     if( nodeptr != NULL ) {
+        doc = nodeptr->ownerDocument;
+
         if( nodeptr->nodeName != NULL ) {
-            free( nodeptr->nodeName );
+            ixmlDocument_freeMem( doc, nodeptr->nodeName );
         }
 
         if( nodeptr->nodeValue != NULL ) {
-            free( nodeptr->nodeValue );
+            ixmlDocument_freeMem( doc, nodeptr->nodeValue );
         }
 
         if( nodeptr->namespaceURI != NULL ) {
-            free( nodeptr->namespaceURI );
+            ixmlDocument_freeMem( doc, nodeptr->namespaceURI );
         }
 
         if( nodeptr->prefix != NULL ) {
-            free( nodeptr->prefix );
+            ixmlDocument_freeMem( doc, nodeptr->prefix );
         }
 
         if( nodeptr->localName != NULL ) {
-            free( nodeptr->localName );
+            ixmlDocument_freeMem( doc, nodeptr->localName );
         }
 
         if( nodeptr->nodeType == eELEMENT_NODE ) {
             element = ( IXML_Element * ) nodeptr;
-            free( element->tagName );
+            ixmlDocument_freeMem( doc, element->tagName );
         }
 
-        free( nodeptr );
+        ixmlDocument_freeMem( doc, nodeptr );
 
     }
 }
@@ -122,7 +125,21 @@ ixmlNode_freeSingleNode( IN IXML_Node * nodeptr )
 void
 ixmlNode_free( IN IXML_Node * nodeptr )
 {
+    IXML_Document *doc;
+
     if( nodeptr != NULL ) {
+        doc = nodeptr->ownerDocument;
+        if( doc != NULL && doc->arena != NULL ) {
+            if( nodeptr->nodeType == eDOCUMENT_NODE ) {
+                ixmlDocument_free( ( IXML_Document * ) nodeptr );
+                return;
+            }
+            // the whole subtree is in the arena, freed with the document
+            if( !doc->arena->mixed ) {
+                return;
+            }
+        }
+
         ixmlNode_free( nodeptr->firstChild );
         ixmlNode_free( nodeptr->nextSibling );
         ixmlNode_free( nodeptr->firstAttr );
@@ -183,12 +200,14 @@ ixmlNode_setNamespaceURI( IN IXML_Node * nodeptr,
     }
 
     if( nodeptr->namespaceURI != NULL ) {
-        free( nodeptr->namespaceURI );
+        ixmlDocument_freeMem( nodeptr->ownerDocument,
+                              nodeptr->namespaceURI );
         nodeptr->namespaceURI = NULL;
     }
 
     if( namespaceURI != NULL ) {
-        nodeptr->namespaceURI = strdup( namespaceURI );
+        nodeptr->namespaceURI =
+            ixmlDocument_strdup( nodeptr->ownerDocument, namespaceURI );
         if( nodeptr->namespaceURI == NULL ) {
             return IXML_INSUFFICIENT_MEMORY;
         }
@@ -215,12 +234,13 @@ ixmlNode_setPrefix( IN IXML_Node * nodeptr,
     }
 
     if( nodeptr->prefix != NULL ) {
-        free( nodeptr->prefix );
+        ixmlDocument_freeMem( nodeptr->ownerDocument, nodeptr->prefix );
         nodeptr->prefix = NULL;
     }
 
     if( prefix != NULL ) {
-        nodeptr->prefix = strdup( prefix );
+        nodeptr->prefix = ixmlDocument_strdup( nodeptr->ownerDocument,
+                                               prefix );
         if( nodeptr->prefix == NULL ) {
             return IXML_INSUFFICIENT_MEMORY;
         }
@@ -246,12 +266,13 @@ ixmlNode_setLocalName( IN IXML_Node * nodeptr,
     assert( nodeptr != NULL );
 
     if( nodeptr->localName != NULL ) {
-        free( nodeptr->localName );
+        ixmlDocument_freeMem( nodeptr->ownerDocument, nodeptr->localName );
         nodeptr->localName = NULL;
     }
 
     if( localName != NULL ) {
-        nodeptr->localName = strdup( localName );
+        nodeptr->localName = ixmlDocument_strdup( nodeptr->ownerDocument,
+                                                  localName );
         if( nodeptr->localName == NULL ) {
             return IXML_INSUFFICIENT_MEMORY;
         }
@@ -339,12 +360,13 @@ ixmlNode_setNodeValue( IN IXML_Node * nodeptr,
     }
 
     if( nodeptr->nodeValue != NULL ) {
-        free( nodeptr->nodeValue );
+        ixmlDocument_freeMem( nodeptr->ownerDocument, nodeptr->nodeValue );
         nodeptr->nodeValue = NULL;
     }
 
     if( newNodeValue != NULL ) {
-        nodeptr->nodeValue = strdup( newNodeValue );
+        nodeptr->nodeValue = ixmlDocument_strdup( nodeptr->ownerDocument,
+                                                  newNodeValue );
         if( nodeptr->nodeValue == NULL ) {
             return IXML_INSUFFICIENT_MEMORY;
         }
@@ -829,6 +851,11 @@ ixmlNode_appendChild( IN IXML_Node * nodeptr,
     }
     // set the parent node pointer
     newChild->parentNode = nodeptr;
+    if( newChild->ownerDocument == NULL && nodeptr->ownerDocument != NULL
+        && nodeptr->ownerDocument->arena != NULL ) {
+        // adopting a node allocated outside the document arena
+        nodeptr->ownerDocument->arena->mixed = TRUE;
+    }
     newChild->ownerDocument = nodeptr->ownerDocument;
 
     //if the first child
@@ -1174,6 +1201,8 @@ ixmlNode_cloneNodeTreeRecursive( IN IXML_Node * nodeptr,
                                                          deep );
                     if( newNode->firstChild != NULL ) {
                         newNode->firstChild->parentNode = newNode;
+                        ixmlNode_setSiblingNodesParent( newNode->
+                                                        firstChild );
                     }
                 }
 
@@ -1407,34 +1436,31 @@ ixmlNode_hasAttributes( IXML_Node * nodeptr )
 }
 
 /*================================================================
-*   ixmlNode_getElementsByTagNameRecursive
-*       Recursively traverse the whole tree, search for element
-*       with the given tagname.
-*       Internal to parser.
+*   ixmlNode_getNextInTree
+*       Returns the node following n in a preorder traversal of the
+*       tree rooted at root (attributes excluded), or NULL when the
+*       whole tree has been traversed. This walks the parent links
+*       instead of recursing, so the depth of the tree and the length
+*       of the sibling lists do not matter.
+*       Internal function.
 *
 *=================================================================*/
-void
-ixmlNode_getElementsByTagNameRecursive( IN IXML_Node * n,
-                                        IN char *tagname,
-                                        OUT IXML_NodeList ** list )
+static IXML_Node *
+ixmlNode_getNextInTree( IN IXML_Node * root,
+                        IN IXML_Node * n )
 {
-    const char *name;
-
-    if( n != NULL ) {
-        if( ixmlNode_getNodeType( n ) == eELEMENT_NODE ) {
-            name = ixmlNode_getNodeName( n );
-            if( strcmp( tagname, name ) == 0
-                || strcmp( tagname, "*" ) == 0 ) {
-                ixmlNodeList_addToNodeList( list, n );
-            }
-        }
+    if( n->firstChild != NULL ) {
+        return n->firstChild;
+    }
 
-        ixmlNode_getElementsByTagNameRecursive( ixmlNode_getFirstChild
-                                                ( n ), tagname, list );
-        ixmlNode_getElementsByTagNameRecursive( ixmlNode_getNextSibling
-                                                ( n ), tagname, list );
+    while( n != NULL && n != root ) {
+        if( n->nextSibling != NULL ) {
+            return n->nextSibling;
+        }
+        n = n->parentNode;
     }
 
+    return NULL;
 }
 
 /*================================================================
@@ -1450,57 +1476,18 @@ ixmlNode_getElementsByTagName( IN IXML_Node * n,
                                IN char *tagname,
                                OUT IXML_NodeList ** list )
 {
-    const char *name;
+    IXML_Node *node;
+    BOOL matchAll;
 
     assert( n != NULL && tagname != NULL );
 
-    if( ixmlNode_getNodeType( n ) == eELEMENT_NODE ) {
-        name = ixmlNode_getNodeName( n );
-        if( strcmp( tagname, name ) == 0 || strcmp( tagname, "*" ) == 0 ) {
-            ixmlNodeList_addToNodeList( list, n );
-        }
-    }
-
-    ixmlNode_getElementsByTagNameRecursive( ixmlNode_getFirstChild( n ),
-                                            tagname, list );
+    matchAll = ( strcmp( tagname, "*" ) == 0 );
 
-}
-
-/*================================================================
-*   ixmlNode_getElementsByTagNameNSRecursive
-*	    Internal function to parser.	
-*		
-*
-*=================================================================*/
-void
-ixmlNode_getElementsByTagNameNSRecursive( IN IXML_Node * n,
-                                          IN char *namespaceURI,
-                                          IN char *localName,
-                                          OUT IXML_NodeList ** list )
-{
-    const DOMString nsURI;
-    const DOMString name;
-
-    if( n != NULL ) {
-        if( ixmlNode_getNodeType( n ) == eELEMENT_NODE ) {
-            name = ixmlNode_getLocalName( n );
-            nsURI = ixmlNode_getNamespaceURI( n );
-
-            if( ( name != NULL ) && ( nsURI != NULL ) &&
-                ( strcmp( namespaceURI, nsURI ) == 0
-                  || strcmp( namespaceURI, "*" ) == 0 )
-                && ( strcmp( name, localName ) == 0
-                     || strcmp( localName, "*" ) == 0 ) ) {
-                ixmlNodeList_addToNodeList( list, n );
-            }
+    for( node = n; node != NULL; node = ixmlNode_getNextInTree( n, node ) ) {
+        if( node->nodeType == eELEMENT_NODE &&
+            ( matchAll || strcmp( tagname, node->nodeName ) == 0 ) ) {
+            ixmlNodeList_addToNodeList( list, node );
         }
-
-        ixmlNode_getElementsByTagNameNSRecursive( ixmlNode_getFirstChild
-                                                  ( n ), namespaceURI,
-                                                  localName, list );
-        ixmlNode_getElementsByTagNameNSRecursive( ixmlNode_getNextSibling
-                                                  ( n ), namespaceURI,
-                                                  localName, list );
     }
 
 }
@@ -1519,28 +1506,25 @@ ixmlNode_getElementsByTagNameNS( IN IXML_Node * n,
                                  IN char *localName,
                                  OUT IXML_NodeList ** list )
 {
-    const DOMString nsURI;
-    const DOMString name;
+    IXML_Node *node;
+    BOOL allNamespaces;
+    BOOL allNames;
 
     assert( n != NULL && namespaceURI != NULL && localName != NULL );
 
-    if( ixmlNode_getNodeType( n ) == eELEMENT_NODE ) {
-        name = ixmlNode_getLocalName( n );
-        nsURI = ixmlNode_getNamespaceURI( n );
+    allNamespaces = ( strcmp( namespaceURI, "*" ) == 0 );
+    allNames = ( strcmp( localName, "*" ) == 0 );
 
-        if( ( name != NULL ) && ( nsURI != NULL ) &&
-            ( strcmp( namespaceURI, nsURI ) == 0
-              || strcmp( namespaceURI, "*" ) == 0 )
-            && ( strcmp( name, localName ) == 0
-                 || strcmp( localName, "*" ) == 0 ) ) {
-            ixmlNodeList_addToNodeList( list, n );
+    for( node = n; node != NULL; node = ixmlNode_getNextInTree( n, node ) ) {
+        if( ( node->nodeType == eELEMENT_NODE ) &&
+            ( node->localName != NULL ) && ( node->namespaceURI != NULL ) &&
+            ( allNamespaces
+              || strcmp( namespaceURI, node->namespaceURI ) == 0 )
+            && ( allNames || strcmp( localName, node->localName ) == 0 ) ) {
+            ixmlNodeList_addToNodeList( list, node );
         }
     }
 
-    ixmlNode_getElementsByTagNameNSRecursive( ixmlNode_getFirstChild( n ),
-                                              namespaceURI, localName,
-                                              list );
-
 }
 
 /*================================================================
@@ -1557,20 +1541,21 @@ ixmlNode_setNodeName( IN IXML_Node * node,
     assert( node != NULL );
 
     if( node->nodeName != NULL ) {
-        free( node->nodeName );
+        ixmlDocument_freeMem( node->ownerDocument, node->nodeName );
         node->nodeName = NULL;
     }
 
     if( qualifiedName != NULL ) {
         // set the name part
-        node->nodeName = strdup( qualifiedName );
+        node->nodeName = ixmlDocument_strdup( node->ownerDocument,
+                                              qualifiedName );
         if( node->nodeName == NULL ) {
             return IXML_INSUFFICIENT_MEMORY;
         }
 
         rc = Parser_setNodePrefixAndLocalName( node );
         if( rc != IXML_SUCCESS ) {
-            free( node->nodeName );
+            ixmlDocument_freeMem( node->ownerDocument, node->nodeName );
         }
     }
 
@@ -1612,15 +1597,17 @@ ixmlNode_setNodeProperties( IN IXML_Node * destNode,
 
   ErrorHandler:
     if( destNode->nodeName != NULL ) {
-        free( destNode->nodeName );
+        ixmlDocument_freeMem( destNode->ownerDocument, destNode->nodeName );
         destNode->nodeName = NULL;
     }
     if( destNode->nodeValue != NULL ) {
-        free( destNode->nodeValue );
+        ixmlDocument_freeMem( destNode->ownerDocument,
+                              destNode->nodeValue );
         destNode->nodeValue = NULL;
     }
     if( destNode->localName != NULL ) {
-        free( destNode->localName );
+        ixmlDocument_freeMem( destNode->ownerDocument,
+                              destNode->localName );
         destNode->localName = NULL;
     }
 
@@ -58,25 +58,50 @@ IXML_Node *
 ixmlNodeList_item( IXML_NodeList * nList,
                    unsigned long index )
 {
-    IXML_NodeList *next;
-    unsigned int i;
-
-    // if the list ptr is NULL
-    if( nList == NULL ) {
-        return NULL;
-    }
-    // if index is more than list length
-    if( index > ixmlNodeList_length( nList ) - 1 ) {
+    // if the list ptr is NULL, or index is more than list length
+    if( nList == NULL || index >= nList->length ) {
         return NULL;
     }
 
-    next = nList;
-    for( i = 0; i < index && next != NULL; ++i ) {
-        next = next->next;
+    return nList->items[index];
+
+}
+
+/*================================================================
+*   ixmlNodeList_reserve
+*       Makes room for at least 'capacity' nodes in the nodelist,
+*       creating it if needed.
+*       Internal to parser only.
+*
+*=================================================================*/
+int
+ixmlNodeList_reserve( INOUT IXML_NodeList ** nList,
+                      IN unsigned long capacity )
+{
+    IXML_Node **items;
+
+    if( *nList == NULL )        // nodelist is empty
+    {
+        *nList = ( IXML_NodeList * ) malloc( sizeof( IXML_NodeList ) );
+        if( *nList == NULL ) {
+            return IXML_INSUFFICIENT_MEMORY;
+        }
+
+        ixmlNodeList_init( *nList );
     }
 
-    return next->nodeItem;
+    if( capacity > ( *nList )->capacity ) {
+        items = ( IXML_Node ** ) realloc( ( *nList )->items,
+                                          capacity *
+                                          sizeof( IXML_Node * ) );
+        if( items == NULL ) {
+            return IXML_INSUFFICIENT_MEMORY;
+        }
+        ( *nList )->items = items;
+        ( *nList )->capacity = capacity;
+    }
 
+    return IXML_SUCCESS;
 }
 
 /*================================================================
@@ -89,9 +114,7 @@ int
 ixmlNodeList_addToNodeList( IN IXML_NodeList ** nList,
                             IN IXML_Node * add )
 {
-    IXML_NodeList *traverse,
-     *p = NULL;
-    IXML_NodeList *newListItem;
+    int rc;
 
     assert( add != NULL );
 
@@ -99,34 +122,17 @@ ixmlNodeList_addToNodeList( IN IXML_NodeList ** nList,
         return IXML_FAILED;
     }
 
-    if( *nList == NULL )        // nodelist is empty
-    {
-        *nList = ( IXML_NodeList * ) malloc( sizeof( IXML_NodeList ) );
-        if( *nList == NULL ) {
-            return IXML_INSUFFICIENT_MEMORY;
+    if( *nList == NULL || ( *nList )->length == ( *nList )->capacity ) {
+        // grow geometrically, so that adding n nodes is O(n)
+        rc = ixmlNodeList_reserve( nList, ( *nList == NULL ? 0 :
+                                            2 * ( *nList )->capacity ) +
+                                   NODELIST_MIN_CAPACITY );
+        if( rc != IXML_SUCCESS ) {
+            return rc;
         }
-
-        ixmlNodeList_init( *nList );
     }
 
-    if( ( *nList )->nodeItem == NULL ) {
-        ( *nList )->nodeItem = add;
-    } else {
-        traverse = *nList;
-        while( traverse != NULL ) {
-            p = traverse;
-            traverse = traverse->next;
-        }
-
-        newListItem =
-            ( IXML_NodeList * ) malloc( sizeof( IXML_NodeList ) );
-        if( newListItem == NULL ) {
-            return IXML_INSUFFICIENT_MEMORY;
-        }
-        p->next = newListItem;
-        newListItem->nodeItem = add;
-        newListItem->next = NULL;
-    }
+    ( *nList )->items[( *nList )->length++] = add;
 
     return IXML_SUCCESS;
 }
@@ -141,16 +147,7 @@ ixmlNodeList_addToNodeList( IN IXML_NodeList ** nList,
 unsigned long
 ixmlNodeList_length( IN IXML_NodeList * nList )
 {
-    IXML_NodeList *list;
-    unsigned long length = 0;
-
-    list = nList;
-    while( list != NULL ) {
-        ++length;
-        list = list->next;
-    }
-
-    return length;
+    return ( nList == NULL ? 0 : nList->length );
 }
 
 /*================================================================
@@ -162,13 +159,9 @@ ixmlNodeList_length( IN IXML_NodeList * nList )
 void
 ixmlNodeList_free( IN IXML_NodeList * nList )
 {
-    IXML_NodeList *next;
-
-    while( nList != NULL ) {
-        next = nList->next;
-
+    if( nList != NULL ) {
+        free( nList->items );
         free( nList );
-        nList = next;
     }
 
 }
@@ -1306,6 +1306,24 @@ int UpnpSetMaxContentLength(
 			           for incoming SOAP actions, in bytes. */
     );
 
+/** Sets the maximum time that the SDK waits for an outgoing HTTP 
+ *  connection (SOAP actions, subscriptions, HTTP GETs) to be accepted 
+ *  by the remote end, so that a device which disappeared from the 
+ *  network does not stall the caller for the system connect timeout.
+ *  A value of 0 disables the limit. This function can be called before 
+ *  {\bf UpnpInit}.
+ *  The default timeout is {\tt DEFAULT_CONNECT_TIMEOUT} = 10 seconds.
+ *   
+ *  @return [int] An integer representing one of the following:
+ *    \begin{itemize}
+ *      \item {\tt UPNP_E_SUCCESS}: The operation completed successfully.
+ *      \item {\tt UPNP_E_INVALID_PARAM}: The timeout is negative.
+ *    \end{itemize}
+ */
+int UpnpSetConnectTimeout(
+    IN int timeoutSecs    /** The connection timeout, in seconds. */
+    );
+
 //@} // Initialization and Registration
 
 ////////////////////////////////////////////////////////////////////////
@@ -106,6 +106,19 @@
 #define DEFAULT_SOAP_CONTENT_LENGTH 16000
 //@}
 
+/** @name DEFAULT_CONNECT_TIMEOUT
+ * Outgoing HTTP connections (SOAP actions, subscriptions, HTTP GETs)
+ * fail if the remote host has not accepted them after 
+ * {\tt DEFAULT_CONNECT_TIMEOUT} seconds, instead of waiting for the 
+ * system connect timeout.  This prevents a device that disappeared 
+ * from the network without notice to stall the control point for 
+ * minutes.  This can be adjusted dynamically with 
+ * {\tt UpnpSetConnectTimeout}.
+ */
+//@{
+#define DEFAULT_CONNECT_TIMEOUT 10
+//@}
+
 /** @name NUM_SSDP_COPY
  * This configuration parameter determines how many copies of each SSDP 
  * advertisement and search packets will be sent. By default it will send two 
@@ -106,6 +106,10 @@ CLIENTONLY( ithread_mutex_t GlobalClientSubscribeMutex;
 // (HTTP Error Code) will be returned to the remote end point.
 size_t g_maxContentLength = DEFAULT_SOAP_CONTENT_LENGTH; // in bytes
 
+// Maximum time to wait for an outgoing connection to be accepted by the
+// remote end. 0 means no limit (system connect timeout).
+int g_connectTimeout = DEFAULT_CONNECT_TIMEOUT; // in seconds
+
 // Global variable to denote the state of Upnp SDK 
 //    = 0 if uninitialized, = 1 if initialized.
      int UpnpSdkInit = 0;
@@ -171,6 +175,10 @@ size_t g_maxContentLength = DEFAULT_SOAP_CONTENT_LENGTH; // in bytes
     if( ithread_mutex_init( &gUUIDMutex, NULL ) != 0 ) {
         return UPNP_E_INIT_FAILED;
     }
+    //initialize client connection pool
+    if( http_InitConnPool(  ) != UPNP_E_SUCCESS ) {
+        return UPNP_E_INIT_FAILED;
+    }
     //initialize subscribe mutex
     CLIENTONLY( if
                 ( ithread_mutex_init( &GlobalClientSubscribeMutex, NULL )
@@ -360,6 +368,7 @@ UpnpFinish(  )
 
         ithread_mutex_destroy( &GlobalHndMutex );
     ithread_mutex_destroy( &gUUIDMutex );
+    http_CleanupConnPool(  );
 
     // remove all virtual dirs
     UpnpRemoveAllVirtualDirs(  );
@@ -4185,4 +4194,45 @@ UpnpSetMaxContentLength (
 
 }
 
+/**************************************************************************
+ * Function: UpnpSetConnectTimeout
+ *
+ *  Parameters:	
+ *      IN int timeoutSecs                  The timeout to be set 
+ *	
+ *  Description:
+ *      Sets the maximum time that the SDK waits for an outgoing HTTP 
+ *      connection (SOAP actions, subscriptions, HTTP GETs) to be accepted
+ *      by the remote end. A value of 0 disables the limit, so that the 
+ *      system connect timeout applies. The default timeout is 
+ *      {\tt DEFAULT_CONNECT_TIMEOUT} = 10 seconds. This function can be
+ *      called before {\bf UpnpInit}.
+ *
+ *  Return Values: int :
+ *    UPNP_E_SUCCESS            : The operation completed successfully.
+ *    UPNP_E_INVALID_PARAM      : The timeout is negative.
+ *		
+ ***************************************************************************/
+int
+UpnpSetConnectTimeout (
+                      IN int timeoutSecs
+                               /** Connection timeout, in seconds  */
+     )
+{
+    int errCode = UPNP_E_SUCCESS;
+
+    do {
+        if( timeoutSecs < 0 ) {
+            errCode = UPNP_E_INVALID_PARAM;
+            break;
+        }
+
+        g_connectTimeout = timeoutSecs;
+
+    } while( 0 );
+
+    return errCode;
+
+}
+
 /*********************** END OF FILE upnpapi.c :) ************************/
@@ -70,6 +70,7 @@ struct ErrorString ErrorMessages[] = { {UPNP_E_SUCCESS, "UPNP_E_SUCCESS"},
 {UPNP_E_SOCKET_BIND, "UPNP_E_SOCKET_BIND"},
 {UPNP_E_SOCKET_CONNECT, "UPNP_E_SOCKET_CONNECT"},
 {UPNP_E_OUTOF_SOCKET, "UPNP_E_OUTOF_SOCKET"},
+{UPNP_E_TIMEDOUT, "UPNP_E_TIMEDOUT"},
 {UPNP_E_LISTEN, "UPNP_E_LISTEN"},
 {UPNP_E_EVENT_PROTOCOL, "UPNP_E_EVENT_PROTOCOL"},
 {UPNP_E_SUBSCRIBE_UNACCEPTED, "UPNP_E_SUBSCRIBE_UNACCEPTED"},
@@ -784,7 +784,7 @@ gena_process_notification_event( IN SOCKINFO * info,
     // parse the content (should be XML)
     if( !has_xml_content_type( event ) ||
         event->msg.length == 0 ||
-        ( ixmlParseBufferEx( event->entity.buf, &ChangedVars ) ) !=
+        ( ixmlParseBufferArenaEx( event->entity.buf, &ChangedVars ) ) !=
         IXML_SUCCESS ) {
         error_respond( info, HTTP_BAD_REQUEST, event );
 
@@ -482,6 +482,7 @@ httpmsg_init( INOUT http_message_t * msg )
     msg->initialized = 1;
     msg->entity.buf = NULL;
     msg->entity.length = 0;
+    msg->amount_discarded = 0;
     ListInit( &msg->headers, httpmsg_compare, httpheader_free );
     membuffer_init( &msg->msg );
     membuffer_init( &msg->status_msg );
@@ -1877,7 +1878,8 @@ parser_parse_entity_using_clen( INOUT http_parser_t * parser )
     // determine entity (i.e. body) length so far
     //entity_length = parser->msg.msg.length - parser->entity_start_position;
     parser->msg.entity.length =
-        parser->msg.msg.length - parser->entity_start_position;
+        parser->msg.msg.length - parser->entity_start_position +
+        parser->msg.amount_discarded;
 
     if( parser->msg.entity.length < parser->content_length ) {
         // more data to be read
@@ -1886,7 +1888,8 @@ parser_parse_entity_using_clen( INOUT http_parser_t * parser )
         if( parser->msg.entity.length > parser->content_length ) {
             // silently discard extra data
             parser->msg.msg.buf[parser->entity_start_position +
-                                parser->content_length] = '\0';
+                                parser->content_length -
+                                parser->msg.amount_discarded] = '\0';
         }
         // save entity length
         parser->msg.entity.length = parser->content_length;
@@ -2028,7 +2031,7 @@ parser_parse_chunky_entity( INOUT http_parser_t * parser )
     if( parser->chunk_size == 0 ) {
         // done reading entity; determine length of entity
         parser->msg.entity.length = parser->scanner.cursor -
-            parser->entity_start_position;
+            parser->entity_start_position + parser->msg.amount_discarded;
 
         // read entity headers
         parser->ent_position = ENTREAD_CHUNKY_HEADERS;
@@ -2062,7 +2065,8 @@ parser_parse_entity_until_close( INOUT http_parser_t * parser )
     cursor = parser->msg.msg.length;
 
     // update entity length
-    parser->msg.entity.length = cursor - parser->entity_start_position;
+    parser->msg.entity.length = cursor - parser->entity_start_position +
+        parser->msg.amount_discarded;
 
     // update pointer
     parser->msg.entity.buf =
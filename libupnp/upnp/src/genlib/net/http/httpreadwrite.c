@@ -45,7 +45,10 @@
 #include <sys/time.h>
 #include <sys/wait.h>
 #include <unistd.h>
+#include <errno.h>
+#include <time.h>
 #include <sys/utsname.h>
+#include "ithread.h"
 #include "unixutil.h"
 #include "config.h"
 #include "upnp.h"
@@ -145,6 +148,7 @@ http_Connect( IN uri_type * destination_url,
               OUT uri_type * url )
 {
     int connfd;
+    int ret_code;
 
     http_FixUrl( destination_url, url );
 
@@ -153,16 +157,287 @@ http_Connect( IN uri_type * destination_url,
         return UPNP_E_OUTOF_SOCKET;
     }
 
-    if( connect( connfd, ( struct sockaddr * )&url->hostport.IPv4address,
-                 sizeof( struct sockaddr_in ) ) == -1 ) {
+    ret_code = sock_connect( connfd, &url->hostport.IPv4address,
+                             g_connectTimeout );
+    if( ret_code != UPNP_E_SUCCESS ) {
         shutdown( connfd, SD_BOTH );
         UpnpCloseSocket( connfd );
-        return UPNP_E_SOCKET_CONNECT;
+        return ret_code;
     }
 
     return connfd;
 }
 
+/************************************************************************
+* Client connection pool
+*
+* Idle HTTP/1.1 keep-alive connections are kept per remote host:port, 
+* so that successive SOAP actions or range GETs to the same device do 
+* not pay for a new TCP connection each time.
+************************************************************************/
+
+#define HTTP_POOL_MAX_IDLE		32	// idle connections, all hosts
+#define HTTP_POOL_MAX_PER_HOST	4	// idle connections, per host:port
+#define HTTP_POOL_IDLE_TIMEOUT	15	// seconds
+
+typedef struct {
+    int sock;                   // -1 if slot is free
+    struct sockaddr_in addr;
+    time_t idle_since;
+} http_pool_conn_t;
+
+static http_pool_conn_t HttpPool[HTTP_POOL_MAX_IDLE];
+static ithread_mutex_t HttpPoolMutex;
+static int HttpPoolInitialized = 0;
+
+/************************************************************************
+* Function: SameHostPort
+*																		
+* Description: Compares the IP address and port of two destinations
+************************************************************************/
+static xboolean
+SameHostPort( IN const struct sockaddr_in *a,
+              IN const struct sockaddr_in *b )
+{
+    return ( a->sin_addr.s_addr == b->sin_addr.s_addr &&
+             a->sin_port == b->sin_port );
+}
+
+/************************************************************************
+* Function: http_InitConnPool
+*																		
+* Description: Initializes the pool of idle client connections. Called
+*	from UpnpInit.
+*																		
+* Returns:																
+*	UPNP_E_SUCCESS	on success
+*	UPNP_E_INIT_FAILED	on error
+************************************************************************/
+int
+http_InitConnPool( void )
+{
+    int i;
+
+    if( HttpPoolInitialized ) {
+        return UPNP_E_SUCCESS;
+    }
+    if( ithread_mutex_init( &HttpPoolMutex, NULL ) != 0 ) {
+        return UPNP_E_INIT_FAILED;
+    }
+    for( i = 0; i < HTTP_POOL_MAX_IDLE; i++ ) {
+        HttpPool[i].sock = -1;
+    }
+    HttpPoolInitialized = 1;
+    return UPNP_E_SUCCESS;
+}
+
+/************************************************************************
+* Function: http_CleanupConnPool
+*																		
+* Description: Closes all idle client connections and releases the 
+*	pool. Called from UpnpFinish.
+************************************************************************/
+void
+http_CleanupConnPool( void )
+{
+    int i;
+
+    if( !HttpPoolInitialized ) {
+        return;
+    }
+    ithread_mutex_lock( &HttpPoolMutex );
+    for( i = 0; i < HTTP_POOL_MAX_IDLE; i++ ) {
+        if( HttpPool[i].sock != -1 ) {
+            shutdown( HttpPool[i].sock, SD_BOTH );
+            UpnpCloseSocket( HttpPool[i].sock );
+            HttpPool[i].sock = -1;
+        }
+    }
+    HttpPoolInitialized = 0;
+    ithread_mutex_unlock( &HttpPoolMutex );
+    ithread_mutex_destroy( &HttpPoolMutex );
+}
+
+/************************************************************************
+* Function: http_PoolGet
+*																		
+* Parameters:															
+*	IN const struct sockaddr_in* addr ;	Remote address
+*																		
+* Description: Takes an idle connection to the given address out of 
+*	the pool. Connections which have expired, or which the remote end
+*	has closed in the meantime, are discarded.
+*																		
+* Returns:																
+*	socket descriptor, or -1 if no usable connection is available
+************************************************************************/
+static int
+http_PoolGet( IN const struct sockaddr_in *addr )
+{
+    int i;
+    int sock = -1;
+    time_t now = time( NULL );
+    char c;
+
+    if( !HttpPoolInitialized ) {
+        return -1;
+    }
+    ithread_mutex_lock( &HttpPoolMutex );
+    for( i = 0; i < HTTP_POOL_MAX_IDLE; i++ ) {
+        http_pool_conn_t *const conn = HttpPool + i;
+
+        if( conn->sock == -1 ) {
+            continue;
+        }
+        if( now - conn->idle_since > HTTP_POOL_IDLE_TIMEOUT ) {
+            shutdown( conn->sock, SD_BOTH );
+            UpnpCloseSocket( conn->sock );
+            conn->sock = -1;
+        } else if( sock == -1 && SameHostPort( &conn->addr, addr ) ) {
+            sock = conn->sock;
+            conn->sock = -1;
+        }
+    }
+    ithread_mutex_unlock( &HttpPoolMutex );
+
+    // An idle connection should have nothing to read : either the
+    // remote end closed it, or it sent unexpected data.
+    if( sock != -1 &&
+        ( recv( sock, &c, 1, MSG_PEEK | MSG_DONTWAIT ) >= 0 ||
+          ( errno != EAGAIN && errno != EWOULDBLOCK ) ) ) {
+        shutdown( sock, SD_BOTH );
+        UpnpCloseSocket( sock );
+        sock = -1;
+    }
+    return sock;
+}
+
+/************************************************************************
+* Function: http_PoolPut
+*																		
+* Parameters:															
+*	IN const struct sockaddr_in* addr ;	Remote address
+*	IN int sock ;						Connected socket
+*																		
+* Description: Gives an idle connection back to the pool. The socket is
+*	closed instead if the pool is full for this host, or for all hosts.
+************************************************************************/
+static void
+http_PoolPut( IN const struct sockaddr_in *addr,
+              IN int sock )
+{
+    int i;
+    int nb_host = 0;
+    int free_slot = -1;
+
+    if( HttpPoolInitialized ) {
+        ithread_mutex_lock( &HttpPoolMutex );
+        for( i = 0; i < HTTP_POOL_MAX_IDLE; i++ ) {
+            if( HttpPool[i].sock == -1 ) {
+                if( free_slot < 0 )
+                    free_slot = i;
+            } else if( SameHostPort( &HttpPool[i].addr, addr ) ) {
+                nb_host++;
+            }
+        }
+        if( free_slot >= 0 && nb_host < HTTP_POOL_MAX_PER_HOST ) {
+            HttpPool[free_slot].sock = sock;
+            HttpPool[free_slot].addr = *addr;
+            HttpPool[free_slot].idle_since = time( NULL );
+            sock = -1;
+        }
+        ithread_mutex_unlock( &HttpPoolMutex );
+    }
+    if( sock != -1 ) {
+        shutdown( sock, SD_BOTH );
+        UpnpCloseSocket( sock );
+    }
+}
+
+/************************************************************************
+* Function: http_IsKeepAlive
+*																		
+* Parameters:															
+*	IN http_parser_t* parser ;	Parser holding a complete response
+*																		
+* Description: Checks whether the connection which carried this 
+*	response can be used for another request : the response must be 
+*	HTTP/1.1 or later, its end must not be delimited by the close of the
+*	connection, and it must not carry a "Connection: close" header.
+************************************************************************/
+static xboolean
+http_IsKeepAlive( IN http_parser_t * parser )
+{
+    http_message_t *msg = &parser->msg;
+    http_header_t *header;
+
+    if( parser->position != POS_COMPLETE ||
+        parser->ent_position == ENTREAD_UNTIL_CLOSE ) {
+        return FALSE;
+    }
+    if( msg->major_version < 1 ||
+        ( msg->major_version == 1 && msg->minor_version < 1 ) ) {
+        return FALSE;
+    }
+    header = httpmsg_find_hdr_str( msg, "CONNECTION" );
+    if( header != NULL ) {
+        memptr value;
+
+        value.buf = header->value.buf;
+        value.length = header->value.length;
+        if( memptr_cmp_nocase( &value, "close" ) == 0 ) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/************************************************************************
+* Function: http_ConnectPooled
+*																		
+* Parameters:															
+*	IN const struct sockaddr_in* addr ;	Remote address
+*	OUT SOCKINFO* info ;				Socket information object
+*	OUT xboolean* reused ;				TRUE if the connection was 
+*										taken from the pool
+*																		
+* Description: Gets a connection to the remote end, reusing an idle 
+*	one from the pool if possible, or connecting a new socket.
+*																		
+* Returns:																
+*	UPNP_E_SUCCESS
+*	UPNP_E_SOCKET_ERROR
+*	UPNP_E_SOCKET_CONNECT
+*	UPNP_E_TIMEDOUT
+************************************************************************/
+static int
+http_ConnectPooled( IN const struct sockaddr_in *addr,
+                    OUT SOCKINFO * info,
+                    OUT xboolean * reused )
+{
+    int sock = http_PoolGet( addr );
+    int ret_code;
+
+    *reused = ( sock != -1 );
+    if( sock == -1 ) {
+        sock = socket( AF_INET, SOCK_STREAM, 0 );
+        if( sock == -1 ) {
+            return UPNP_E_SOCKET_ERROR;
+        }
+        ret_code = sock_connect( sock, addr, g_connectTimeout );
+        if( ret_code != UPNP_E_SUCCESS ) {
+            shutdown( sock, SD_BOTH );
+            UpnpCloseSocket( sock );
+            return ret_code;
+        }
+    }
+    if( sock_init( info, sock ) != UPNP_E_SUCCESS ) {
+        sock_destroy( info, SD_BOTH );
+        return UPNP_E_SOCKET_ERROR;
+    }
+    return UPNP_E_SUCCESS;
+}
+
 /************************************************************************
 * Function: http_RecvMessage											
 *																		
@@ -509,45 +784,49 @@ http_RequestAndResponse( IN uri_type * destination,
                          IN int timeout_secs,
                          OUT http_parser_t * response )
 {
-    int tcp_connection;
     int ret_code;
     int http_error_code;
     SOCKINFO info;
+    xboolean reused;
+    struct sockaddr_in *addr = &destination->hostport.IPv4address;
 
-    tcp_connection = socket( AF_INET, SOCK_STREAM, 0 );
-    if( tcp_connection == -1 ) {
-        parser_response_init( response, req_method );
-        return UPNP_E_SOCKET_ERROR;
-    }
-    if( sock_init( &info, tcp_connection ) != UPNP_E_SUCCESS )
-    {
+    while( TRUE ) {
+        // connect, or reuse an idle connection
+        ret_code = http_ConnectPooled( addr, &info, &reused );
+        if( ret_code != UPNP_E_SUCCESS ) {
+            parser_response_init( response, req_method );
+            return ret_code;
+        }
+        // send request
+        ret_code = http_SendMessage( &info, &timeout_secs, "b",
+                                     request, request_length );
+        if( ret_code == 0 ) {
+            // recv response
+            ret_code = http_RecvMessage( &info, response, req_method,
+                                         &timeout_secs, &http_error_code );
+            if( ret_code == 0 || !reused || ret_code == UPNP_E_TIMEDOUT
+                || response->msg.msg.length > 0 ) {
+                break;
+            }
+            httpmsg_destroy( &response->msg );
+        } else if( !reused ) {
+            sock_destroy( &info, SD_BOTH );
+            parser_response_init( response, req_method );
+            return ret_code;
+        }
+        // The server has closed the idle connection in the meantime :
+        // retry on another one.
         sock_destroy( &info, SD_BOTH );
-        parser_response_init( response, req_method );
-        return UPNP_E_SOCKET_ERROR;
+        DBGONLY( UpnpPrintf( UPNP_INFO, HTTP, __FILE__, __LINE__,
+                             "stale keep-alive connection, retrying\n" );
+             )
     }
-    // connect
-    ret_code = connect( info.socket,
-                        ( struct sockaddr * )&destination->hostport.
-                        IPv4address, sizeof( struct sockaddr_in ) );
 
-    if( ret_code == -1 ) {
-        sock_destroy( &info, SD_BOTH );
-        parser_response_init( response, req_method );
-        return UPNP_E_SOCKET_CONNECT;
-    }
-    // send request
-    ret_code = http_SendMessage( &info, &timeout_secs, "b",
-                                 request, request_length );
-    if( ret_code != 0 ) {
-        sock_destroy( &info, SD_BOTH );
-        parser_response_init( response, req_method );
-        return ret_code;
+    if( ret_code == 0 && http_IsKeepAlive( response ) ) {
+        http_PoolPut( addr, info.socket );
+    } else {
+        sock_destroy( &info, SD_BOTH ); //should shutdown completely
     }
-    // recv response
-    ret_code = http_RecvMessage( &info, response, req_method,
-                                 &timeout_secs, &http_error_code );
-
-    sock_destroy( &info, SD_BOTH ); //should shutdown completely
 
     return ret_code;
 }
@@ -1015,13 +1294,10 @@ http_OpenHttpPost( IN const char *url_str,
         goto errorHandler;
     }
 
-    ret_code = connect( handle->sock_info.socket,
-                        ( struct sockaddr * )&url.hostport.IPv4address,
-                        sizeof( struct sockaddr_in ) );
-
-    if( ret_code == -1 ) {
+    ret_code = sock_connect( handle->sock_info.socket,
+                             &url.hostport.IPv4address, g_connectTimeout );
+    if( ret_code != UPNP_E_SUCCESS ) {
         sock_destroy( &handle->sock_info, SD_BOTH );
-        ret_code = UPNP_E_SOCKET_CONNECT;
         goto errorHandler;
     }
     // send request
@@ -1040,6 +1316,7 @@ http_OpenHttpPost( IN const char *url_str,
 typedef struct HTTPGETHANDLE {
     http_parser_t response;
     SOCKINFO sock_info;
+    struct sockaddr_in addr;    // remote end, to pool the connection
     int entity_offset;
 } http_get_handle_t;
 
@@ -1259,6 +1536,8 @@ ReadResponseLineAndHeaders( IN SOCKINFO * info,
 *
 *	Description :	Parses already existing data, then gets new data.
 *		Parses and extracts information from the new data.
+*		Entity data returned to the caller is removed from the
+*		response buffer.
 *
 *	Return : int ;
 *		UPNP_E_SUCCESS - On Sucess ;
@@ -1360,12 +1639,29 @@ http_ReadHttpGet( IN void *Handle,
             handle->response.msg.entity.length - handle->entity_offset;
     }
 
+    // Consumed entity bytes are always discarded below, so the
+    // unread data begins at the start of the entity.
     memcpy( buf,
             &handle->response.msg.msg.buf[handle->
-                                          response.entity_start_position +
-                                          handle->entity_offset],
+                                          response.entity_start_position],
             ( *size ) );
     handle->entity_offset += ( *size );
+
+    // Discard what has been returned to the caller, so that a long
+    // lived stream does not accumulate the whole entity in memory.
+    if( ( *size ) > 0 ) {
+        http_parser_t *parser = &handle->response;
+
+        membuffer_delete( &parser->msg.msg, parser->entity_start_position,
+                          ( *size ) );
+        parser->msg.amount_discarded += ( *size );
+        if( parser->scanner.cursor >=
+            parser->entity_start_position + ( *size ) ) {
+            parser->scanner.cursor -= ( *size );
+        }
+        parser->msg.entity.buf = parser->msg.msg.buf +
+            parser->entity_start_position;
+    }
     return UPNP_E_SUCCESS;
 }
 
@@ -1393,7 +1689,16 @@ http_CloseHttpGet( IN void *Handle )
         return UPNP_E_INVALID_PARAM;
     }
 
-    sock_destroy( &handle->sock_info, SD_BOTH );    //should shutdown completely
+    // Keep the connection for another request if the whole entity
+    // has been read, else it must be closed.
+    if( handle->addr.sin_family == AF_INET &&
+        ( size_t ) handle->entity_offset ==
+        handle->response.msg.entity.length &&
+        http_IsKeepAlive( &handle->response ) ) {
+        http_PoolPut( &handle->addr, handle->sock_info.socket );
+    } else {
+        sock_destroy( &handle->sock_info, SD_BOTH );    //should shutdown completely
+    }
     httpmsg_destroy( &handle->response.msg );
     handle->entity_offset = 0;
     free( handle );
@@ -1481,13 +1786,10 @@ http_OpenHttpGet( IN const char *url_str,
         goto errorHandler;
     }
 
-    ret_code = connect( handle->sock_info.socket,
-                        ( struct sockaddr * )&url.hostport.IPv4address,
-                        sizeof( struct sockaddr_in ) );
-
-    if( ret_code == -1 ) {
+    ret_code = sock_connect( handle->sock_info.socket,
+                             &url.hostport.IPv4address, g_connectTimeout );
+    if( ret_code != UPNP_E_SUCCESS ) {
         sock_destroy( &handle->sock_info, SD_BOTH );
-        ret_code = UPNP_E_SOCKET_CONNECT;
         goto errorHandler;
     }
     // send request
@@ -2012,7 +2314,7 @@ MakeGetMessageEx( const char *url_str,
             errCode = http_MakeMessage( request,
                                         1,
                                         1,
-                                        "QsbcGDCUc",
+                                        "QsbcGDUc",
                                         HTTPMETHOD_GET,
                                         url->pathquery.buff,
                                         url->pathquery.size,
@@ -2078,7 +2380,7 @@ http_OpenHttpGetEx( IN const char *url_str,
 {
     int http_error_code;
     memptr ctype;
-    int tcp_connection;
+    xboolean reused;
     membuffer request;
     http_get_handle_t *handle = NULL;
     uri_type url;
@@ -2130,47 +2432,40 @@ http_OpenHttpGetEx( IN const char *url_str,
         handle->entity_offset = 0;
         parser_response_init( &handle->response, HTTPMETHOD_GET );
 
-        tcp_connection = socket( AF_INET, SOCK_STREAM, 0 );
-        if( tcp_connection == -1 ) {
-            errCode = UPNP_E_SOCKET_ERROR;
-            free( handle );
-            break;
-        }
+        handle->addr = url.hostport.IPv4address;
 
-        if( sock_init( &handle->sock_info, tcp_connection ) !=
-            UPNP_E_SUCCESS ) {
-            sock_destroy( &handle->sock_info, SD_BOTH );
-            errCode = UPNP_E_SOCKET_ERROR;
-            free( handle );
-            break;
-        }
-
-        errCode = connect( handle->sock_info.socket,
-                           ( struct sockaddr * )&url.hostport.IPv4address,
-                           sizeof( struct sockaddr_in ) );
-        if( errCode == -1 ) {
+        while( TRUE ) {
+            // connect, or reuse an idle connection
+            errCode = http_ConnectPooled( &handle->addr,
+                                          &handle->sock_info, &reused );
+            if( errCode != UPNP_E_SUCCESS ) {
+                break;
+            }
+            // send request
+            errCode = http_SendMessage( &handle->sock_info,
+                                        &timeout,
+                                        "b", request.buf, request.length );
+            if( errCode == UPNP_E_SUCCESS ) {
+                status = ReadResponseLineAndHeaders( &handle->sock_info,
+                                                     &handle->response,
+                                                     &timeout,
+                                                     &http_error_code );
+                if( status == PARSE_OK ) {
+                    break;
+                }
+                errCode = UPNP_E_BAD_RESPONSE;
+            }
             sock_destroy( &handle->sock_info, SD_BOTH );
-            errCode = UPNP_E_SOCKET_CONNECT;
-            free( handle );
-            break;
+            if( !reused || handle->response.msg.msg.length > 0 ) {
+                break;
+            }
+            // The server has closed the idle connection in the 
+            // meantime : retry on another one.
+            httpmsg_destroy( &handle->response.msg );
+            parser_response_init( &handle->response, HTTPMETHOD_GET );
         }
-        // send request
-        errCode = http_SendMessage( &handle->sock_info,
-                                    &timeout,
-                                    "b", request.buf, request.length );
-
         if( errCode != UPNP_E_SUCCESS ) {
-            sock_destroy( &handle->sock_info, SD_BOTH );
-            free( handle );
-            break;
-        }
-
-        status = ReadResponseLineAndHeaders( &handle->sock_info,
-                                             &handle->response,
-                                             &timeout, &http_error_code );
-
-        if( status != PARSE_OK ) {
-            errCode = UPNP_E_BAD_RESPONSE;
+            httpmsg_destroy( &handle->response.msg );
             free( handle );
             break;
         }
@@ -2178,6 +2473,8 @@ http_OpenHttpGetEx( IN const char *url_str,
         status = parser_get_entity_read_method( &handle->response );
         if( ( status != PARSE_CONTINUE_1 ) && ( status != PARSE_SUCCESS ) ) {
             errCode = UPNP_E_BAD_RESPONSE;
+            sock_destroy( &handle->sock_info, SD_BOTH );
+            httpmsg_destroy( &handle->response.msg );
             free( handle );
             break;
         }
@@ -45,6 +45,7 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/time.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include "unixutil.h"
 
@@ -148,6 +149,89 @@ sock_destroy( INOUT SOCKINFO * info,
     return UPNP_E_SUCCESS;
 }
 
+/************************************************************************
+*	Function :	sock_connect
+*
+*	Parameters :
+*		IN int sockfd ;						Socket Descriptor
+*		IN const struct sockaddr_in* addr ;	Remote address
+*		IN int timeoutSecs ;				timeout value, 0 for none
+*
+*	Description :	Connects the socket to the remote address. The 
+*		connection is made in non-blocking mode, so that an unreachable
+*		host fails after 'timeoutSecs' instead of the system connect 
+*		timeout (which can be several minutes). The socket is put back 
+*		in blocking mode afterwards.
+*
+*	Return : int;
+*		UPNP_E_SUCCESS
+*		UPNP_E_TIMEDOUT - Timeout
+*		UPNP_E_SOCKET_CONNECT - Error while connecting
+*
+*	Note :
+************************************************************************/
+int
+sock_connect( IN int sockfd,
+              IN const struct sockaddr_in *addr,
+              IN int timeoutSecs )
+{
+    int flags;
+    int retCode;
+    int sockError = 0;
+    socklen_t len = sizeof( sockError );
+    fd_set writeSet;
+    struct timeval timeout;
+
+    if( timeoutSecs <= 0 ) {
+        if( connect( sockfd, ( struct sockaddr * )addr,
+                     sizeof( struct sockaddr_in ) ) == -1 ) {
+            return UPNP_E_SOCKET_CONNECT;
+        }
+        return UPNP_E_SUCCESS;
+    }
+
+    flags = fcntl( sockfd, F_GETFL, 0 );
+    if( flags == -1 || fcntl( sockfd, F_SETFL, flags | O_NONBLOCK ) == -1 ) {
+        return UPNP_E_SOCKET_CONNECT;
+    }
+
+    retCode = connect( sockfd, ( struct sockaddr * )addr,
+                       sizeof( struct sockaddr_in ) );
+    if( retCode == -1 && errno != EINPROGRESS ) {
+        sockError = errno;
+    } else if( retCode == -1 ) {
+        time_t const deadline = time( NULL ) + timeoutSecs;
+
+        while( TRUE ) {
+            FD_ZERO( &writeSet );
+            FD_SET( ( unsigned )sockfd, &writeSet );
+            timeout.tv_sec = deadline - time( NULL );
+            timeout.tv_usec = 0;
+            if( timeout.tv_sec < 0 ) {
+                timeout.tv_sec = 0;
+            }
+            retCode = select( sockfd + 1, NULL, &writeSet, NULL, &timeout );
+            if( retCode == -1 && errno == EINTR ) {
+                continue;
+            }
+            break;
+        }
+        if( retCode == 0 ) {
+            return UPNP_E_TIMEDOUT;
+        }
+        if( retCode == -1 ||
+            getsockopt( sockfd, SOL_SOCKET, SO_ERROR, &sockError,
+                        &len ) == -1 ) {
+            sockError = errno;
+        }
+    }
+
+    if( sockError != 0 || fcntl( sockfd, F_SETFL, flags ) == -1 ) {
+        return UPNP_E_SOCKET_CONNECT;
+    }
+    return UPNP_E_SUCCESS;
+}
+
 /************************************************************************
 *	Function :	sock_read_write
 *
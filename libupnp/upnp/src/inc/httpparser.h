@@ -193,6 +193,8 @@ typedef struct // http_message_t
 
 	// private fields
 	membuffer msg;		// entire raw message
+	size_t amount_discarded;	// entity bytes already consumed and
+					// removed from 'msg' (streaming GET)
 	char *urlbuf;	// storage for url string
 } http_message_t;
 
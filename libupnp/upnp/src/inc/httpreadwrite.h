@@ -95,6 +95,25 @@ int http_FixStrUrl( IN char* urlstr, IN int urlstrlen, OUT uri_type* fixed_url )
 ************************************************************************/
 int http_Connect( IN uri_type* destination_url, OUT uri_type *url );
 
+/************************************************************************
+* Function: http_InitConnPool
+*																		
+* Description: Initializes the pool of idle HTTP/1.1 keep-alive client 
+*	connections, reused by http_RequestAndResponse and http_OpenHttpGetEx
+*																		
+* Returns:																
+*	UPNP_E_SUCCESS	on success
+*	UPNP_E_INIT_FAILED	on error
+************************************************************************/
+int http_InitConnPool( void );
+
+/************************************************************************
+* Function: http_CleanupConnPool
+*																		
+* Description: Closes all idle client connections and releases the pool
+************************************************************************/
+void http_CleanupConnPool( void );
+
 /************************************************************************
 * Function: http_RecvMessage											
 *																		
@@ -162,6 +162,27 @@ int sock_write( IN SOCKINFO *info, IN char* buffer, IN size_t bufsize,
 ************************************************************************/
 int sock_destroy( INOUT SOCKINFO* info,int );
 
+/************************************************************************
+*	Function :	sock_connect
+*
+*	Parameters :
+*		IN int sockfd ;						Socket Descriptor
+*		IN const struct sockaddr_in* addr ;	Remote address
+*		IN int timeoutSecs ;				timeout value, 0 for none
+*
+*	Description :	Connects the socket to the remote address, failing 
+*		after 'timeoutSecs' if the remote host does not answer.
+*
+*	Return : int;
+*		UPNP_E_SUCCESS
+*		UPNP_E_TIMEDOUT - Timeout
+*		UPNP_E_SOCKET_CONNECT - Error while connecting
+*
+*	Note :
+************************************************************************/
+int sock_connect( IN int sockfd, IN const struct sockaddr_in* addr,
+		  IN int timeoutSecs );
+
 #ifdef __cplusplus
 }	// #extern "C"
 #endif
@@ -56,6 +56,8 @@
 
 extern size_t g_maxContentLength;
 
+extern int g_connectTimeout;
+
 // 30-second timeout
 #define UPNP_TIMEOUT	30
 
@@ -431,7 +431,8 @@ get_response_value( IN http_message_t * hmsg,
         goto error_handler;
     }
 
-    if( ixmlParseBufferEx( hmsg->entity.buf, &doc ) != IXML_SUCCESS ) {
+    // the response is only read, then freed : parse it in an arena
+    if( ixmlParseBufferArenaEx( hmsg->entity.buf, &doc ) != IXML_SUCCESS ) {
 
         goto error_handler;
     }
@@ -461,8 +462,8 @@ get_response_value( IN http_message_t * hmsg,
                 goto error_handler;
             }
 
-            if( ixmlParseBufferEx( node_str,
-                                   ( IXML_Document ** ) action_value ) !=
+            if( ixmlParseBufferArenaEx( node_str,
+                                        ( IXML_Document ** ) action_value ) !=
                 IXML_SUCCESS ) {
                 err_code = UPNP_E_BAD_RESPONSE;
                 goto error_handler;
@@ -547,8 +548,8 @@ get_response_value( IN http_message_t * hmsg,
                 goto error_handler;
             }
 
-            if( ixmlParseBufferEx( error_node_str,
-                                   ( IXML_Document ** ) action_value ) !=
+            if( ixmlParseBufferArenaEx( error_node_str,
+                                        ( IXML_Document ** ) action_value ) !=
                 IXML_SUCCESS ) {
                 err_code = UPNP_E_BAD_RESPONSE;
 